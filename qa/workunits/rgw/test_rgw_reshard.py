@@ -104,8 +104,24 @@ def run_bucket_reshard_cmd(bucket_name, num_shards, **kwargs):
         cmd += ' --inject-abort-at {}'.format(kwargs.pop('abort_at'))
     if 'error_code' in kwargs:
         cmd += ' --inject-error-code {}'.format(kwargs.pop('error_code'))
+    if kwargs.pop('online', False):
+        cmd += ' --rgw-reshard-online true'
     return exec_cmd(cmd, **kwargs)
 
+def get_reshard_status(bucket_name):
+    res = exec_cmd('radosgw-admin reshard status --bucket {}'.format(bucket_name))
+    return [entry['reshard_status'] for entry in json.loads(res)]
+
+def get_reshard_log_keys(bucket_name):
+    stats = get_bucket_stats(bucket_name)
+    index_gen = get_bucket_layout(bucket_name)['layout']['current_index']['gen']
+    keys = []
+    for shard in range(stats.num_shards):
+        shard_oid = '.dir.%s.%d.%d' % (stats.bucket_id, index_gen, shard)
+        res = exec_cmd('rados -p {} listomapkeys {}'.format(INDEX_POOL, shard_oid))
+        keys += [k for k in res.split(b'\n') if b'1002_' in k]
+    return keys
+
 def test_bucket_reshard(conn, name, **fault):
     # create a bucket with non-default ACLs to verify that reshard preserves them
     bucket = conn.create_bucket(Bucket=name, ACL='authenticated-read')
@@ -158,6 +174,47 @@ def test_bucket_reshard(conn, name, **fault):
         bucket.delete_objects(Delete={'Objects':[{'Key':o.key} for o in objs]})
         bucket.delete()
 
+def test_online_reshard_cancel(conn, name):
+    """
+    an online reshard that dies leaves the index shards recording the keys
+    written to them. 'reshard cancel' resets the shards and drops the records
+    """
+    bucket = conn.create_bucket(Bucket=name)
+    objs = []
+    try:
+        for i in range(0, 20):
+            objs += [bucket.put_object(Key='key' + str(i), Body=b"some_data")]
+
+        old_shard_count = get_bucket_stats(name).num_shards
+        _, ret = run_bucket_reshard_cmd(name, old_shard_count + 1, online=True,
+                                        abort_at='do_reshard', check_retcode=False)
+        assert(ret != 0)
+        assert all(s == 'in-logrecord' for s in get_reshard_status(name))
+
+        # writes are not blocked, and are recorded
+        objs += [bucket.put_object(Key='key-during', Body=b"some_data")]
+        assert len(get_reshard_log_keys(name)) > 0
+
+        # cancel once the aborted reshard's lock expires
+        while True:
+            _, ret = exec_cmd('radosgw-admin reshard cancel --bucket {}'.format(name),
+                              check_retcode=False)
+            if ret == errno.EBUSY:
+                log.info('waiting 30 seconds for reshard lock to expire...')
+                time.sleep(30)
+                continue
+            assert(ret == 0)
+            break
+
+        assert all(s == 'not-resharding' for s in get_reshard_status(name))
+        assert len(get_reshard_log_keys(name)) == 0
+        objs += [bucket.put_object(Key='key-after', Body=b"some_data")]
+        assert len(get_reshard_log_keys(name)) == 0
+        assert get_bucket_stats(name).num_shards == old_shard_count
+    finally:
+        bucket.delete_objects(Delete={'Objects':[{'Key':o.key} for o in objs]})
+        bucket.delete()
+
 
 def main():
     """
@@ -269,6 +326,10 @@ def main():
     log.debug('TEST: reshard bucket with abort at do_reshard\n')
     test_bucket_reshard(connection, 'abort-at-do-reshard', abort_at='do_reshard')
 
+    # TESTCASE 'online bucket resharding','abort','fail','writes recorded','reshard cancel clears the recording'
+    log.debug('TEST: cancel an aborted online reshard\n')
+    test_online_reshard_cancel(connection, 'abort-online-reshard')
+
     # TESTCASE 'versioning reshard-','bucket', reshard','versioning reshard','succeeds'
     log.debug(' test: reshard versioned bucket')
     num_shards_expected = get_bucket_stats(VER_BUCKET_NAME).num_shards + 1
@@ -54,13 +54,15 @@ CLS_NAME(rgw)
 #define BI_BUCKET_LOG_INDEX           1
 #define BI_BUCKET_OBJ_INSTANCE_INDEX  2
 #define BI_BUCKET_OLH_DATA_INDEX      3
+#define BI_BUCKET_RESHARD_LOG_INDEX   4
 
-#define BI_BUCKET_LAST_INDEX          4
+#define BI_BUCKET_LAST_INDEX          5
 
 static std::string bucket_index_prefixes[] = { "", /* special handling for the objs list index */
 					       "0_",     /* bucket log index */
 					       "1000_",  /* obj instance index */
 					       "1001_",  /* olh data index */
+					       RGW_BI_RESHARD_LOG_PREFIX, /* reshard log index */
 
 					       /* this must be the last index */
 					       "9999_",};
@@ -476,15 +478,103 @@ static int read_bucket_header(cls_method_context_t hctx,
   return 0;
 }
 
+/*
+ * While a shard is resharded online, its writes are not blocked; instead
+ * each modified key is recorded so that the resharder can copy the key's
+ * entries again. Log keys are ordered by object version, so entries added
+ * after a pass has started sort after that pass's marker.
+ */
+static int write_reshard_log_key(cls_method_context_t hctx,
+				 const cls_rgw_obj_key& key)
+{
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%020llu.%05d_",
+	   (unsigned long long)cls_current_version(hctx),
+	   cls_current_subop_num(hctx));
+
+  string idx(1, BI_PREFIX_CHAR);
+  idx.append(bucket_index_prefixes[BI_BUCKET_RESHARD_LOG_INDEX]);
+  idx.append(buf);
+  idx.append(key.name);
+
+  bufferlist bl;
+  encode(key, bl);
+  return cls_cxx_map_set_val(hctx, idx, &bl);
+}
+
+static int reshard_log_index_operation(cls_method_context_t hctx,
+				       const rgw_bucket_dir_header& header,
+				       const cls_rgw_obj_key& key)
+{
+  if (!header.resharding_in_logrecord()) {
+    return 0;
+  }
+  return write_reshard_log_key(hctx, key);
+}
+
+/*
+ * Write paths that don't otherwise read the bucket header check this
+ * xattr instead. It is kept in step with the header's reshard status,
+ * and is read with the object's metadata rather than as a separate omap
+ * read. Shards that were never resharded online don't have it.
+ */
+static const char *reshard_logrecord_attr = "rgw.reshard_logrecord";
+
+static int set_reshard_logrecord_attr(cls_method_context_t hctx,
+				      bool was_logrecord, bool logrecord)
+{
+  if (logrecord == was_logrecord) {
+    return 0;
+  }
+  bufferlist bl;
+  encode(logrecord, bl);
+  return cls_cxx_setxattr(hctx, reshard_logrecord_attr, &bl);
+}
+
+static int reshard_log_index_operation(cls_method_context_t hctx,
+				       const cls_rgw_obj_key& key)
+{
+  bufferlist bl;
+  int rc = cls_cxx_getxattr(hctx, reshard_logrecord_attr, &bl);
+  if (rc == -ENODATA) {
+    return 0;
+  } else if (rc < 0) {
+    CLS_LOG(1, "ERROR: %s: failed to read %s attr, rc=%d",
+	    __func__, reshard_logrecord_attr, rc);
+    return rc;
+  }
+
+  bool logrecord = false;
+  try {
+    auto iter = bl.cbegin();
+    decode(logrecord, iter);
+  } catch (ceph::buffer::error& err) {
+    CLS_LOG(1, "ERROR: %s: failed to decode %s attr",
+	    __func__, reshard_logrecord_attr);
+    return -EIO;
+  }
+  if (!logrecord) {
+    return 0;
+  }
+  return write_reshard_log_key(hctx, key);
+}
+
 int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 {
   CLS_LOG(10, "entered %s", __func__);
 
-  // maximum number of calls to get_obj_vals we'll try; compromise
-  // between wanting to return the requested # of entries, but not
-  // wanting to slow down this op with too many omap reads
+  // maximum number of calls to get_obj_vals that add nothing to the
+  // result we'll try; compromise between wanting to return the
+  // requested # of entries, but not wanting to slow down this op with
+  // too many omap reads
   constexpr int max_attempts = 8;
 
+  // when a read ends inside a common prefix, the keys it returned past
+  // the first one under that prefix were wasted; shrink the next read
+  // down to this many keys so that skipping large "subdirectories"
+  // costs O(prefixes) rather than O(keys)
+  constexpr uint32_t min_delimiter_read = 8;
+
   auto iter = in->cbegin();
 
   rgw_cls_list_op op;
@@ -543,19 +633,26 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
     start_after_omap_key = cls_rgw_after_delim(start_after_omap_key);
   }
 
+  // number of keys to ask get_obj_vals for; only ever lowered below
+  // the remaining count when listing with a delimiter
+  uint32_t read_size = op.num_entries;
+
   for (int attempt = 0;
        attempt < max_attempts &&
 	 more &&
 	 !done &&
 	 name_entry_map.size() < op.num_entries;
-       ++attempt) {
+       /* empty */) {
     std::map<std::string, bufferlist> keys;
+    const size_t prev_result_size = name_entry_map.size();
+    bool read_ended_in_prefix = false;
 
     // note: get_obj_vals skips past the "ugly namespace" (i.e.,
     // entries that start with the BI_PREFIX_CHAR), so no need to
     // check for such entries
     rc = get_obj_vals(hctx, start_after_omap_key, op.filter_prefix,
-		      op.num_entries - name_entry_map.size(),
+		      std::min<uint32_t>(read_size,
+					 op.num_entries - name_entry_map.size()),
 		      &keys, &more);
     if (rc < 0) {
       return rc;
@@ -640,6 +737,7 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 	  // advance past this subdirectory, but then back up one,
 	  // so the loop increment will put us in the right place
 	  kiter = keys.lower_bound(start_after_omap_key);
+	  read_ended_in_prefix = (kiter == keys.cend());
 	  --kiter;
 
           continue;
@@ -658,6 +756,18 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 		int(name_entry_map.size()));
       }
     } // for (auto kiter...
+
+    if (read_ended_in_prefix) {
+      read_size = std::max(min_delimiter_read, read_size / 2);
+    } else {
+      read_size = std::min<uint32_t>(op.num_entries, read_size * 2);
+    }
+
+    // reads that made progress are bounded by op.num_entries, so only
+    // count the ones that did not
+    if (name_entry_map.size() == prev_result_size) {
+      ++attempt;
+    }
   } // for (int attempt...
 
   ret.is_truncated = more && !done;
@@ -944,6 +1054,14 @@ int rgw_bucket_prepare_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     return rc;
   }
 
+  rc = reshard_log_index_operation(hctx, op.key);
+  if (rc < 0) {
+    CLS_LOG_BITX(bitx_inst, 1,
+		 "ERROR: %s could not log key for reshard, key=%s, rc=%d",
+		 __func__, escape_str(idx).c_str(), rc);
+    return rc;
+  }
+
   CLS_LOG_BITX(bitx_inst, 10, "EXITING %s, returning 0", __func__);
   return 0;
 } // rgw_bucket_prepare_op
@@ -1075,51 +1193,24 @@ static int complete_remove_obj(cls_method_context_t hctx,
     CLS_LOG(1, "%s: cls_cxx_map_remove_key failed with %d", __func__, ret);
     return ret;
   }
-  return ret;
+  return reshard_log_index_operation(hctx, header, key);
 }
 
-int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+/*
+ * applies a single completion to the bucket index; the caller reads the
+ * bucket header before and writes it back after, which allows many
+ * completions to share one header update
+ */
+static int complete_op_apply(cls_method_context_t hctx,
+			     rgw_cls_obj_complete_op& op,
+			     rgw_bucket_dir_header& header,
+			     const bool bitx_inst)
 {
-  const ConfigProxy& conf = cls_get_config(hctx);
-  const object_info_t& oi = cls_get_object_info(hctx);
-
-  // bucket index transaction instrumentation
-  const bool bitx_inst =
-    conf->rgw_bucket_index_transaction_instrumentation;
-
-  CLS_LOG_BITX(bitx_inst, 10, "ENTERING %s for object oid=%s key=%s",
-	       __func__, oi.soid.oid.name.c_str(), oi.soid.get_key().c_str());
-
-  // decode request
-  rgw_cls_obj_complete_op op;
-  auto iter = in->cbegin();
-  try {
-    decode(op, iter);
-  } catch (ceph::buffer::error& err) {
-    CLS_LOG_BITX(bitx_inst, 1, "ERROR: %s: failed to decode request", __func__);
-    return -EINVAL;
-  }
-
-  CLS_LOG_BITX(bitx_inst, 1,
-	       "INFO: %s: request: op=%s name=%s ver=%lu:%llu tag=%s",
-	       __func__,
-	       modify_op_str(op.op).c_str(), op.key.to_string().c_str(),
-	       (unsigned long)op.ver.pool, (unsigned long long)op.ver.epoch,
-	       op.tag.c_str());
-
-  rgw_bucket_dir_header header;
-  int rc = read_bucket_header(hctx, &header);
-  if (rc < 0) {
-    CLS_LOG_BITX(bitx_inst, 1, "ERROR: %s: failed to read header, rc=%d",
-		 __func__, rc);
-    return -EINVAL;
-  }
-
   rgw_bucket_dir_entry entry;
   bool ondisk = true;
 
   std::string idx;
-  rc = read_key_entry(hctx, op.key, &idx, &entry);
+  int rc = read_key_entry(hctx, op.key, &idx, &entry);
   if (rc == -ENOENT) {
     entry.key = op.key;
     entry.ver = op.ver;
@@ -1271,6 +1362,14 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     }
   }
 
+  rc = reshard_log_index_operation(hctx, header, op.key);
+  if (rc < 0) {
+    CLS_LOG_BITX(bitx_inst, 0,
+		 "ERROR: %s: reshard_log_index_operation failed with rc=%d",
+		 __func__, rc);
+    return rc;
+  }
+
   CLS_LOG_BITX(bitx_inst, 20, "INFO: %s: remove_objs.size()=%d",
 	       __func__, (int)op.remove_objs.size());
   for (const auto& remove_key : op.remove_objs) {
@@ -1287,6 +1386,51 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     }
   } // remove loop
 
+  return 0;
+} // complete_op_apply
+
+int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  const ConfigProxy& conf = cls_get_config(hctx);
+  const object_info_t& oi = cls_get_object_info(hctx);
+
+  // bucket index transaction instrumentation
+  const bool bitx_inst =
+    conf->rgw_bucket_index_transaction_instrumentation;
+
+  CLS_LOG_BITX(bitx_inst, 10, "ENTERING %s for object oid=%s key=%s",
+	       __func__, oi.soid.oid.name.c_str(), oi.soid.get_key().c_str());
+
+  // decode request
+  rgw_cls_obj_complete_op op;
+  auto iter = in->cbegin();
+  try {
+    decode(op, iter);
+  } catch (ceph::buffer::error& err) {
+    CLS_LOG_BITX(bitx_inst, 1, "ERROR: %s: failed to decode request", __func__);
+    return -EINVAL;
+  }
+
+  CLS_LOG_BITX(bitx_inst, 1,
+	       "INFO: %s: request: op=%s name=%s ver=%lu:%llu tag=%s",
+	       __func__,
+	       modify_op_str(op.op).c_str(), op.key.to_string().c_str(),
+	       (unsigned long)op.ver.pool, (unsigned long long)op.ver.epoch,
+	       op.tag.c_str());
+
+  rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG_BITX(bitx_inst, 1, "ERROR: %s: failed to read header, rc=%d",
+		 __func__, rc);
+    return -EINVAL;
+  }
+
+  rc = complete_op_apply(hctx, op, header, bitx_inst);
+  if (rc < 0) {
+    return rc;
+  }
+
   CLS_LOG_BITX(bitx_inst, 0,
 	       "INFO: %s: writing bucket header", __func__);
   rc = write_bucket_header(hctx, &header);
@@ -1301,6 +1445,98 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
   return rc;
 } // rgw_bucket_complete_op
 
+int rgw_bucket_complete_op_batch(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  const ConfigProxy& conf = cls_get_config(hctx);
+  const object_info_t& oi = cls_get_object_info(hctx);
+
+  // bucket index transaction instrumentation
+  const bool bitx_inst =
+    conf->rgw_bucket_index_transaction_instrumentation;
+
+  CLS_LOG_BITX(bitx_inst, 10, "ENTERING %s for object oid=%s key=%s",
+	       __func__, oi.soid.oid.name.c_str(), oi.soid.get_key().c_str());
+
+  // decode request
+  rgw_cls_obj_complete_batch_op batch;
+  auto iter = in->cbegin();
+  try {
+    decode(batch, iter);
+  } catch (ceph::buffer::error& err) {
+    CLS_LOG_BITX(bitx_inst, 1, "ERROR: %s: failed to decode request", __func__);
+    return -EINVAL;
+  }
+
+  CLS_LOG_BITX(bitx_inst, 1, "INFO: %s: request: %zu ops",
+	       __func__, batch.ops.size());
+
+  // omap reads don't see the writes queued earlier in this call, so a
+  // second op on the same key would apply on top of the stale entry and
+  // account for it twice; callers must send such ops in separate batches
+  std::set<cls_rgw_obj_key> keys;
+  for (const auto& op : batch.ops) {
+    bool unique = keys.insert(op.key).second;
+    for (const auto& k : op.remove_objs) {
+      unique = keys.insert(k).second && unique;
+    }
+    if (!unique) {
+      CLS_LOG_BITX(bitx_inst, 1,
+		   "ERROR: %s: key=%s appears more than once in the batch",
+		   __func__, op.key.to_string().c_str());
+      return -EINVAL;
+    }
+  }
+
+  rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG_BITX(bitx_inst, 1, "ERROR: %s: failed to read header, rc=%d",
+		 __func__, rc);
+    return -EINVAL;
+  }
+
+  // all ops share this method call's transaction, so a failure to
+  // write the index would lose every op in the batch; a completion
+  // that is rejected before it writes anything (e.g., its pending tag
+  // is gone) would have failed on its own as well, so skip it rather
+  // than failing the others
+  for (auto& op : batch.ops) {
+    CLS_LOG_BITX(bitx_inst, 20,
+		 "INFO: %s: op=%s name=%s ver=%lu:%llu tag=%s",
+		 __func__,
+		 modify_op_str(op.op).c_str(), op.key.to_string().c_str(),
+		 (unsigned long)op.ver.pool, (unsigned long long)op.ver.epoch,
+		 op.tag.c_str());
+
+    // the bilog key is derived from the index version and this method
+    // call, so each op needs its own version or it overwrites the entry
+    // logged by the previous one
+    ++header.ver;
+    rc = complete_op_apply(hctx, op, header, bitx_inst);
+    if (rc == -EINVAL) {
+      CLS_LOG_BITX(bitx_inst, 1,
+		   "WARNING: %s: skipping completion of key=%s, rc=%d",
+		   __func__, op.key.to_string().c_str(), rc);
+      continue;
+    } else if (rc < 0) {
+      return rc;
+    }
+  }
+
+  CLS_LOG_BITX(bitx_inst, 20,
+	       "INFO: %s: writing bucket header", __func__);
+  rc = write_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG_BITX(bitx_inst, 0,
+		 "ERROR: %s: failed to write bucket header ret=%d",
+		 __func__, rc);
+  }
+
+  CLS_LOG_BITX(bitx_inst, 10,
+	       "EXITING %s: returning %d", __func__, rc);
+  return rc;
+} // rgw_bucket_complete_op_batch
+
 template <class T>
 static int write_entry(cls_method_context_t hctx, T& entry, const string& key)
 {
@@ -1908,7 +2144,7 @@ static int rgw_bucket_link_olh(cls_method_context_t hctx, bufferlist *in, buffer
   }
 
   if (!op.log_op) {
-   return 0;
+    return reshard_log_index_operation(hctx, op.key);
   }
 
   rgw_bucket_dir_header header;
@@ -1917,6 +2153,10 @@ static int rgw_bucket_link_olh(cls_method_context_t hctx, bufferlist *in, buffer
     CLS_LOG(1, "ERROR: rgw_bucket_link_olh(): failed to read header\n");
     return ret;
   }
+  ret = reshard_log_index_operation(hctx, header, op.key);
+  if (ret < 0) {
+    return ret;
+  }
   if (header.syncstopped) {
     return 0;
   }
@@ -2074,7 +2314,7 @@ static int rgw_bucket_unlink_instance(cls_method_context_t hctx, bufferlist *in,
   }
 
   if (!op.log_op) {
-    return 0;
+    return reshard_log_index_operation(hctx, op.key);
   }
 
   rgw_bucket_dir_header header;
@@ -2083,6 +2323,10 @@ static int rgw_bucket_unlink_instance(cls_method_context_t hctx, bufferlist *in,
     CLS_LOG(1, "ERROR: rgw_bucket_unlink_instance(): failed to read header\n");
     return ret;
   }
+  ret = reshard_log_index_operation(hctx, header, op.key);
+  if (ret < 0) {
+    return ret;
+  }
   if (header.syncstopped) {
     return 0;
   }
@@ -2205,7 +2449,7 @@ static int rgw_bucket_trim_olh_log(cls_method_context_t hctx, bufferlist *in, bu
     return ret;
   }
 
-  return 0;
+  return reshard_log_index_operation(hctx, op.olh);
 }
 
 static int rgw_bucket_clear_olh(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
@@ -2247,6 +2491,11 @@ static int rgw_bucket_clear_olh(cls_method_context_t hctx, bufferlist *in, buffe
     return ret;
   }
 
+  ret = reshard_log_index_operation(hctx, op.key);
+  if (ret < 0) {
+    return ret;
+  }
+
   rgw_bucket_dir_entry plain_entry;
 
   /* read plain entry, make sure it's a versioned place holder */
@@ -2412,6 +2661,13 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx,
       }
       rgw_bucket_category_stats& stats = header.stats[cur_change.meta.category];
 
+      ret = reshard_log_index_operation(hctx, header, cur_change.key);
+      if (ret < 0) {
+	CLS_LOG_BITX(bitx_inst, 0, "ERROR: %s: failed to log key for reshard ret=%d",
+		     __func__, ret);
+	return ret;
+      }
+
       switch(op) {
       case CEPH_RGW_REMOVE:
 	CLS_LOG_BITX(bitx_inst, 10,
@@ -4474,8 +4730,17 @@ static int rgw_set_bucket_resharding(cls_method_context_t hctx, bufferlist *in,
     return rc;
   }
 
+  const bool was_logrecord = header.resharding_in_logrecord();
   header.new_instance.set_status(op.entry.reshard_status);
 
+  rc = set_reshard_logrecord_attr(hctx, was_logrecord,
+				  header.resharding_in_logrecord());
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: %s: failed to set %s attr, rc=%d",
+	    __func__, reshard_logrecord_attr, rc);
+    return rc;
+  }
+
   return write_bucket_header(hctx, &header);
 }
 
@@ -4498,8 +4763,17 @@ static int rgw_clear_bucket_resharding(cls_method_context_t hctx, bufferlist *in
     CLS_LOG(1, "ERROR: %s: failed to read header", __func__);
     return rc;
   }
+  const bool was_logrecord = header.resharding_in_logrecord();
   header.new_instance.clear();
 
+  rc = set_reshard_logrecord_attr(hctx, was_logrecord,
+				  header.resharding_in_logrecord());
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: %s: failed to set %s attr, rc=%d",
+	    __func__, reshard_logrecord_attr, rc);
+    return rc;
+  }
+
   return write_bucket_header(hctx, &header);
 }
 
@@ -4523,7 +4797,8 @@ static int rgw_guard_bucket_resharding(cls_method_context_t hctx, bufferlist *in
     return rc;
   }
 
-  if (header.resharding()) {
+  // writes continue while the shard records a reshard log
+  if (header.resharding() && !header.resharding_in_logrecord()) {
     return op.ret_err;
   }
 
@@ -4572,6 +4847,7 @@ CLS_INIT(rgw)
   cls_method_handle_t h_rgw_bucket_update_stats;
   cls_method_handle_t h_rgw_bucket_prepare_op;
   cls_method_handle_t h_rgw_bucket_complete_op;
+  cls_method_handle_t h_rgw_bucket_complete_op_batch;
   cls_method_handle_t h_rgw_bucket_link_olh;
   cls_method_handle_t h_rgw_bucket_unlink_instance_op;
   cls_method_handle_t h_rgw_bucket_read_olh_log;
@@ -4622,6 +4898,7 @@ CLS_INIT(rgw)
   cls_register_cxx_method(h_class, RGW_BUCKET_UPDATE_STATS, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_update_stats, &h_rgw_bucket_update_stats);
   cls_register_cxx_method(h_class, RGW_BUCKET_PREPARE_OP, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_prepare_op, &h_rgw_bucket_prepare_op);
   cls_register_cxx_method(h_class, RGW_BUCKET_COMPLETE_OP, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_complete_op, &h_rgw_bucket_complete_op);
+  cls_register_cxx_method(h_class, RGW_BUCKET_COMPLETE_OP_BATCH, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_complete_op_batch, &h_rgw_bucket_complete_op_batch);
   cls_register_cxx_method(h_class, RGW_BUCKET_LINK_OLH, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_link_olh, &h_rgw_bucket_link_olh);
   cls_register_cxx_method(h_class, RGW_BUCKET_UNLINK_INSTANCE, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_unlink_instance, &h_rgw_bucket_unlink_instance_op);
   cls_register_cxx_method(h_class, RGW_BUCKET_READ_OLH_LOG, CLS_METHOD_RD, rgw_bucket_read_olh_log, &h_rgw_bucket_read_olh_log);
@@ -307,6 +307,16 @@ void cls_rgw_bucket_complete_op(ObjectWriteOperation& o, RGWModifyOp op, const s
   o.exec(RGW_CLASS, RGW_BUCKET_COMPLETE_OP, in);
 }
 
+void cls_rgw_bucket_complete_op_batch(ObjectWriteOperation& o,
+                                      const vector<rgw_cls_obj_complete_op>& ops)
+{
+  bufferlist in;
+  rgw_cls_obj_complete_batch_op call;
+  call.ops = ops;
+  encode(call, in);
+  o.exec(RGW_CLASS, RGW_BUCKET_COMPLETE_OP_BATCH, in);
+}
+
 void cls_rgw_bucket_list_op(librados::ObjectReadOperation& op,
                             const cls_rgw_obj_key& start_obj,
                             const std::string& filter_prefix,
@@ -357,6 +357,12 @@ void cls_rgw_bucket_complete_op(librados::ObjectWriteOperation& o, RGWModifyOp o
 				const std::list<cls_rgw_obj_key> *remove_objs, bool log_op,
                                 uint16_t bilog_op, const rgw_zone_set *zones_trace);
 
+// applies many completions destined for the same bucket index shard
+// object in a single class method call; requires an osd that supports
+// bucket_complete_op_batch, older ones will fail with -EOPNOTSUPP
+void cls_rgw_bucket_complete_op_batch(librados::ObjectWriteOperation& o,
+                                      const std::vector<rgw_cls_obj_complete_op>& ops);
+
 void cls_rgw_remove_obj(librados::ObjectWriteOperation& o, std::list<std::string>& keep_attr_prefixes);
 void cls_rgw_obj_store_pg_ver(librados::ObjectWriteOperation& o, const std::string& attr);
 void cls_rgw_obj_check_attrs_prefix(librados::ObjectOperation& o, const std::string& prefix, bool fail_if_exist);
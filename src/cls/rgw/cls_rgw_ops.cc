@@ -168,6 +168,25 @@ void rgw_cls_obj_complete_op::dump(Formatter *f) const
   encode_json("zones_trace", zones_trace, f);
 }
 
+void rgw_cls_obj_complete_batch_op::generate_test_instances(list<rgw_cls_obj_complete_batch_op*>& o)
+{
+  rgw_cls_obj_complete_batch_op *op = new rgw_cls_obj_complete_batch_op;
+  list<rgw_cls_obj_complete_op*> l;
+  rgw_cls_obj_complete_op::generate_test_instances(l);
+  for (auto i : l) {
+    op->ops.push_back(*i);
+    delete i;
+  }
+  o.push_back(op);
+
+  o.push_back(new rgw_cls_obj_complete_batch_op);
+}
+
+void rgw_cls_obj_complete_batch_op::dump(Formatter *f) const
+{
+  encode_json("ops", ops, f);
+}
+
 void rgw_cls_link_olh_op::generate_test_instances(list<rgw_cls_link_olh_op*>& o)
 {
   rgw_cls_link_olh_op *op = new rgw_cls_link_olh_op;
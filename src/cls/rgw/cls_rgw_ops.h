@@ -164,6 +164,25 @@ struct rgw_cls_obj_complete_op
 };
 WRITE_CLASS_ENCODER(rgw_cls_obj_complete_op)
 
+struct rgw_cls_obj_complete_batch_op
+{
+  std::vector<rgw_cls_obj_complete_op> ops;
+
+  void encode(ceph::buffer::list &bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(ops, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(ceph::buffer::list::const_iterator &bl) {
+    DECODE_START(1, bl);
+    decode(ops, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<rgw_cls_obj_complete_batch_op*>& o);
+};
+WRITE_CLASS_ENCODER(rgw_cls_obj_complete_batch_op)
+
 struct rgw_cls_link_olh_op {
   cls_rgw_obj_key key;
   std::string olh_tag;
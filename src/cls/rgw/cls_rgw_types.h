@@ -776,9 +776,14 @@ inline bool operator!=(const rgw_bucket_category_stats& lhs,
 enum class cls_rgw_reshard_status : uint8_t {
   NOT_RESHARDING  = 0,
   IN_PROGRESS     = 1,
-  DONE            = 2
+  DONE            = 2,
+  IN_LOGRECORD    = 3
 };
 
+/* special bucket index entries under this prefix record the keys that
+ * were modified while a shard was IN_LOGRECORD */
+#define RGW_BI_RESHARD_LOG_PREFIX "1002_"
+
 inline std::string to_string(const cls_rgw_reshard_status status)
 {
   switch (status) {
@@ -788,6 +793,8 @@ inline std::string to_string(const cls_rgw_reshard_status status)
     return "in-progress";
   case cls_rgw_reshard_status::DONE:
     return "done";
+  case cls_rgw_reshard_status::IN_LOGRECORD:
+    return "in-logrecord";
   };
   return "Unknown reshard status";
 }
@@ -834,6 +841,9 @@ struct cls_rgw_bucket_instance_entry {
   bool resharding_in_progress() const {
     return reshard_status == RESHARD_STATUS::IN_PROGRESS;
   }
+  bool resharding_in_logrecord() const {
+    return reshard_status == RESHARD_STATUS::IN_LOGRECORD;
+  }
 };
 WRITE_CLASS_ENCODER(cls_rgw_bucket_instance_entry)
 
@@ -897,6 +907,9 @@ struct rgw_bucket_dir_header {
   bool resharding_in_progress() const {
     return new_instance.resharding_in_progress();
   }
+  bool resharding_in_logrecord() const {
+    return new_instance.resharding_in_logrecord();
+  }
 };
 WRITE_CLASS_ENCODER(rgw_bucket_dir_header)
 
@@ -780,6 +780,7 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
 
     bool skip_partial_discard = true;
     ASSIGN_OPTION(non_blocking_aio, bool);
+    ASSIGN_OPTION(io_run_to_completion, bool);
     ASSIGN_OPTION(cache, bool);
     ASSIGN_OPTION(sparse_read_threshold_bytes, Option::size_t);
     ASSIGN_OPTION(clone_copy_on_read, bool);
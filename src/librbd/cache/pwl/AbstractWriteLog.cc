@@ -75,6 +75,10 @@ AbstractWriteLog<I>::AbstractWriteLog(
 {
   CephContext *cct = m_image_ctx.cct;
   m_plugin_api.get_image_timer_instance(cct, &m_timer, &m_timer_lock);
+  m_flush_window_ops = m_image_ctx.config.template get_val<uint64_t>(
+    "rbd_persistent_cache_flush_window_ops");
+  m_flush_window_bytes = m_image_ctx.config.template get_val<Option::size_t>(
+    "rbd_persistent_cache_flush_window_bytes");
 }
 
 template <typename I>
@@ -669,6 +673,7 @@ void AbstractWriteLog<I>::shut_down(Context *on_finish) {
       ldout(m_image_ctx.cct, 6) << "waiting for in flight operations" << dendl;
       // Wait for in progress IOs to complete
       next_ctx = util::create_async_context_callback(&m_work_queue, next_ctx);
+      cancel_deferred_appends();
       m_async_op_tracker.wait_for_ops(next_ctx);
     });
   ctx = new LambdaContext(
@@ -1640,8 +1645,8 @@ bool AbstractWriteLog<I>::can_flush_entry(std::shared_ptr<GenericLogEntry> log_e
   }
 
   return (log_entry->can_writeback() &&
-         (m_flush_ops_in_flight <= IN_FLIGHT_FLUSH_WRITE_LIMIT) &&
-         (m_flush_bytes_in_flight <= IN_FLIGHT_FLUSH_BYTES_LIMIT));
+         (static_cast<uint64_t>(m_flush_ops_in_flight) <= m_flush_window_ops) &&
+         (static_cast<uint64_t>(m_flush_bytes_in_flight) <= m_flush_window_bytes));
 }
 
 template <typename I>
@@ -1746,7 +1751,7 @@ void AbstractWriteLog<I>::process_writeback_dirty_entries() {
 
     std::shared_lock entry_reader_locker(m_entry_reader_lock);
     std::lock_guard locker(m_lock);
-    while (flushed < IN_FLIGHT_FLUSH_WRITE_LIMIT) {
+    while (static_cast<uint64_t>(flushed) < m_flush_window_ops) {
       if (m_shutting_down) {
         ldout(cct, 5) << "Flush during shutdown supressed" << dendl;
         /* Do flush complete only when all flush ops are finished */
@@ -212,8 +212,6 @@ private:
   /* Throttle writes concurrently allocating & replicating */
   unsigned int m_free_lanes = pwl::MAX_CONCURRENT_WRITES;
 
-  SafeTimer *m_timer = nullptr; /* Used with m_timer_lock */
-  mutable ceph::mutex *m_timer_lock = nullptr; /* Used with and by m_timer */
   Context *m_timer_ctx = nullptr;
 
   ThreadPool m_thread_pool;
@@ -264,6 +262,13 @@ protected:
 
   ImageCtxT &m_image_ctx;
 
+  /* Bounds on writeback to the image in flight at once */
+  uint64_t m_flush_window_ops;
+  uint64_t m_flush_window_bytes;
+
+  SafeTimer *m_timer = nullptr; /* Used with m_timer_lock */
+  mutable ceph::mutex *m_timer_lock = nullptr; /* Used with and by m_timer */
+
   std::string m_log_pool_name;
   uint64_t m_log_pool_size;
 
@@ -390,6 +395,8 @@ protected:
   virtual void schedule_flush_and_append(
       pwl::GenericLogOperationsVector &ops) {}
   virtual void persist_last_flushed_sync_gen() {}
+  /* Called on shut down, before waiting for in flight operations */
+  virtual void cancel_deferred_appends() {}
   virtual void reserve_cache(C_BlockIORequestT *req, bool &alloc_succeeds,
                              bool &no_space) {}
   virtual void construct_flush_entries(pwl::GenericLogEntries entries_to_flush,
@@ -5,6 +5,7 @@
 #include "include/ceph_assert.h"
 #include "librbd/Utils.h"
 #include "librbd/cache/pwl/LogEntry.h"
+#include <bitset>
 
 namespace librbd {
 namespace cache {
@@ -35,9 +36,12 @@ LogMapEntry<T>::LogMapEntry(std::shared_ptr<T> log_entry)
 
 template <typename T>
 LogMap<T>::LogMap(CephContext *cct)
-  : m_cct(cct),
-    m_lock(ceph::make_mutex(pwl::unique_lock_name(
-           "librbd::cache::pwl::LogMap::m_lock", this))) {
+  : m_cct(cct) {
+  for (unsigned int i = 0; i < LOG_MAP_STRIPES; ++i) {
+    m_stripes.emplace_back(std::make_unique<Stripe>(pwl::unique_lock_name(
+      "librbd::cache::pwl::LogMap::m_lock", this) + "::" +
+      std::to_string(i)));
+  }
 }
 
 /**
@@ -55,16 +59,19 @@ LogMap<T>::LogMap(CephContext *cct)
  */
 template <typename T>
 void LogMap<T>::add_log_entry(std::shared_ptr<T> log_entry) {
-  std::lock_guard locker(m_lock);
-  add_log_entry_locked(log_entry);
+  auto block_extent = log_entry->block_extent();
+  auto locks = lock_stripes(block_extent);
+  for_each_stripe_extent(block_extent,
+    [this, &log_entry](Stripe &stripe, const BlockExtent &stripe_extent) {
+      add_log_entry_locked(stripe, stripe_extent, log_entry);
+    });
 }
 
 template <typename T>
 void LogMap<T>::add_log_entries(std::list<std::shared_ptr<T>> &log_entries) {
-  std::lock_guard locker(m_lock);
   ldout(m_cct, 20) << dendl;
   for (auto &log_entry : log_entries) {
-    add_log_entry_locked(log_entry);
+    add_log_entry(log_entry);
   }
 }
 
@@ -74,16 +81,19 @@ void LogMap<T>::add_log_entries(std::list<std::shared_ptr<T>> &log_entries) {
  */
 template <typename T>
 void LogMap<T>::remove_log_entry(std::shared_ptr<T> log_entry) {
-  std::lock_guard locker(m_lock);
-  remove_log_entry_locked(log_entry);
+  auto block_extent = log_entry->block_extent();
+  auto locks = lock_stripes(block_extent);
+  for_each_stripe_extent(block_extent,
+    [this, &log_entry](Stripe &stripe, const BlockExtent &stripe_extent) {
+      remove_log_entry_locked(stripe, stripe_extent, log_entry);
+    });
 }
 
 template <typename T>
 void LogMap<T>::remove_log_entries(std::list<std::shared_ptr<T>> &log_entries) {
-  std::lock_guard locker(m_lock);
   ldout(m_cct, 20) << dendl;
   for (auto &log_entry : log_entries) {
-    remove_log_entry_locked(log_entry);
+    remove_log_entry(log_entry);
   }
 }
 
@@ -96,85 +106,152 @@ void LogMap<T>::remove_log_entries(std::list<std::shared_ptr<T>> &log_entries) {
  */
 template <typename T>
 std::list<std::shared_ptr<T>> LogMap<T>::find_log_entries(BlockExtent block_extent) {
-  std::lock_guard locker(m_lock);
-  ldout(m_cct, 20) << dendl;
-  return find_log_entries_locked(block_extent);
+  std::list<std::shared_ptr<T>> overlaps;
+  ldout(m_cct, 20) << "block_extent=" << block_extent << dendl;
+
+  LogMapEntries<T> map_entries = find_map_entries(block_extent);
+  for (auto &map_entry : map_entries) {
+    overlaps.emplace_back(map_entry.log_entry);
+  }
+  return overlaps;
 }
 
 /**
  * Returns the list of all write log map entries that overlap the
- * specified block extent.
+ * specified block extent, in block order.
  */
 template <typename T>
 LogMapEntries<T> LogMap<T>::find_map_entries(BlockExtent block_extent) {
-  std::lock_guard locker(m_lock);
+  LogMapEntries<T> overlaps;
   ldout(m_cct, 20) << dendl;
-  return find_map_entries_locked(block_extent);
+
+  auto locks = lock_stripes(block_extent);
+  for_each_stripe_extent(block_extent,
+    [this, &overlaps](Stripe &stripe, const BlockExtent &stripe_extent) {
+      find_map_entries_locked(stripe, stripe_extent, &overlaps);
+    });
+  return overlaps;
 }
 
+/**
+ * Locks every stripe the extent maps to, always in stripe order so
+ * concurrent multi-stripe operations can't deadlock.
+ */
 template <typename T>
-void LogMap<T>::add_log_entry_locked(std::shared_ptr<T> log_entry) {
-  LogMapEntry<T> map_entry(log_entry);
+typename LogMap<T>::StripeLocks LogMap<T>::lock_stripes(
+    const BlockExtent &block_extent) {
+  std::bitset<LOG_MAP_STRIPES> stripes;
+  uint64_t first_unit = block_extent.block_start / LOG_MAP_STRIPE_UNIT;
+  uint64_t last_unit = first_unit;
+  if (block_extent.block_end > block_extent.block_start) {
+    last_unit = (block_extent.block_end - 1) / LOG_MAP_STRIPE_UNIT;
+  }
+  if (last_unit - first_unit + 1 >= LOG_MAP_STRIPES) {
+    stripes.set();
+  } else {
+    for (auto unit = first_unit; unit <= last_unit; ++unit) {
+      stripes.set(unit % LOG_MAP_STRIPES);
+    }
+  }
+
+  StripeLocks locks;
+  for (unsigned int i = 0; i < LOG_MAP_STRIPES; ++i) {
+    if (stripes.test(i)) {
+      locks.emplace_back(m_stripes[i]->lock);
+    }
+  }
+  return locks;
+}
+
+/**
+ * Invokes f for each stripe unit aligned piece of the extent, in block
+ * order.
+ */
+template <typename T>
+template <typename F>
+void LogMap<T>::for_each_stripe_extent(const BlockExtent &block_extent,
+                                       F &&f) {
+  uint64_t block_start = block_extent.block_start;
+  do {
+    uint64_t unit = block_start / LOG_MAP_STRIPE_UNIT;
+    uint64_t block_end = std::min(block_extent.block_end,
+                                  (unit + 1) * LOG_MAP_STRIPE_UNIT);
+    f(*m_stripes[unit % LOG_MAP_STRIPES], BlockExtent(block_start, block_end));
+    block_start = block_end;
+  } while (block_start < block_extent.block_end);
+}
+
+template <typename T>
+void LogMap<T>::add_log_entry_locked(Stripe &stripe,
+                                     const BlockExtent &block_extent,
+                                     std::shared_ptr<T> log_entry) {
+  LogMapEntry<T> map_entry(block_extent, log_entry);
   ldout(m_cct, 20) << "block_extent=" << map_entry.block_extent
                    << dendl;
-  ceph_assert(ceph_mutex_is_locked_by_me(m_lock));
-  LogMapEntries<T> overlap_entries = find_map_entries_locked(map_entry.block_extent);
+  ceph_assert(ceph_mutex_is_locked_by_me(stripe.lock));
+  LogMapEntries<T> overlap_entries;
+  find_map_entries_locked(stripe, map_entry.block_extent, &overlap_entries);
   for (auto &entry : overlap_entries) {
     ldout(m_cct, 20) << entry << dendl;
     if (map_entry.block_extent.block_start <= entry.block_extent.block_start) {
       if (map_entry.block_extent.block_end >= entry.block_extent.block_end) {
         ldout(m_cct, 20) << "map entry completely occluded by new log entry" << dendl;
-        remove_map_entry_locked(entry);
+        remove_map_entry_locked(stripe, entry);
       } else {
         ceph_assert(map_entry.block_extent.block_end < entry.block_extent.block_end);
         /* The new entry occludes the beginning of the old entry */
         BlockExtent adjusted_extent(map_entry.block_extent.block_end,
                                     entry.block_extent.block_end);
-        adjust_map_entry_locked(entry, adjusted_extent);
+        adjust_map_entry_locked(stripe, entry, adjusted_extent);
       }
     } else {
       if (map_entry.block_extent.block_end >= entry.block_extent.block_end) {
         /* The new entry occludes the end of the old entry */
         BlockExtent adjusted_extent(entry.block_extent.block_start,
                                     map_entry.block_extent.block_start);
-        adjust_map_entry_locked(entry, adjusted_extent);
+        adjust_map_entry_locked(stripe, entry, adjusted_extent);
       } else {
         /* The new entry splits the old entry */
-        split_map_entry_locked(entry, map_entry.block_extent);
+        split_map_entry_locked(stripe, entry, map_entry.block_extent);
       }
     }
   }
-  add_map_entry_locked(map_entry);
+  add_map_entry_locked(stripe, map_entry);
 }
 
 template <typename T>
-void LogMap<T>::remove_log_entry_locked(std::shared_ptr<T> log_entry) {
+void LogMap<T>::remove_log_entry_locked(Stripe &stripe,
+                                        const BlockExtent &block_extent,
+                                        std::shared_ptr<T> log_entry) {
   ldout(m_cct, 20) << "*log_entry=" << *log_entry << dendl;
-  ceph_assert(ceph_mutex_is_locked_by_me(m_lock));
+  ceph_assert(ceph_mutex_is_locked_by_me(stripe.lock));
 
-  LogMapEntries<T> possible_hits = find_map_entries_locked(log_entry->block_extent());
+  LogMapEntries<T> possible_hits;
+  find_map_entries_locked(stripe, block_extent, &possible_hits);
   for (auto &possible_hit : possible_hits) {
     if (possible_hit.log_entry == log_entry) {
       /* This map entry refers to the specified log entry */
-      remove_map_entry_locked(possible_hit);
+      remove_map_entry_locked(stripe, possible_hit);
     }
   }
 }
 
 template <typename T>
-void LogMap<T>::add_map_entry_locked(LogMapEntry<T> &map_entry) {
+void LogMap<T>::add_map_entry_locked(Stripe &stripe,
+                                     LogMapEntry<T> &map_entry) {
   ceph_assert(map_entry.log_entry);
-  m_block_to_log_entry_map.insert(map_entry);
+  stripe.block_to_log_entry_map.insert(map_entry);
   map_entry.log_entry->inc_map_ref();
 }
 
 template <typename T>
-void LogMap<T>::remove_map_entry_locked(LogMapEntry<T> &map_entry) {
-  auto it = m_block_to_log_entry_map.find(map_entry);
-  ceph_assert(it != m_block_to_log_entry_map.end());
+void LogMap<T>::remove_map_entry_locked(Stripe &stripe,
+                                        LogMapEntry<T> &map_entry) {
+  auto it = stripe.block_to_log_entry_map.find(map_entry);
+  ceph_assert(it != stripe.block_to_log_entry_map.end());
 
   LogMapEntry<T> erased = *it;
-  m_block_to_log_entry_map.erase(it);
+  stripe.block_to_log_entry_map.erase(it);
   erased.log_entry->dec_map_ref();
   if (0 == erased.log_entry->get_map_ref()) {
     ldout(m_cct, 20) << "log entry has zero map entries: " << erased.log_entry << dendl;
@@ -182,66 +259,60 @@ void LogMap<T>::remove_map_entry_locked(LogMapEntry<T> &map_entry) {
 }
 
 template <typename T>
-void LogMap<T>::adjust_map_entry_locked(LogMapEntry<T> &map_entry, BlockExtent &new_extent) {
-  auto it = m_block_to_log_entry_map.find(map_entry);
-  ceph_assert(it != m_block_to_log_entry_map.end());
+void LogMap<T>::adjust_map_entry_locked(Stripe &stripe,
+                                        LogMapEntry<T> &map_entry,
+                                        BlockExtent &new_extent) {
+  auto it = stripe.block_to_log_entry_map.find(map_entry);
+  ceph_assert(it != stripe.block_to_log_entry_map.end());
 
   LogMapEntry<T> adjusted = *it;
-  m_block_to_log_entry_map.erase(it);
+  stripe.block_to_log_entry_map.erase(it);
 
-  m_block_to_log_entry_map.insert(LogMapEntry<T>(new_extent, adjusted.log_entry));
+  stripe.block_to_log_entry_map.insert(
+    LogMapEntry<T>(new_extent, adjusted.log_entry));
 }
 
 template <typename T>
-void LogMap<T>::split_map_entry_locked(LogMapEntry<T> &map_entry, BlockExtent &removed_extent) {
-  auto it = m_block_to_log_entry_map.find(map_entry);
-  ceph_assert(it != m_block_to_log_entry_map.end());
+void LogMap<T>::split_map_entry_locked(Stripe &stripe,
+                                       LogMapEntry<T> &map_entry,
+                                       BlockExtent &removed_extent) {
+  auto it = stripe.block_to_log_entry_map.find(map_entry);
+  ceph_assert(it != stripe.block_to_log_entry_map.end());
 
   LogMapEntry<T> split = *it;
-  m_block_to_log_entry_map.erase(it);
+  stripe.block_to_log_entry_map.erase(it);
 
   BlockExtent left_extent(split.block_extent.block_start,
                           removed_extent.block_start);
-  m_block_to_log_entry_map.insert(LogMapEntry<T>(left_extent, split.log_entry));
+  stripe.block_to_log_entry_map.insert(
+    LogMapEntry<T>(left_extent, split.log_entry));
 
   BlockExtent right_extent(removed_extent.block_end,
                            split.block_extent.block_end);
-  m_block_to_log_entry_map.insert(LogMapEntry<T>(right_extent, split.log_entry));
+  stripe.block_to_log_entry_map.insert(
+    LogMapEntry<T>(right_extent, split.log_entry));
 
   split.log_entry->inc_map_ref();
 }
 
-template <typename T>
-std::list<std::shared_ptr<T>> LogMap<T>::find_log_entries_locked(const BlockExtent &block_extent) {
-  std::list<std::shared_ptr<T>> overlaps;
-  ldout(m_cct, 20) << "block_extent=" << block_extent << dendl;
-
-  ceph_assert(ceph_mutex_is_locked_by_me(m_lock));
-  LogMapEntries<T> map_entries = find_map_entries_locked(block_extent);
-  for (auto &map_entry : map_entries) {
-    overlaps.emplace_back(map_entry.log_entry);
-  }
-  return overlaps;
-}
-
 /**
  * TODO: Generalize this to do some arbitrary thing to each map
  * extent, instead of returning a list.
  */
 template <typename T>
-LogMapEntries<T> LogMap<T>::find_map_entries_locked(const BlockExtent &block_extent) {
-  LogMapEntries<T> overlaps;
-
+void LogMap<T>::find_map_entries_locked(Stripe &stripe,
+                                        const BlockExtent &block_extent,
+                                        LogMapEntries<T> *overlaps) {
   ldout(m_cct, 20) << "block_extent=" << block_extent << dendl;
-  ceph_assert(ceph_mutex_is_locked_by_me(m_lock));
-  auto p = m_block_to_log_entry_map.equal_range(LogMapEntry<T>(block_extent));
+  ceph_assert(ceph_mutex_is_locked_by_me(stripe.lock));
+  auto p = stripe.block_to_log_entry_map.equal_range(
+    LogMapEntry<T>(block_extent));
   ldout(m_cct, 20) << "count=" << std::distance(p.first, p.second) << dendl;
   for ( auto i = p.first; i != p.second; ++i ) {
     LogMapEntry<T> entry = *i;
-    overlaps.emplace_back(entry);
+    overlaps->emplace_back(entry);
     ldout(m_cct, 20) << entry << dendl;
   }
-  return overlaps;
 }
 
 /* We map block extents to write log entries, or portions of write log
@@ -6,6 +6,9 @@
 
 #include "librbd/BlockGuard.h"
 #include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace librbd {
 namespace cache {
@@ -49,15 +52,6 @@ public:
   LogMapEntries<T> find_map_entries(BlockExtent block_extent);
 
 private:
-  void add_log_entry_locked(std::shared_ptr<T> log_entry);
-  void remove_log_entry_locked(std::shared_ptr<T> log_entry);
-  void add_map_entry_locked(LogMapEntry<T> &map_entry);
-  void remove_map_entry_locked(LogMapEntry<T> &map_entry);
-  void adjust_map_entry_locked(LogMapEntry<T> &map_entry, BlockExtent &new_extent);
-  void split_map_entry_locked(LogMapEntry<T> &map_entry, BlockExtent &removed_extent);
-  std::list<std::shared_ptr<T>> find_log_entries_locked(const BlockExtent &block_extent);
-  LogMapEntries<T> find_map_entries_locked(const BlockExtent &block_extent);
-
   using LogMapEntryT = LogMapEntry<T>;
 
   class LogMapEntryCompare {
@@ -69,9 +63,41 @@ private:
   using BlockExtentToLogMapEntries = std::set<LogMapEntryT,
                                               LogMapEntryCompare>;
 
+  /*
+   * The block space is striped across independently locked maps so that
+   * IO to unrelated regions of the image doesn't serialize on one lock.
+   * Map entries never cross a stripe unit boundary.
+   */
+  struct Stripe {
+    ceph::mutex lock;
+    BlockExtentToLogMapEntries block_to_log_entry_map;
+
+    Stripe(const std::string &lock_name)
+      : lock(ceph::make_mutex(lock_name)) {
+    }
+  };
+
+  typedef std::vector<std::unique_lock<ceph::mutex>> StripeLocks;
+
+  StripeLocks lock_stripes(const BlockExtent &block_extent);
+  template <typename F>
+  void for_each_stripe_extent(const BlockExtent &block_extent, F &&f);
+
+  void add_log_entry_locked(Stripe &stripe, const BlockExtent &block_extent,
+                            std::shared_ptr<T> log_entry);
+  void remove_log_entry_locked(Stripe &stripe, const BlockExtent &block_extent,
+                               std::shared_ptr<T> log_entry);
+  void add_map_entry_locked(Stripe &stripe, LogMapEntry<T> &map_entry);
+  void remove_map_entry_locked(Stripe &stripe, LogMapEntry<T> &map_entry);
+  void adjust_map_entry_locked(Stripe &stripe, LogMapEntry<T> &map_entry,
+                               BlockExtent &new_extent);
+  void split_map_entry_locked(Stripe &stripe, LogMapEntry<T> &map_entry,
+                              BlockExtent &removed_extent);
+  void find_map_entries_locked(Stripe &stripe, const BlockExtent &block_extent,
+                               LogMapEntries<T> *overlaps);
+
   CephContext *m_cct;
-  ceph::mutex m_lock;
-  BlockExtentToLogMapEntries m_block_to_log_entry_map;
+  std::vector<std::unique_ptr<Stripe>> m_stripes;
 };
 
 } //namespace pwl
@@ -166,9 +166,6 @@ namespace pwl {
 
 class ImageExtentBuf;
 
-const int IN_FLIGHT_FLUSH_WRITE_LIMIT = 64;
-const int IN_FLIGHT_FLUSH_BYTES_LIMIT = (1 * 1024 * 1024);
-
 /* Limit work between sync points */
 const uint64_t MAX_WRITES_PER_SYNC_POINT = 256;
 const uint64_t MAX_BYTES_PER_SYNC_POINT = (1024 * 1024 * 8);
@@ -197,6 +194,10 @@ const int RETIRE_BATCH_TIME_LIMIT_MS = 250;
 const uint64_t CONTROL_BLOCK_MAX_LOG_ENTRIES = 32;
 const uint64_t SPAN_MAX_DATA_LEN = (16 * 1024 * 1024);
 
+/**** Log map ****/
+const uint64_t LOG_MAP_STRIPE_UNIT = (4 * 1024 * 1024);
+const unsigned int LOG_MAP_STRIPES = 16;
+
 /* offset of ring on SSD */
 const uint64_t DATA_RING_BUFFER_OFFSET = 8192;
 
@@ -17,6 +17,7 @@
 #include "librbd/cache/pwl/ImageCacheState.h"
 #include "librbd/cache/pwl/LogEntry.h"
 #include <map>
+#include <set>
 #include <vector>
 
 #undef dout_subsys
@@ -55,7 +56,9 @@ WriteLog<I>::WriteLog(
     cache::ImageWritebackInterface& image_writeback,
     plugin::Api<I>& plugin_api)
   : AbstractWriteLog<I>(image_ctx, cache_state, create_builder(),
-                        image_writeback, plugin_api)
+                        image_writeback, plugin_api),
+    m_append_batch_us(image_ctx.config.template get_val<uint64_t>(
+      "rbd_persistent_cache_append_batch_us"))
 {
 }
 
@@ -386,6 +389,56 @@ void WriteLog<I>::enlist_op_appender() {
   this->m_work_queue.queue(append_ctx);
 }
 
+/*
+ * Gives writes arriving shortly after this one the chance to share its
+ * control block and SSD write instead of each being appended on its own.
+ */
+template<typename I>
+void WriteLog<I>::schedule_append_batch() {
+  {
+    std::lock_guard timer_locker(*m_timer_lock);
+    if (m_append_batch_ctx != nullptr) {
+      return;
+    }
+
+    if (!m_append_batch_stopped) {
+      m_append_batch_ctx = new LambdaContext([this](int r) {
+          /* m_timer_lock is held */
+          m_append_batch_ctx = nullptr;
+          enlist_op_appender();
+        });
+      m_timer->add_event_after(m_append_batch_us / 1000000.0,
+                               m_append_batch_ctx);
+      return;
+    }
+  }
+
+  /* shutting down, don't wait for more writes */
+  enlist_op_appender();
+}
+
+/*
+ * Stops deferring appends, and appends whatever the batch timer was
+ * holding back, so the timer can't fire after the work queue stopped.
+ */
+template<typename I>
+void WriteLog<I>::cancel_deferred_appends() {
+  bool need_finisher = false;
+  {
+    std::lock_guard timer_locker(*m_timer_lock);
+    m_append_batch_stopped = true;
+    if (m_append_batch_ctx != nullptr) {
+      m_timer->cancel_event(m_append_batch_ctx);
+      m_append_batch_ctx = nullptr;
+      need_finisher = true;
+    }
+  }
+
+  if (need_finisher) {
+    enlist_op_appender();
+  }
+}
+
 /*
  * Takes custody of ops. They'll all get their log entries appended,
  * and have their on_write_persist contexts completed once they and
@@ -394,6 +447,7 @@ void WriteLog<I>::enlist_op_appender() {
 template<typename I>
 void WriteLog<I>::schedule_append_ops(GenericLogOperations &ops, C_BlockIORequestT *req) {
   bool need_finisher = false;
+  bool need_batch_timer = false;
   GenericLogOperationsVector appending;
 
   std::copy(std::begin(ops), std::end(ops), std::back_inserter(appending));
@@ -401,13 +455,21 @@ void WriteLog<I>::schedule_append_ops(GenericLogOperations &ops, C_BlockIOReques
     std::lock_guard locker(m_lock);
 
     bool persist_on_flush = this->get_persist_on_flush();
+    bool batch_full = (this->m_ops_to_append.size() + ops.size() >=
+                         CONTROL_BLOCK_MAX_LOG_ENTRIES);
     need_finisher = !this->m_appending &&
        ((this->m_ops_to_append.size() >= CONTROL_BLOCK_MAX_LOG_ENTRIES) ||
         !persist_on_flush);
 
     // Only flush logs into SSD when there is internal/external flush request
+    bool has_sync_point = has_sync_point_logs(ops);
     if (!need_finisher) {
-      need_finisher = has_sync_point_logs(ops);
+      need_finisher = has_sync_point;
+    } else if (!persist_on_flush && m_append_batch_us > 0 && !batch_full &&
+               !has_sync_point) {
+      // wait a little for more writes to share this append
+      need_finisher = false;
+      need_batch_timer = true;
     }
     this->m_ops_to_append.splice(this->m_ops_to_append.end(), ops);
 
@@ -425,6 +487,8 @@ void WriteLog<I>::schedule_append_ops(GenericLogOperations &ops, C_BlockIOReques
 
   if (need_finisher) {
     this->enlist_op_appender();
+  } else if (need_batch_timer) {
+    schedule_append_batch();
   }
 
   for (auto &op : appending) {
@@ -575,6 +639,9 @@ void WriteLog<I>::construct_flush_entries(pwl::GenericLogEntries entries_to_flus
       this->detain_flush_guard_request(log_entry, guarded_ctx);
     }
   } else {
+    std::set<GenericLogEntry*> superseded;
+    prepare_writeback(entries_to_flush, &superseded);
+
     int count = entries_to_flush.size();
     std::vector<std::shared_ptr<GenericWriteLogEntry>> write_entries;
     std::vector<bufferlist *> read_bls;
@@ -583,7 +650,7 @@ void WriteLog<I>::construct_flush_entries(pwl::GenericLogEntries entries_to_flus
     read_bls.reserve(count);
 
     for (auto &log_entry : entries_to_flush) {
-      if (log_entry->is_write_entry()) {
+      if (log_entry->is_write_entry() && !superseded.count(log_entry.get())) {
 	bufferlist *bl = new bufferlist;
 	auto write_entry = static_pointer_cast<WriteLogEntry>(log_entry);
 	write_entry->inc_bl_refs();
@@ -593,32 +660,53 @@ void WriteLog<I>::construct_flush_entries(pwl::GenericLogEntries entries_to_flus
     }
 
     Context *ctx = new LambdaContext(
-      [this, entries_to_flush, read_bls](int r) {
+      [this, entries_to_flush, superseded, read_bls](int r) {
         int i = 0;
-	GuardedRequestFunctionContext *guarded_ctx = nullptr;
-
-	for (auto &log_entry : entries_to_flush) {
-	  if (log_entry->is_write_entry()) {
+        WritebackRun run;
+
+        for (auto &log_entry : entries_to_flush) {
+          if (superseded.count(log_entry.get())) {
+            /* Overwritten later in this batch: only retire it in order */
+            flush_writeback_run(run);
+            auto guarded_ctx = new GuardedRequestFunctionContext(
+              [this, log_entry](GuardedRequestFunctionContext &guard_ctx) {
+                log_entry->m_cell = guard_ctx.cell;
+                ldout(m_image_ctx.cct, 15) << "superseded:" << log_entry
+                                           << " " << *log_entry << dendl;
+                Context *ctx = this->construct_flush_entry(log_entry, false);
+                ctx->complete(0);
+              });
+            this->detain_flush_guard_request(log_entry, guarded_ctx);
+          } else if (log_entry->is_write_entry()) {
 	    bufferlist captured_entry_bl;
 	    captured_entry_bl.claim_append(*read_bls[i]);
 	    delete read_bls[i++];
 
-	    guarded_ctx = new GuardedRequestFunctionContext([this, log_entry, captured_entry_bl]
-              (GuardedRequestFunctionContext &guard_ctx) {
-                log_entry->m_cell = guard_ctx.cell;
-                Context *ctx = this->construct_flush_entry(log_entry, false);
+            if (!log_entry->ram_entry.is_write()) {
+              flush_writeback_run(run);
+              writeback_entry(log_entry, std::move(captured_entry_bl));
+              continue;
+            }
 
-	        m_image_ctx.op_work_queue->queue(new LambdaContext(
-	          [this, log_entry, entry_bl=std::move(captured_entry_bl), ctx](int r) {
-		    auto captured_entry_bl = std::move(entry_bl);
-		    ldout(m_image_ctx.cct, 15) << "flushing:" << log_entry
-			                       << " " << *log_entry << dendl;
-		    log_entry->writeback_bl(this->m_image_writeback, ctx,
-                                            std::move(captured_entry_bl));
-	          }), 0);
-	      });
+            /* Adjacent writes of one sync gen go back as a single write */
+            auto &ram_entry = log_entry->ram_entry;
+            if (!run.entries.empty() &&
+                (run.entries.back()->ram_entry.sync_gen_number !=
+                   ram_entry.sync_gen_number ||
+                 run.image_offset + run.bl.length() !=
+                   ram_entry.image_offset_bytes ||
+                 run.bl.length() + ram_entry.write_bytes >
+                   this->m_flush_window_bytes)) {
+              flush_writeback_run(run);
+            }
+            if (run.entries.empty()) {
+              run.image_offset = ram_entry.image_offset_bytes;
+            }
+            run.entries.push_back(log_entry);
+            run.bl.claim_append(captured_entry_bl);
 	  } else {
-	    guarded_ctx = new GuardedRequestFunctionContext([this, log_entry]
+            flush_writeback_run(run);
+	    auto guarded_ctx = new GuardedRequestFunctionContext([this, log_entry]
               (GuardedRequestFunctionContext &guard_ctx) {
                 log_entry->m_cell = guard_ctx.cell;
                 Context *ctx = this->construct_flush_entry(log_entry, false);
@@ -629,15 +717,158 @@ void WriteLog<I>::construct_flush_entries(pwl::GenericLogEntries entries_to_flus
 		    log_entry->writeback(this->m_image_writeback, ctx);
 		  }), 0);
             });
+            this->detain_flush_guard_request(log_entry, guarded_ctx);
 	  }
-          this->detain_flush_guard_request(log_entry, guarded_ctx);
 	}
+        flush_writeback_run(run);
       });
 
     aio_read_data_blocks(write_entries, read_bls, ctx);
   }
 }
 
+/*
+ * Drops the data of entries fully overwritten by a later entry of the same
+ * sync gen in this batch, and orders the batch by image offset when that
+ * can't change the outcome (no remaining overlaps), so that adjacent
+ * writes can be merged and go back in object order.
+ */
+template <typename I>
+void WriteLog<I>::prepare_writeback(
+    pwl::GenericLogEntries &entries_to_flush,
+    std::set<GenericLogEntry*> *superseded) {
+  std::vector<std::shared_ptr<GenericLogEntry>> entries(
+    entries_to_flush.begin(), entries_to_flush.end());
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    auto &ram_entry = (*it)->ram_entry;
+    if (!ram_entry.is_writer()) {
+      continue;
+    }
+    auto extent = ram_entry.block_extent();
+    for (auto later = std::next(it); later != entries.end(); ++later) {
+      auto &later_ram_entry = (*later)->ram_entry;
+      /* discards may leave partial granules in place */
+      if (later_ram_entry.sync_gen_number != ram_entry.sync_gen_number ||
+          !(later_ram_entry.is_write() || later_ram_entry.is_writesame())) {
+        continue;
+      }
+      auto later_extent = later_ram_entry.block_extent();
+      if (later_extent.block_start <= extent.block_start &&
+          later_extent.block_end >= extent.block_end) {
+        superseded->insert(it->get());
+        break;
+      }
+    }
+  }
+
+  std::vector<std::pair<BlockExtent, std::shared_ptr<GenericLogEntry>>> extents;
+  for (auto &log_entry : entries) {
+    if (log_entry->is_sync_point()) {
+      return;
+    }
+    if (!superseded->count(log_entry.get())) {
+      extents.emplace_back(log_entry->ram_entry.block_extent(), log_entry);
+    }
+  }
+  std::stable_sort(extents.begin(), extents.end(),
+                   [](auto &lhs, auto &rhs) {
+                     return lhs.first.block_start < rhs.first.block_start;
+                   });
+  for (size_t i = 1; i < extents.size(); ++i) {
+    if (extents[i - 1].first.block_end > extents[i].first.block_start) {
+      return;
+    }
+  }
+
+  /* superseded entries go first: they issue no IO */
+  entries_to_flush.remove_if([superseded](auto &log_entry) {
+      return !superseded->count(log_entry.get());
+    });
+  for (auto &extent : extents) {
+    entries_to_flush.push_back(extent.second);
+  }
+}
+
+template <typename I>
+void WriteLog<I>::writeback_entry(std::shared_ptr<GenericLogEntry> log_entry,
+                                  bufferlist &&entry_bl) {
+  auto guarded_ctx = new GuardedRequestFunctionContext(
+    [this, log_entry, entry_bl=std::move(entry_bl)]
+    (GuardedRequestFunctionContext &guard_ctx) mutable {
+      log_entry->m_cell = guard_ctx.cell;
+      Context *ctx = this->construct_flush_entry(log_entry, false);
+
+      m_image_ctx.op_work_queue->queue(new LambdaContext(
+        [this, log_entry, entry_bl=std::move(entry_bl), ctx](int r) {
+          auto captured_entry_bl = std::move(entry_bl);
+          ldout(m_image_ctx.cct, 15) << "flushing:" << log_entry
+                                     << " " << *log_entry << dendl;
+          log_entry->writeback_bl(this->m_image_writeback, ctx,
+                                  std::move(captured_entry_bl));
+        }), 0);
+    });
+  this->detain_flush_guard_request(log_entry, guarded_ctx);
+}
+
+/*
+ * Issues one image write for a run of adjacent write entries once every
+ * entry of the run holds its flush guard cell. Entries of a run are
+ * consecutive in the batch, so the cells they wait on can't in turn wait
+ * on the run.
+ */
+template <typename I>
+void WriteLog<I>::flush_writeback_run(WritebackRun &run) {
+  if (run.entries.empty()) {
+    return;
+  }
+  if (run.entries.size() == 1) {
+    writeback_entry(run.entries.front(), std::move(run.bl));
+    run = WritebackRun();
+    return;
+  }
+
+  struct State {
+    uint64_t image_offset;
+    bufferlist bl;
+    std::vector<Context*> on_finishes;
+    std::atomic<size_t> pending;
+  };
+  auto state = std::make_shared<State>();
+  state->image_offset = run.image_offset;
+  state->bl = std::move(run.bl);
+  state->on_finishes.resize(run.entries.size());
+  state->pending = run.entries.size();
+  ldout(m_image_ctx.cct, 15) << "coalescing " << run.entries.size()
+                             << " entries into " << run.image_offset << "~"
+                             << state->bl.length() << dendl;
+
+  for (size_t i = 0; i < run.entries.size(); ++i) {
+    auto log_entry = run.entries[i];
+    auto guarded_ctx = new GuardedRequestFunctionContext(
+      [this, log_entry, state, i](GuardedRequestFunctionContext &guard_ctx) {
+        log_entry->m_cell = guard_ctx.cell;
+        state->on_finishes[i] = this->construct_flush_entry(log_entry, false);
+        if (--state->pending > 0) {
+          return;
+        }
+
+        m_image_ctx.op_work_queue->queue(new LambdaContext(
+          [this, state](int r) {
+            Context *ctx = new LambdaContext([state](int r) {
+                for (auto on_finish : state->on_finishes) {
+                  on_finish->complete(r);
+                }
+              });
+            uint64_t length = state->bl.length();
+            this->m_image_writeback.aio_write({{state->image_offset, length}},
+                                              std::move(state->bl), 0, ctx);
+          }), 0);
+      });
+    this->detain_flush_guard_request(log_entry, guarded_ctx);
+  }
+  run = WritebackRun();
+}
+
 template <typename I>
 void WriteLog<I>::process_work() {
   CephContext *cct = m_image_ctx.cct;
@@ -860,6 +1091,27 @@ void WriteLog<I>::append_ops(GenericLogOperations &ops, Context *ctx,
   *new_first_free_entry = pool_root.first_free_entry;
   AioTransContext* aio = new AioTransContext(cct, ctx);
 
+  // Control blocks are laid out back to back in the ring, so the whole
+  // append is issued as a few large sequential writes rather than one
+  // write per control block.
+  uint64_t write_pos = *new_first_free_entry;
+  bufferlist write_bl;
+  auto append_control_block = [&]() {
+    if (log_entries.size() > 1) {
+      bytes_to_free += (log_entries.size() - 1) * MIN_WRITE_ALLOC_SSD_SIZE;
+    }
+    uint64_t control_block_pos = *new_first_free_entry;
+    bufferlist bl;
+    write_log_entries(log_entries, new_first_free_entry, &bl);
+    if (write_bl.length() > 0 &&
+        write_bl.length() + bl.length() > SPAN_MAX_DATA_LEN) {
+      aio_write_log(write_pos, write_bl, aio);
+      write_bl.clear();
+      write_pos = control_block_pos;
+    }
+    write_bl.claim_append(bl);
+  };
+
   utime_t now = ceph_clock_now();
   for (auto &operation : ops) {
     operation->log_append_start_time = now;
@@ -867,10 +1119,7 @@ void WriteLog<I>::append_ops(GenericLogOperations &ops, Context *ctx,
 
     if (log_entries.size() == CONTROL_BLOCK_MAX_LOG_ENTRIES ||
         span_payload_len >= SPAN_MAX_DATA_LEN) {
-      if (log_entries.size() > 1) {
-        bytes_to_free += (log_entries.size() - 1) * MIN_WRITE_ALLOC_SSD_SIZE;
-      }
-      write_log_entries(log_entries, aio, new_first_free_entry);
+      append_control_block();
       log_entries.clear();
       span_payload_len = 0;
     }
@@ -878,10 +1127,10 @@ void WriteLog<I>::append_ops(GenericLogOperations &ops, Context *ctx,
     span_payload_len += log_entry->write_bytes();
   }
   if (!span_payload_len || !log_entries.empty()) {
-    if (log_entries.size() > 1) {
-      bytes_to_free += (log_entries.size() - 1) * MIN_WRITE_ALLOC_SSD_SIZE;
-    }
-    write_log_entries(log_entries, aio, new_first_free_entry);
+    append_control_block();
+  }
+  if (write_bl.length() > 0) {
+    aio_write_log(write_pos, write_bl, aio);
   }
 
   {
@@ -895,8 +1144,7 @@ void WriteLog<I>::append_ops(GenericLogOperations &ops, Context *ctx,
 
 template <typename I>
 void WriteLog<I>::write_log_entries(GenericLogEntriesVector log_entries,
-                                    AioTransContext *aio, uint64_t *pos) {
-  CephContext *cct = m_image_ctx.cct;
+                                    uint64_t *pos, bufferlist *bl) {
   ldout(m_image_ctx.cct, 20) << "pos=" << *pos << dendl;
   ceph_assert(*pos >= DATA_RING_BUFFER_OFFSET &&
               *pos < this->m_log_pool_size &&
@@ -931,33 +1179,44 @@ void WriteLog<I>::write_log_entries(GenericLogEntriesVector log_entries,
     persist_log_entries.push_back(log_entry->ram_entry);
   }
 
-  //aio write
-  bufferlist bl;
-  encode(persist_log_entries, bl);
-  ceph_assert(bl.length() <= MIN_WRITE_ALLOC_SSD_SIZE);
-  bl.append_zero(MIN_WRITE_ALLOC_SSD_SIZE - bl.length());
-  bl.append(data_bl);
-  ceph_assert(bl.length() % MIN_WRITE_ALLOC_SSD_SIZE == 0);
-  if (control_block_pos + bl.length() > this->m_log_pool_size) {
+  bufferlist control_block_bl;
+  encode(persist_log_entries, control_block_bl);
+  ceph_assert(control_block_bl.length() <= MIN_WRITE_ALLOC_SSD_SIZE);
+  control_block_bl.append_zero(
+    MIN_WRITE_ALLOC_SSD_SIZE - control_block_bl.length());
+  control_block_bl.claim_append(data_bl);
+  ceph_assert(control_block_bl.length() % MIN_WRITE_ALLOC_SSD_SIZE == 0);
+  bl->claim_append(control_block_bl);
+}
+
+/*
+ * Writes a contiguous span of the log ring starting at pos, wrapping
+ * around to the start of the ring if needed.
+ */
+template <typename I>
+void WriteLog<I>::aio_write_log(uint64_t pos, bufferlist &bl,
+                                AioTransContext *aio) {
+  CephContext *cct = m_image_ctx.cct;
+  if (pos + bl.length() > this->m_log_pool_size) {
     //exceeds border, need to split
     uint64_t size = bl.length();
     bufferlist bl1;
-    bl.splice(0, this->m_log_pool_size - control_block_pos, &bl1);
+    bl.splice(0, this->m_log_pool_size - pos, &bl1);
     ceph_assert(bl.length() == (size - bl1.length()));
 
-    ldout(cct, 20) << "write " << control_block_pos << "~"
+    ldout(cct, 20) << "write " << pos << "~"
 		   << size << " spans boundary, split into "
-		   << control_block_pos << "~" << bl1.length()
+		   << pos << "~" << bl1.length()
 		   << " and " << DATA_RING_BUFFER_OFFSET << "~"
 		   << bl.length() << dendl;
-    bdev->aio_write(control_block_pos, bl1, &aio->ioc, false,
+    bdev->aio_write(pos, bl1, &aio->ioc, false,
                     WRITE_LIFE_NOT_SET);
     bdev->aio_write(DATA_RING_BUFFER_OFFSET, bl, &aio->ioc, false,
                     WRITE_LIFE_NOT_SET);
   } else {
-    ldout(cct, 20) << "write " << control_block_pos << "~"
+    ldout(cct, 20) << "write " << pos << "~"
                    << bl.length() << dendl;
-    bdev->aio_write(control_block_pos, bl, &aio->ioc, false,
+    bdev->aio_write(pos, bl, &aio->ioc, false,
                     WRITE_LIFE_NOT_SET);
   }
 }
@@ -22,6 +22,8 @@
 #include "librbd/cache/pwl/ssd/Types.h"
 #include <functional>
 #include <list>
+#include <set>
+#include <vector>
 
 namespace librbd {
 
@@ -62,6 +64,8 @@ protected:
   using AbstractWriteLog<ImageCtxT>::m_first_free_entry;
   using AbstractWriteLog<ImageCtxT>::m_first_valid_entry;
   using AbstractWriteLog<ImageCtxT>::m_bytes_allocated;
+  using AbstractWriteLog<ImageCtxT>::m_timer;
+  using AbstractWriteLog<ImageCtxT>::m_timer_lock;
 
   bool initialize_pool(Context *on_finish,
                        pwl::DeferredContexts &later) override;
@@ -69,6 +73,7 @@ protected:
   void append_scheduled_ops(void) override;
   void schedule_append_ops(pwl::GenericLogOperations &ops, C_BlockIORequestT *req) override;
   void remove_pool_file() override;
+  void cancel_deferred_appends() override;
   void release_ram(std::shared_ptr<GenericLogEntry> log_entry) override;
 
 private:
@@ -95,10 +100,21 @@ private:
       : root(r), ctx(c) {}
   };
 
+  struct WritebackRun {
+    uint64_t image_offset = 0;
+    bufferlist bl;
+    std::vector<std::shared_ptr<GenericLogEntry>> entries;
+  };
+
   using WriteLogPoolRootUpdateList = std::list<std::shared_ptr<WriteLogPoolRootUpdate>>;
   WriteLogPoolRootUpdateList m_poolroot_to_update; /* pool root list to update to SSD */
   bool m_updating_pool_root = false;
 
+  /* Group commit: max delay before a partial batch is appended */
+  uint64_t m_append_batch_us = 0;
+  Context *m_append_batch_ctx = nullptr; /* Used with m_timer_lock */
+  bool m_append_batch_stopped = false; /* Used with m_timer_lock */
+
   std::atomic<int> m_async_update_superblock = {0};
   BlockDevice *bdev = nullptr;
   pwl::WriteLogPoolRoot pool_root;
@@ -118,6 +134,7 @@ private:
       std::vector<std::shared_ptr<GenericWriteLogEntry>> &log_entries_to_read,
       std::vector<bufferlist*> &bls_to_read, Context *ctx) override;
   void enlist_op_appender();
+  void schedule_append_batch();
   bool retire_entries(const unsigned long int frees_per_tx);
   bool has_sync_point_logs(GenericLogOperations &ops);
   void append_op_log_entries(GenericLogOperations &ops);
@@ -125,10 +142,16 @@ private:
   void construct_flush_entries(pwl::GenericLogEntries entires_to_flush,
 				DeferredContexts &post_unlock,
 				bool has_write_entry) override;
+  void prepare_writeback(pwl::GenericLogEntries &entries_to_flush,
+                         std::set<GenericLogEntry*> *superseded);
+  void writeback_entry(std::shared_ptr<GenericLogEntry> log_entry,
+                       bufferlist &&entry_bl);
+  void flush_writeback_run(WritebackRun &run);
   void append_ops(GenericLogOperations &ops, Context *ctx,
                   uint64_t* new_first_free_entry);
   void write_log_entries(GenericLogEntriesVector log_entries,
-                         AioTransContext *aio, uint64_t *pos);
+                         uint64_t *pos, bufferlist *bl);
+  void aio_write_log(uint64_t pos, bufferlist &bl, AioTransContext *aio);
   void schedule_update_root(std::shared_ptr<WriteLogPoolRoot> root,
                             Context *ctx);
   void enlist_op_update_root();
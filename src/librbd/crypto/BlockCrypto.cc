@@ -5,12 +5,50 @@
 #include "include/byteorder.h"
 #include "include/ceph_assert.h"
 #include "include/scope_guard.h"
+#include "include/intarith.h"
+#include "common/Cond.h"
+#include "common/WorkQueue.h"
 
 #include <stdlib.h>
 
 namespace librbd {
 namespace crypto {
 
+namespace {
+
+// shared by all encrypted images of a client. the pool is sized from
+// rbd_crypto_worker_threads when the first IO is split and keeps that size;
+// later changes of the option only limit how many chunks an IO is split in
+class ThreadPoolSingleton : public ThreadPool {
+public:
+  const uint64_t threads;
+  ContextWQ *work_queue;
+
+  explicit ThreadPoolSingleton(CephContext *cct)
+    : ThreadPool(cct, "librbd::crypto", "tp_librbd_crypt",
+                 cct->_conf.get_val<uint64_t>("rbd_crypto_worker_threads")),
+      threads(cct->_conf.get_val<uint64_t>("rbd_crypto_worker_threads")),
+      work_queue(new ContextWQ("librbd::crypto::work_queue",
+                               ceph::make_timespan(
+                                 cct->_conf.get_val<uint64_t>("rbd_op_thread_timeout")),
+                               this)) {
+    start();
+  }
+  ~ThreadPoolSingleton() override {
+    work_queue->drain();
+    delete work_queue;
+
+    stop();
+  }
+};
+
+ThreadPoolSingleton* get_thread_pool(CephContext *cct) {
+  return &cct->lookup_or_create_singleton_object<ThreadPoolSingleton>(
+    "librbd::crypto::thread_pool", false, cct);
+}
+
+} // anonymous namespace
+
 template <typename T>
 BlockCrypto<T>::BlockCrypto(CephContext* cct, DataCryptor<T>* data_cryptor,
                             uint64_t block_size, uint64_t data_offset)
@@ -43,12 +81,65 @@ int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
     return -EINVAL;
   }
 
-  unsigned char* iv = (unsigned char*)alloca(m_iv_size);
-  memset(iv, 0, m_iv_size);
-
   bufferlist src = *data;
   data->clear();
 
+  uint64_t length = src.length();
+  auto appender = data->get_contiguous_appender(length);
+  auto out_buf_ptr = reinterpret_cast<unsigned char*>(
+          appender.get_pos_add(length));
+
+  auto worker_threads = m_cct->_conf.get_val<uint64_t>(
+    "rbd_crypto_worker_threads");
+  if (worker_threads == 0 ||
+      length < m_cct->_conf.get_val<Option::size_t>(
+        "rbd_crypto_parallel_min_bytes")) {
+    return crypt_chunk(src, image_offset, out_buf_ptr, mode);
+  }
+
+  auto thread_pool = get_thread_pool(m_cct);
+  uint64_t chunks = std::min({worker_threads, thread_pool->threads,
+                              length / m_block_size - 1}) + 1;
+  uint64_t chunk_size = p2roundup((length + chunks - 1) / chunks,
+                                  m_block_size);
+  if (thread_pool->threads == 0 || chunk_size >= length) {
+    return crypt_chunk(src, image_offset, out_buf_ptr, mode);
+  }
+
+  // the first chunk is processed by the calling thread while the remaining
+  // chunks are processed by the crypto worker threads. encrypt() and
+  // decrypt() return the result, so the calling thread then blocks until
+  // the workers are done, which is still sooner than processing the whole
+  // IO on its own
+  C_SaferCond cond;
+  C_GatherBuilder gather(m_cct, &cond);
+  auto work_queue = thread_pool->work_queue;
+  for (uint64_t off = chunk_size; off < length; off += chunk_size) {
+    bufferlist chunk;
+    chunk.substr_of(src, off, std::min(chunk_size, length - off));
+    auto on_finish = gather.new_sub();
+    work_queue->queue(new LambdaContext(
+      [this, chunk=std::move(chunk), offset=image_offset + off,
+       out=out_buf_ptr + off, mode, on_finish](int) {
+        on_finish->complete(crypt_chunk(chunk, offset, out, mode));
+      }));
+  }
+  gather.activate();
+
+  bufferlist chunk;
+  chunk.substr_of(src, 0, chunk_size);
+  int r = crypt_chunk(chunk, image_offset, out_buf_ptr, mode);
+  int gather_r = cond.wait();
+  return (r < 0 ? r : gather_r);
+}
+
+template <typename T>
+int BlockCrypto<T>::crypt_chunk(const ceph::bufferlist& src,
+                                uint64_t image_offset,
+                                unsigned char* out_buf_ptr, CipherMode mode) {
+  unsigned char* iv = (unsigned char*)alloca(m_iv_size);
+  memset(iv, 0, m_iv_size);
+
   auto ctx = m_data_cryptor->get_context(mode);
   if (ctx == nullptr) {
     lderr(m_cct) << "unable to get crypt context" << dendl;
@@ -59,8 +150,7 @@ int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
       m_data_cryptor->return_context(ctx, mode); });
 
   auto sector_number = image_offset / 512;
-  auto appender = data->get_contiguous_appender(src.length());
-  unsigned char* out_buf_ptr = nullptr;
+  unsigned char* block_out_ptr = nullptr;
   unsigned char* leftover_block = (unsigned char*)alloca(m_block_size);
   uint32_t leftover_size = 0;
   for (auto buf = src.buffers().begin(); buf != src.buffers().end(); ++buf) {
@@ -76,8 +166,8 @@ int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
           return r;
         }
 
-        out_buf_ptr = reinterpret_cast<unsigned char*>(
-                appender.get_pos_add(m_block_size));
+        block_out_ptr = out_buf_ptr;
+        out_buf_ptr += m_block_size;
         sector_number += m_block_size / 512;
       }
 
@@ -93,13 +183,13 @@ int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
       int crypto_output_length = 0;
       if (leftover_size == 0) {
         crypto_output_length = m_data_cryptor->update_context(
-              ctx, in_buf_ptr, out_buf_ptr, m_block_size);
+              ctx, in_buf_ptr, block_out_ptr, m_block_size);
 
         in_buf_ptr += m_block_size;
         remaining_buf_bytes -= m_block_size;
       } else if (leftover_size == m_block_size) {
         crypto_output_length = m_data_cryptor->update_context(
-              ctx, leftover_block, out_buf_ptr, m_block_size);
+              ctx, leftover_block, block_out_ptr, m_block_size);
         leftover_size = 0;
       }
 
@@ -108,7 +198,7 @@ int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
         return crypto_output_length;
       }
 
-      out_buf_ptr += crypto_output_length;
+      block_out_ptr += crypto_output_length;
     }
   }
 
@@ -50,6 +50,8 @@ private:
     uint32_t m_iv_size;
 
     int crypt(ceph::bufferlist* data, uint64_t image_offset, CipherMode mode);
+    int crypt_chunk(const ceph::bufferlist& src, uint64_t image_offset,
+                    unsigned char* out_buf_ptr, CipherMode mode);
 };
 
 } // namespace crypto
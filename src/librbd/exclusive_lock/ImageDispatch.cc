@@ -217,6 +217,12 @@ bool ImageDispatch<I>::flush(
   return false;
 }
 
+template <typename I>
+bool ImageDispatch<I>::may_block(bool read_op) const {
+  std::shared_lock locker{m_lock};
+  return is_lock_required(read_op);
+}
+
 template <typename I>
 bool ImageDispatch<I>::is_lock_required(bool read_op) const {
   ceph_assert(ceph_mutex_is_locked(m_lock));
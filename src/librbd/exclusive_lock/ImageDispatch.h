@@ -103,6 +103,8 @@ public:
     return false;
   }
 
+  bool may_block(bool read_op) const override;
+
 private:
   typedef std::list<Context*> Contexts;
   typedef std::unordered_set<uint64_t> Tids;
@@ -99,7 +99,7 @@ void AioCompletion::complete() {
 
   state = AIO_STATE_CALLBACK;
   if (complete_cb) {
-    if (external_callback) {
+    if (external_callback && !ictx->io_run_to_completion) {
       complete_external_callback();
     } else {
       complete_cb(rbd_comp, complete_arg);
@@ -8,11 +8,11 @@
 #include "include/Context.h"
 #include "common/ceph_mutex.h"
 #include "common/dout.h"
-#include "common/AsyncOpTracker.h"
 #include "librbd/Utils.h"
 #include "librbd/io/DispatcherInterface.h"
 #include "librbd/io/Types.h"
 #include <map>
+#include <memory>
 
 #define dout_subsys ceph_subsys_rbd
 #undef dout_prefix
@@ -33,27 +33,35 @@ public:
     : m_image_ctx(image_ctx),
       m_lock(ceph::make_shared_mutex(
         librbd::util::unique_lock_name("librbd::io::Dispatcher::lock",
-                                       this))) {
+                                       this))),
+      m_dispatches(std::make_shared<DispatchMap>()) {
   }
 
   virtual ~Dispatcher() {
-    ceph_assert(m_dispatches.empty());
+    ceph_assert(m_dispatches->dispatches.empty());
   }
 
   void shut_down(Context* on_finish) override {
     auto cct = m_image_ctx->cct;
     ldout(cct, 5) << dendl;
 
-    std::map<DispatchLayer, DispatchMeta> dispatches;
-    {
-      std::unique_lock locker{m_lock};
-      std::swap(dispatches, m_dispatches);
-    }
+    std::unique_lock locker{m_lock};
+    auto dispatch_map = m_dispatches;
+    publish_dispatches(std::make_shared<DispatchMap>());
+    locker.unlock();
 
-    for (auto it : dispatches) {
+    // shut down the layers in order, once none of them is referenced by
+    // any snapshot still held by a reader
+    for (auto& it : dispatch_map->dispatches) {
       shut_down_dispatch(it.second, &on_finish);
     }
-    on_finish->complete(0);
+    auto gather_ctx = new C_Gather(m_image_ctx->cct, on_finish);
+    for (auto& it : dispatch_map->dispatches) {
+      retire_dispatch(std::shared_ptr<DispatchRef>{it.second.ref},
+                      gather_ctx->new_sub());
+    }
+    dispatch_map.reset();
+    gather_ctx->activate();
   }
 
   void register_dispatch(Dispatch* dispatch) override {
@@ -63,14 +71,17 @@ public:
 
     std::unique_lock locker{m_lock};
 
-    auto result = m_dispatches.insert(
-      {type, {dispatch, new AsyncOpTracker()}});
+    auto dispatch_map = std::make_shared<DispatchMap>();
+    dispatch_map->dispatches = m_dispatches->dispatches;
+    auto result = dispatch_map->dispatches.insert({type, {dispatch}});
     ceph_assert(result.second);
+    publish_dispatches(std::move(dispatch_map));
   }
 
   bool exists(DispatchLayer dispatch_layer) override {
-    std::unique_lock locker{m_lock};
-    return m_dispatches.find(dispatch_layer) != m_dispatches.end();
+    auto dispatch_map = get_dispatches();
+    return (dispatch_map->dispatches.find(dispatch_layer) !=
+              dispatch_map->dispatches.end());
   }
 
   void shut_down_dispatch(DispatchLayer dispatch_layer,
@@ -78,21 +89,23 @@ public:
     auto cct = m_image_ctx->cct;
     ldout(cct, 5) << "dispatch_layer=" << dispatch_layer << dendl;
 
-    DispatchMeta dispatch_meta;
-    {
-      std::unique_lock locker{m_lock};
-      auto it = m_dispatches.find(dispatch_layer);
-      if (it == m_dispatches.end()) {
-        on_finish->complete(0);
-        return;
-      }
-
-      dispatch_meta = it->second;
-      m_dispatches.erase(it);
+    std::unique_lock locker{m_lock};
+    auto it = m_dispatches->dispatches.find(dispatch_layer);
+    if (it == m_dispatches->dispatches.end()) {
+      locker.unlock();
+      on_finish->complete(0);
+      return;
     }
 
+    auto dispatch_meta = it->second;
+    auto new_dispatch_map = std::make_shared<DispatchMap>();
+    new_dispatch_map->dispatches = m_dispatches->dispatches;
+    new_dispatch_map->dispatches.erase(dispatch_layer);
+    publish_dispatches(std::move(new_dispatch_map));
+    locker.unlock();
+
     shut_down_dispatch(dispatch_meta, &on_finish);
-    on_finish->complete(0);
+    retire_dispatch(std::move(dispatch_meta.ref), on_finish);
   }
 
   void send(DispatchSpec* dispatch_spec) {
@@ -101,33 +114,28 @@ public:
 
     auto dispatch_layer = dispatch_spec->dispatch_layer;
 
+    // a layer removed while this snapshot is held is not shut down before
+    // it is dropped, so the layers can be walked without further locking
+    auto dispatch_map = get_dispatches();
+
     // apply the IO request to all layers -- this method will be re-invoked
     // by the dispatch layer if continuing / restarting the IO
     while (true) {
-      m_lock.lock_shared();
       dispatch_layer = dispatch_spec->dispatch_layer;
-      auto it = m_dispatches.upper_bound(dispatch_layer);
-      if (it == m_dispatches.end()) {
+      auto it = dispatch_map->dispatches.upper_bound(dispatch_layer);
+      if (it == dispatch_map->dispatches.end()) {
         // the request is complete if handled by all layers
         dispatch_spec->dispatch_result = DISPATCH_RESULT_COMPLETE;
-        m_lock.unlock_shared();
         break;
       }
 
-      auto& dispatch_meta = it->second;
-      auto dispatch = dispatch_meta.dispatch;
-      auto async_op_tracker = dispatch_meta.async_op_tracker;
+      auto dispatch = it->second.dispatch;
       dispatch_spec->dispatch_result = DISPATCH_RESULT_INVALID;
 
-      // prevent recursive locking back into the dispatcher while handling IO
-      async_op_tracker->start_op();
-      m_lock.unlock_shared();
-
       // advance to next layer in case we skip or continue
       dispatch_spec->dispatch_layer = dispatch->get_dispatch_layer();
 
       bool handled = send_dispatch(dispatch, dispatch_spec);
-      async_op_tracker->finish_op();
 
       // handled ops will resume when the dispatch ctx is invoked
       if (handled) {
@@ -136,25 +144,57 @@ public:
     }
 
     // skipped through to the last layer
+    dispatch_map.reset();
     dispatch_spec->dispatcher_ctx.complete(0);
   }
 
 protected:
+  /*
+   * Shared by every snapshot that contains the layer. Once the layer is
+   * removed, on_retired completes when the last of those snapshots is
+   * dropped.
+   */
+  struct DispatchRef {
+    Context* on_retired = nullptr;
+
+    ~DispatchRef() {
+      if (on_retired != nullptr) {
+        on_retired->complete(0);
+      }
+    }
+  };
+
   struct DispatchMeta {
     Dispatch* dispatch = nullptr;
-    AsyncOpTracker* async_op_tracker = nullptr;
+    std::shared_ptr<DispatchRef> ref;
 
     DispatchMeta() {
     }
-    DispatchMeta(Dispatch* dispatch, AsyncOpTracker* async_op_tracker)
-      : dispatch(dispatch), async_op_tracker(async_op_tracker) {
+    DispatchMeta(Dispatch* dispatch)
+      : dispatch(dispatch), ref(std::make_shared<DispatchRef>()) {
     }
   };
 
+  /*
+   * Immutable snapshot of the registered layers. The IO path takes m_lock
+   * only long enough to reference the current snapshot, once per request,
+   * while (un)registration copies it, modifies the copy and publishes the
+   * result. Removed layers are only shut down once no snapshot that still
+   * references them is held by a reader.
+   */
+  struct DispatchMap {
+    std::map<DispatchLayer, DispatchMeta> dispatches;
+  };
+  typedef std::shared_ptr<DispatchMap> DispatchMapRef;
+
   ImageCtxT* m_image_ctx;
 
-  ceph::shared_mutex m_lock;
-  std::map<DispatchLayer, DispatchMeta> m_dispatches;
+  mutable ceph::shared_mutex m_lock;
+
+  std::shared_ptr<const DispatchMap> get_dispatches() const {
+    std::shared_lock locker{m_lock};
+    return m_dispatches;
+  }
 
   virtual bool send_dispatch(Dispatch* dispatch,
                              DispatchSpec* dispatch_spec) = 0;
@@ -172,28 +212,21 @@ protected:
     }
 
     void complete(int r) override {
+      auto dispatch_map = dispatcher->get_dispatches();
       while (true) {
-        dispatcher->m_lock.lock_shared();
-        auto it = dispatcher->m_dispatches.upper_bound(dispatch_layer);
-        if (it == dispatcher->m_dispatches.end()) {
-          dispatcher->m_lock.unlock_shared();
+        auto it = dispatch_map->dispatches.upper_bound(dispatch_layer);
+        if (it == dispatch_map->dispatches.end()) {
+          dispatch_map.reset();
           Context::complete(r);
           return;
         }
 
-        auto& dispatch_meta = it->second;
-        auto dispatch = dispatch_meta.dispatch;
-
-        // prevent recursive locking back into the dispatcher while handling IO
-        dispatch_meta.async_op_tracker->start_op();
-        dispatcher->m_lock.unlock_shared();
+        auto dispatch = it->second.dispatch;
 
         // next loop should start after current layer
         dispatch_layer = dispatch->get_dispatch_layer();
 
         auto handled = execute(dispatch, this);
-        dispatch_meta.async_op_tracker->finish_op();
-
         if (handled) {
           break;
         }
@@ -219,25 +252,39 @@ protected:
   };
 
 private:
+  DispatchMapRef m_dispatches;
+
+  void publish_dispatches(DispatchMapRef&& dispatch_map) {
+    ceph_assert(ceph_mutex_is_wlocked(m_lock));
+    m_dispatches = std::move(dispatch_map);
+  }
+
+  void retire_dispatch(std::shared_ptr<DispatchRef>&& ref,
+                       Context* on_finish) {
+    // the layer is no longer published, so only snapshots held by in-flight
+    // readers can still reference it -- complete once the last of them lets
+    // go. that may be an IO thread, so the completion is queued rather than
+    // run inline
+    ref->on_retired =
+      librbd::util::create_async_context_callback(*m_image_ctx, on_finish);
+    ref.reset();
+  }
+
   void shut_down_dispatch(DispatchMeta& dispatch_meta,
                           Context** on_finish) {
     auto dispatch = dispatch_meta.dispatch;
-    auto async_op_tracker = dispatch_meta.async_op_tracker;
 
+    // runs once no reader can still reach the layer
     auto ctx = *on_finish;
     ctx = new LambdaContext(
-      [dispatch, async_op_tracker, ctx](int r) {
+      [dispatch, ctx](int r) {
         delete dispatch;
-        delete async_op_tracker;
 
         ctx->complete(r);
       });
-    ctx = new LambdaContext([dispatch, ctx](int r) {
+    *on_finish = new LambdaContext([dispatch, ctx](int r) {
         dispatch->shut_down(ctx);
       });
-    *on_finish = new LambdaContext([async_op_tracker, ctx](int r) {
-        async_op_tracker->wait_for_ops(ctx);
-      });
   }
 
 };
@@ -84,6 +84,11 @@ struct ImageDispatchInterface {
   virtual void remap_extents(Extents& image_extents,
                              ImageExtentsMapType type) {}
 
+  /// true if IO of this direction might currently be deferred by this layer
+  virtual bool may_block(bool read_op) const {
+    return false;
+  }
+
 };
 
 } // namespace io
@@ -6,9 +6,11 @@
 #include "common/AsyncOpTracker.h"
 #include "common/dout.h"
 #include "librbd/ImageCtx.h"
+#include "librbd/asio/ContextWQ.h"
 #include "librbd/io/ImageDispatch.h"
 #include "librbd/io/ImageDispatchInterface.h"
 #include "librbd/io/ImageDispatchSpec.h"
+#include "librbd/io/ObjectDispatcherInterface.h"
 #include "librbd/io/QueueImageDispatch.h"
 #include "librbd/io/QosImageDispatch.h"
 #include "librbd/io/RefreshImageDispatch.h"
@@ -276,14 +278,32 @@ void ImageDispatcher<I>::remap_extents(Extents& image_extents,
       }
   };
 
-  std::shared_lock locker{this->m_lock};
+  auto dispatch_map = this->get_dispatches();
+  auto& dispatches = dispatch_map->dispatches;
   if (type == IMAGE_EXTENTS_MAP_TYPE_LOGICAL_TO_PHYSICAL) {
-    loop(this->m_dispatches.cbegin(), this->m_dispatches.cend());
+    loop(dispatches.cbegin(), dispatches.cend());
   } else if (type == IMAGE_EXTENTS_MAP_TYPE_PHYSICAL_TO_LOGICAL) {
-    loop(this->m_dispatches.crbegin(), this->m_dispatches.crend());
+    loop(dispatches.crbegin(), dispatches.crend());
   }
 }
 
+template <typename I>
+bool ImageDispatcher<I>::may_block(bool read_op) const {
+  // the object cacher throttles dirty data by waiting on the caller's thread
+  if (this->m_image_ctx->io_object_dispatcher->exists(
+        OBJECT_DISPATCH_LAYER_CACHE)) {
+    return true;
+  }
+
+  auto dispatch_map = this->get_dispatches();
+  for (auto& it : dispatch_map->dispatches) {
+    if (it.second.dispatch->may_block(read_op)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 template <typename I>
 bool ImageDispatcher<I>::send_dispatch(
     ImageDispatchInterface* image_dispatch,
@@ -49,6 +49,8 @@ public:
   void remap_extents(Extents& image_extents,
                      ImageExtentsMapType type) override;
 
+  bool may_block(bool read_op) const override;
+
 protected:
   bool send_dispatch(
     ImageDispatchInterface* image_dispatch,
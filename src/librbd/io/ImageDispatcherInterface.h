@@ -32,6 +32,8 @@ public:
   virtual void invalidate_cache(Context* on_finish) = 0;
   virtual void remap_extents(Extents& image_extents,
                              ImageExtentsMapType type) = 0;
+
+  virtual bool may_block(bool read_op) const = 0;
 };
 
 } // namespace io
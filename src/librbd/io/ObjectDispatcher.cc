@@ -163,8 +163,8 @@ void ObjectDispatcher<I>::extent_overwritten(
   ldout(cct, 20) << object_no << " " << object_off << "~" << object_len
                  << dendl;
 
-  std::shared_lock locker{this->m_lock};
-  for (auto it : this->m_dispatches) {
+  auto dispatch_map = this->get_dispatches();
+  for (auto& it : dispatch_map->dispatches) {
     auto& object_dispatch_meta = it.second;
     auto object_dispatch = object_dispatch_meta.dispatch;
     object_dispatch->extent_overwritten(object_no, object_off, object_len,
@@ -179,8 +179,8 @@ int ObjectDispatcher<I>::prepare_copyup(
   auto cct = this->m_image_ctx->cct;
   ldout(cct, 20) << "object_no=" << object_no << dendl;
 
-  std::shared_lock locker{this->m_lock};
-  for (auto it : this->m_dispatches) {
+  auto dispatch_map = this->get_dispatches();
+  for (auto& it : dispatch_map->dispatches) {
     auto& object_dispatch_meta = it.second;
     auto object_dispatch = object_dispatch_meta.dispatch;
     auto r = object_dispatch->prepare_copyup(
@@ -107,6 +107,10 @@ public:
     return false;
   }
 
+  bool may_block(bool read_op) const override {
+    return (m_qos_enabled_flag != 0);
+  }
+
 private:
   ImageCtxT* m_image_ctx;
 
@@ -10,6 +10,7 @@
 #include "librbd/io/AioCompletion.h"
 #include "librbd/io/FlushTracker.h"
 #include "librbd/io/ImageDispatchSpec.h"
+#include "librbd/io/ImageDispatcherInterface.h"
 
 #define dout_subsys ceph_subsys_rbd
 #undef dout_prefix
@@ -136,6 +137,13 @@ bool QueueImageDispatch<I>::enqueue(
     return false;
   }
 
+  if (m_image_ctx->io_run_to_completion &&
+      !m_image_ctx->io_image_dispatcher->may_block(read_op)) {
+    // nothing below can defer the IO -- avoid the hop through the
+    // dispatch thread and run it down to the OSD op on this thread
+    return false;
+  }
+
   if (!read_op) {
     m_flush_tracker->start_io(tid);
     *on_finish = new LambdaContext([this, tid, on_finish=*on_finish](int r) {
@@ -44,6 +44,10 @@ public:
     return (m_write_blockers > 0);
   }
 
+  bool may_block(bool read_op) const override {
+    return (!read_op && writes_blocked());
+  }
+
   void wait_on_writes_unblocked(Context *on_unblocked);
 
   bool read(
@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include "common/ceph_context.h"
+#include "common/config_obs.h"
+#include "rgw_dmclock_scheduler.h"
+
+namespace rgw {
+
+// admission control for requests whose headers have been read. while
+// rgw_frontend_max_pending_requests is set, a request is rejected before its
+// body is read if the frontend already has that many pending requests or if
+// the scheduler is saturated. the scheduler is only consulted under that
+// limit, since the dmclock scheduler queues requests past its own limit and
+// rejecting them here would bypass its client QoS. independently, a request
+// is rejected if its client address already holds
+// rgw_frontend_max_pending_requests_per_client of the pending requests
+class AdmissionControl : public md_config_obs_t {
+  CephContext* const cct;
+  std::atomic<int64_t> max_pending;
+  std::atomic<int64_t> max_pending_per_client;
+  std::atomic<int64_t> pending = 0;
+
+  std::mutex mutex;
+  std::unordered_map<std::string, int64_t> pending_per_client;
+
+  void release(const std::string& client) {
+    --pending;
+    if (client.empty()) {
+      return;
+    }
+    std::lock_guard lock{mutex};
+    auto i = pending_per_client.find(client);
+    if (i != pending_per_client.end() && --i->second <= 0) {
+      pending_per_client.erase(i);
+    }
+  }
+
+ public:
+  // returns the admission when destroyed
+  class Ticket {
+    AdmissionControl* admission = nullptr;
+    std::string client;
+   public:
+    Ticket() = default;
+    Ticket(AdmissionControl* admission, std::string client)
+      : admission(admission), client(std::move(client)) {}
+    Ticket(Ticket&& o) noexcept
+      : admission(std::exchange(o.admission, nullptr)),
+        client(std::move(o.client)) {}
+    Ticket& operator=(Ticket&& o) noexcept {
+      if (admission) {
+        admission->release(client);
+      }
+      admission = std::exchange(o.admission, nullptr);
+      client = std::move(o.client);
+      return *this;
+    }
+    ~Ticket() {
+      if (admission) {
+        admission->release(client);
+      }
+    }
+  };
+
+  explicit AdmissionControl(CephContext* cct)
+    : cct(cct),
+      max_pending(cct->_conf.get_val<int64_t>("rgw_frontend_max_pending_requests")),
+      max_pending_per_client(cct->_conf.get_val<int64_t>(
+              "rgw_frontend_max_pending_requests_per_client"))
+  {
+    cct->_conf.add_observer(this);
+  }
+  ~AdmissionControl() {
+    cct->_conf.remove_observer(this);
+  }
+
+  const char** get_tracked_conf_keys() const override {
+    static const char* keys[] = {
+      "rgw_frontend_max_pending_requests",
+      "rgw_frontend_max_pending_requests_per_client",
+      nullptr
+    };
+    return keys;
+  }
+
+  void handle_conf_change(const ConfigProxy& conf,
+                          const std::set<std::string>& changed) override {
+    if (changed.count("rgw_frontend_max_pending_requests")) {
+      max_pending = conf.get_val<int64_t>("rgw_frontend_max_pending_requests");
+    }
+    if (changed.count("rgw_frontend_max_pending_requests_per_client")) {
+      max_pending_per_client = conf.get_val<int64_t>(
+          "rgw_frontend_max_pending_requests_per_client");
+    }
+  }
+
+  /// number of requests admitted and not yet released
+  int64_t get_pending() const {
+    return pending;
+  }
+
+  /// try to admit a request from the given client. on success, returns a
+  /// ticket that must be held until the request completes
+  std::optional<Ticket> admit(const boost::asio::ip::tcp::endpoint& remote,
+                              const dmclock::Scheduler* scheduler) {
+    if (const auto limit = max_pending.load(); limit > 0) {
+      if (pending >= limit || (scheduler && scheduler->is_saturated())) {
+        return std::nullopt;
+      }
+    }
+    std::string client;
+    if (const auto client_limit = max_pending_per_client.load();
+        client_limit > 0) {
+      client = remote.address().to_string();
+      std::lock_guard lock{mutex};
+      auto& count = pending_per_client[client];
+      if (count >= client_limit) {
+        if (count == 0) {
+          pending_per_client.erase(client);
+        }
+        return std::nullopt;
+      }
+      ++count;
+    }
+    ++pending;
+    return Ticket{this, std::move(client)};
+  }
+};
+
+} // namespace rgw
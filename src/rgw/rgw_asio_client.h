@@ -51,6 +51,14 @@ class ClientIO : public io::RestfulClient,
     return write_data(buf, len);
   }
 
+  size_t send_body_list(const ceph::bufferlist& bl) override {
+    return write_buffers(bl);
+  }
+
+  /* Send all buffers of @bl with a single gathered write. On success returns
+   * the number of bytes written. On failure throws rgw::io::Exception. */
+  virtual size_t write_buffers(const ceph::bufferlist& bl) = 0;
+
   RGWEnv& get_env() noexcept override {
     return env;
   }
@@ -3,7 +3,9 @@
 
 #include <atomic>
 #include <ctime>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/asio.hpp>
@@ -31,6 +33,7 @@
 
 #include "rgw_zone.h"
 
+#include "rgw_asio_admission.h"
 #include "rgw_asio_frontend_timer.h"
 #include "rgw_dmclock_async_scheduler.h"
 
@@ -83,11 +86,11 @@ class StreamIO : public rgw::asio::ClientIO {
         buffer(buffer)
   {}
 
-  size_t write_data(const char* buf, size_t len) override {
+  template <typename ConstBufferSequence>
+  size_t write(const ConstBufferSequence& buffers) {
     boost::system::error_code ec;
     timeout.start();
-    auto bytes = boost::asio::async_write(stream, boost::asio::buffer(buf, len),
-                                          yield[ec]);
+    auto bytes = boost::asio::async_write(stream, buffers, yield[ec]);
     timeout.cancel();
     if (ec) {
       ldout(cct, 4) << "write_data failed: " << ec.message() << dendl;
@@ -100,6 +103,20 @@ class StreamIO : public rgw::asio::ClientIO {
     return bytes;
   }
 
+  size_t write_data(const char* buf, size_t len) override {
+    return write(boost::asio::buffer(buf, len));
+  }
+
+  size_t write_buffers(const ceph::bufferlist& bl) override {
+    // reference the bufferlist's memory directly rather than flattening it
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(bl.get_num_buffers());
+    for (const auto& ptr : bl.buffers()) {
+      buffers.emplace_back(ptr.c_str(), ptr.length());
+    }
+    return write(buffers);
+  }
+
   size_t recv_body(char* buf, size_t max) override {
     auto& message = parser.get();
     auto& body_remaining = message.body();
@@ -175,6 +192,7 @@ std::ostream& operator<<(std::ostream& out, const log_apache_time& a) {
 };
 
 using SharedMutex = ceph::async::SharedMutex<boost::asio::io_context::executor_type>;
+using rgw::AdmissionControl;
 
 template <typename Stream>
 void handle_connection(boost::asio::io_context& context,
@@ -183,6 +201,7 @@ void handle_connection(boost::asio::io_context& context,
                        parse_buffer& buffer, bool is_ssl,
                        SharedMutex& pause_mutex,
                        rgw::dmclock::Scheduler *scheduler,
+                       AdmissionControl& admission,
                        boost::system::error_code& ec,
                        yield_context yield)
 {
@@ -228,6 +247,36 @@ void handle_connection(boost::asio::io_context& context,
       return;
     }
 
+    // reject the request before reading its body if we're overloaded. the
+    // connection is closed so the unread body doesn't have to be drained
+    const auto& remote = stream.lowest_layer().remote_endpoint(ec);
+    if (ec) {
+      ldout(cct, 1) << "failed to connect client: " << ec.message() << dendl;
+      return;
+    }
+    auto ticket = admission.admit(remote, scheduler);
+    if (!ticket) {
+      static constexpr std::string_view body =
+          "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+          "<Error><Code>SlowDown</Code></Error>";
+      http::response<http::string_body> response;
+      response.result(http::status::service_unavailable);
+      response.version(message.version() == 10 ? 10 : 11);
+      response.set(http::field::content_type, "application/xml");
+      response.keep_alive(false);
+      response.body() = body;
+      response.prepare_payload();
+      timeout.start();
+      http::async_write(stream, response, yield[ec]);
+      timeout.cancel();
+      if (ec) {
+        ldout(cct, 5) << "failed to write response: " << ec.message() << dendl;
+      }
+      ldout(cct, 10) << "====== req rejected by admission control"
+          " http_status=503 ======" << dendl;
+      return;
+    }
+
     {
       auto lock = pause_mutex.async_lock_shared(yield[ec]);
       if (ec == boost::asio::error::operation_aborted) {
@@ -383,6 +432,7 @@ class AsioFrontend {
 #endif
   SharedMutex pause_mutex;
   std::unique_ptr<rgw::dmclock::Scheduler> scheduler;
+  AdmissionControl admission;
 
   struct Listener {
     tcp::endpoint endpoint;
@@ -413,7 +463,8 @@ class AsioFrontend {
  public:
   AsioFrontend(const RGWProcessEnv& env, RGWFrontendConfig* conf,
 	       dmc::SchedulerCtx& sched_ctx)
-    : env(env), conf(conf), pause_mutex(context.get_executor())
+    : env(env), conf(conf), pause_mutex(context.get_executor()),
+      admission(env.store->ctx())
   {
     auto sched_t = dmc::get_scheduler_t(ctx());
     switch(sched_t){
@@ -1004,7 +1055,7 @@ void AsioFrontend::accept(Listener& l, boost::system::error_code ec)
         conn->buffer.consume(bytes);
         handle_connection(context, env, stream, timeout, header_limit,
                           conn->buffer, true, pause_mutex, scheduler.get(),
-                          ec, yield);
+                          admission, ec, yield);
         if (!ec) {
           // ssl shutdown (ignoring errors)
           stream.async_shutdown(yield[ec]);
@@ -1023,7 +1074,7 @@ void AsioFrontend::accept(Listener& l, boost::system::error_code ec)
         boost::system::error_code ec;
         handle_connection(context, env, conn->socket, timeout, header_limit,
                           conn->buffer, false, pause_mutex, scheduler.get(),
-                          ec, yield);
+                          admission, ec, yield);
         conn->socket.shutdown(tcp_socket::shutdown_both, ec);
       }, make_stack_allocator());
   }
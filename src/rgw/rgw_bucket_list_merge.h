@@ -0,0 +1,257 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common/dout.h"
+#include "cls/rgw/cls_rgw_ops.h"
+
+namespace rgw::bucket_list {
+
+/*
+ * Merges the first page of list results from each bucket index shard
+ * into up to num_entries entries in lexical order.
+ *
+ * check_entry(oid, entry) is called on each entry before it is added
+ * to the result; it may update the entry, and returns 0 to keep it,
+ * -ENOENT to skip it, or any other error to abort the merge.
+ *
+ * Once a truncated shard's buffered entries are consumed, one of the
+ * next entries may still come from that shard, so
+ * refill_shard(shard, oid, marker, max_entries, &result) is asked for
+ * the next page of only that shard before another candidate is picked.
+ *
+ * last_visited is set to the key of the last entry that was either
+ * returned or skipped, which is where the next listing should resume.
+ */
+template <typename EntMap, typename CheckFn, typename RefillFn>
+int merge_ordered(const DoutPrefixProvider* dpp,
+		  std::map<int, rgw_cls_list_ret>& shard_results,
+		  const std::map<int, std::string>& shard_oids,
+		  const uint32_t num_entries,
+		  const uint32_t refill_size,
+		  CheckFn&& check_entry,
+		  RefillFn&& refill_shard,
+		  EntMap& m,
+		  bool* is_truncated,
+		  bool* cls_filtered,
+		  std::optional<cls_rgw_obj_key>& last_visited)
+{
+  // to manage the iterators through each shard's list results
+  struct ShardTracker {
+    const size_t shard_idx;
+    rgw_cls_list_ret& result;
+    const std::string& oid_name;
+    decltype(rgw_bucket_dir::m)::iterator cursor;
+    decltype(rgw_bucket_dir::m)::iterator end;
+
+    // key of the last entry handed out from this shard, used as the
+    // start of a refill when the osd did not return a marker
+    cls_rgw_obj_key last_key;
+
+    // number of entries to request the next time this shard is
+    // refilled; grows with each refill of the same shard
+    uint32_t refill_size;
+
+    // manages an iterator through a shard and provides other
+    // accessors
+    ShardTracker(size_t _shard_idx,
+		 rgw_cls_list_ret& _result,
+		 const std::string& _oid_name,
+		 uint32_t _refill_size):
+      shard_idx(_shard_idx),
+      result(_result),
+      oid_name(_oid_name),
+      cursor(_result.dir.m.begin()),
+      end(_result.dir.m.end()),
+      refill_size(_refill_size)
+    {}
+
+    // replaces the exhausted results of this shard with the next page;
+    // this invalidates every iterator and reference into the old page
+    inline void reset(rgw_cls_list_ret&& next) {
+      result = std::move(next);
+      cursor = result.dir.m.begin();
+      end = result.dir.m.end();
+    }
+    inline cls_rgw_obj_key refill_marker() const {
+      return result.marker.empty() ? last_key : result.marker;
+    }
+
+    inline const std::string& entry_name() const {
+      return cursor->first;
+    }
+    rgw_bucket_dir_entry& dir_entry() const {
+      return cursor->second;
+    }
+    inline bool is_truncated() const {
+      return result.is_truncated;
+    }
+    inline ShardTracker& advance() {
+      ++cursor;
+      // return a self-reference to allow for chaining of calls, such
+      // as x.advance().at_end()
+      return *this;
+    }
+    inline bool at_end() const {
+      return cursor == end;
+    }
+  }; // ShardTracker
+
+  // add the next unique candidate, or return false if we reach the end
+  auto next_candidate = [&m] (ShardTracker& t,
+                              std::map<std::string, size_t>& candidates,
+                              size_t tracker_idx) {
+    while (!t.at_end()) {
+      // a refilled shard may hand back a common prefix that another
+      // shard already contributed to the result
+      if (m.find(t.entry_name()) == m.end() &&
+	  candidates.emplace(t.entry_name(), tracker_idx).second) {
+        return;
+      }
+      t.last_key = t.dir_entry().key;
+      t.advance(); // skip duplicate common prefixes
+    }
+  };
+
+  // fetches the next page from a single shard whose buffered entries
+  // have all been consumed, so the merge can continue without asking
+  // every other shard for more entries
+  auto refill = [&] (ShardTracker& t, uint32_t remaining) -> int {
+    const uint32_t refill_entries = std::min(remaining, t.refill_size);
+    t.refill_size = std::min(num_entries, t.refill_size * 2);
+
+    rgw_cls_list_ret next;
+    int ret = refill_shard(int(t.shard_idx), t.oid_name, t.refill_marker(),
+			   refill_entries, &next);
+    if (ret < 0) {
+      return ret;
+    }
+
+    ldpp_dout(dpp, 20) << __func__ << ": refilled shard " << t.shard_idx <<
+      " with " << next.dir.m.size() << " of " << refill_entries <<
+      " requested entries" << dendl;
+
+    t.reset(std::move(next));
+    return 0;
+  };
+
+  // one tracker per shard requested (may not be all shards)
+  std::vector<ShardTracker> results_trackers;
+  results_trackers.reserve(shard_results.size());
+  for (auto& r : shard_results) {
+    results_trackers.emplace_back(r.first, r.second, shard_oids.at(r.first),
+				  refill_size);
+
+    // if any *one* shard's result is trucated, the entire result is
+    // truncated
+    *is_truncated = *is_truncated || r.second.is_truncated;
+
+    // unless *all* are shards are cls_filtered, the entire result is
+    // not filtered
+    *cls_filtered = *cls_filtered && r.second.cls_filtered;
+  }
+
+  // create a map to track the next candidate entry from ShardTracker
+  // (key=candidate, value=index into results_trackers); as we consume
+  // entries from shards, we replace them with the next entries in the
+  // shards until we run out
+  std::map<std::string, size_t> candidates;
+  size_t tracker_idx = 0;
+  for (auto& t : results_trackers) {
+    // it's important that the values in the map refer to the index
+    // into the results_trackers vector, which may not be the same
+    // as the shard number (i.e., when not all shards are requested)
+    next_candidate(t, candidates, tracker_idx);
+    ++tracker_idx;
+  }
+
+  uint32_t count = 0;
+  while (count < num_entries && !candidates.empty()) {
+    // select the next entry in lexical order (first key in map);
+    // again tracker_idx is not necessarily shard number, but is index
+    // into results_trackers vector
+    tracker_idx = candidates.begin()->second;
+    auto& tracker = results_trackers.at(tracker_idx);
+
+    const std::string& name = tracker.entry_name();
+    rgw_bucket_dir_entry& dirent = tracker.dir_entry();
+
+    ldpp_dout(dpp, 20) << __func__ << ": currently processing " <<
+      dirent.key << " from shard " << tracker.shard_idx << dendl;
+
+    int r = check_entry(tracker.oid_name, dirent);
+    if (r < 0 && r != -ENOENT) {
+      return r;
+    }
+
+    // at this point either r >= 0 or r == -ENOENT; the key is kept by
+    // value since a refill below replaces the page that dirent lives in
+    if (r >= 0) { // i.e., if r != -ENOENT
+      ldpp_dout(dpp, 10) << __func__ << ": got " << dirent.key << dendl;
+
+      auto [it, inserted] = m.insert_or_assign(name, std::move(dirent));
+      last_visited = it->second.key;
+      if (inserted) {
+	++count;
+      } else {
+	ldpp_dout(dpp, 0) << "WARNING: " << __func__ <<
+	  " reassigned map value at \"" << it->first <<
+	  "\", which should not happen" << dendl;
+      }
+    } else {
+      ldpp_dout(dpp, 10) << __func__ << ": skipping " <<
+	dirent.key.name << "[" << dirent.key.instance << "]" << dendl;
+      last_visited = dirent.key;
+    }
+
+    // refresh the candidates map
+    candidates.erase(candidates.begin());
+    tracker.last_key = *last_visited;
+    tracker.advance();
+
+    next_candidate(tracker, candidates, tracker_idx);
+
+    // once we exhaust one shard that is truncated, we cannot be
+    // certain that one of the next entries does not need to come from
+    // that shard, so pull its next page before picking another
+    // candidate; only this shard is asked, the others still have
+    // buffered heads
+    while (tracker.at_end() && tracker.is_truncated() &&
+	   count < num_entries) {
+      r = refill(tracker, num_entries - count);
+      if (r < 0) {
+	return r;
+      }
+      next_candidate(tracker, candidates, tracker_idx);
+    }
+  } // while we haven't provided requested # of result entries
+
+  // determine truncation by checking if all the returned entries are
+  // consumed or not
+  *is_truncated = false;
+  for (const auto& t : results_trackers) {
+    if (!t.at_end() || t.is_truncated()) {
+      *is_truncated = true;
+      break;
+    }
+  }
+
+  ldpp_dout(dpp, 20) << __func__ << ": returning, count=" << count <<
+    ", is_truncated=" << *is_truncated << dendl;
+
+  if (*is_truncated && count < num_entries) {
+    ldpp_dout(dpp, 10) << __func__ << ": requested " << num_entries <<
+      " entries but returning " << count << ", which is truncated" << dendl;
+  }
+
+  return 0;
+}
+
+} // namespace rgw::bucket_list
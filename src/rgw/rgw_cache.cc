@@ -4,6 +4,7 @@
 #include "rgw_cache.h"
 #include "rgw_perf_counters.h"
 
+#include <algorithm>
 #include <errno.h>
 
 #define dout_subsys ceph_subsys_rgw
@@ -12,14 +13,14 @@ using namespace std;
 
 int ObjectCache::get(const DoutPrefixProvider *dpp, const string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cache_entry_info *cache_info)
 {
-
-  std::shared_lock rl{lock};
-  std::unique_lock wl{lock, std::defer_lock}; // may be promoted to write lock
   if (!enabled) {
     return -ENOENT;
   }
-  auto iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+
+  Shard& shard = get_shard(name);
+  std::shared_lock rl{shard.lock};
+  auto iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end()) {
     ldpp_dout(dpp, 10) << "cache get: name=" << name << " : miss" << dendl;
     if (perfcounter) {
       perfcounter->inc(l_rgw_cache_miss);
@@ -31,14 +32,12 @@ int ObjectCache::get(const DoutPrefixProvider *dpp, const string& name, ObjectCa
        (ceph::coarse_mono_clock::now() - iter->second.info.time_added) > expiry) {
     ldpp_dout(dpp, 10) << "cache get: name=" << name << " : expiry miss" << dendl;
     rl.unlock();
-    wl.lock(); // write lock for expiration
+    std::unique_lock wl{shard.lock}; // write lock for expiration
     // check that wasn't already removed by other thread
-    iter = cache_map.find(name);
-    if (iter != cache_map.end()) {
-      for (auto &kv : iter->second.chained_entries)
-        kv.first->invalidate(kv.second);
-      remove_lru(name, iter->second.lru_iter);
-      cache_map.erase(iter);
+    iter = shard.cache_map.find(name);
+    if (iter != shard.cache_map.end()) {
+      invalidate_chained(iter->second);
+      remove_entry(shard, iter);
     }
     if (perfcounter) {
       perfcounter->inc(l_rgw_cache_miss);
@@ -48,25 +47,9 @@ int ObjectCache::get(const DoutPrefixProvider *dpp, const string& name, ObjectCa
 
   ObjectCacheEntry *entry = &iter->second;
 
-  if (lru_counter - entry->lru_promotion_ts > lru_window) {
-    ldpp_dout(dpp, 20) << "cache get: touching lru, lru_counter=" << lru_counter
-                   << " promotion_ts=" << entry->lru_promotion_ts << dendl;
-    rl.unlock();
-    wl.lock(); // write lock for touch_lru()
-    /* need to redo this because entry might have dropped off the cache */
-    iter = cache_map.find(name);
-    if (iter == cache_map.end()) {
-      ldpp_dout(dpp, 10) << "lost race! cache get: name=" << name << " : miss" << dendl;
-      if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
-      return -ENOENT;
-    }
-
-    entry = &iter->second;
-    /* check again, we might have lost a race here */
-    if (lru_counter - entry->lru_promotion_ts > lru_window) {
-      touch_lru(dpp, name, *entry, iter->second.lru_iter);
-    }
-  }
+  // a hit only marks the entry for the CLOCK hand, so readers never need
+  // to upgrade to the write lock
+  entry->referenced.store(true, std::memory_order_relaxed);
 
   ObjectCacheInfo& src = iter->second.info;
   if(src.status == -ENOENT) {
@@ -99,8 +82,25 @@ bool ObjectCache::chain_cache_entry(const DoutPrefixProvider *dpp,
                                     std::initializer_list<rgw_cache_entry_info*> cache_info_entries,
 				    RGWChainedCache::Entry *chained_entry)
 {
-  std::unique_lock l{lock};
+  if (!enabled) {
+    return false;
+  }
 
+  // the entries may live in different shards; take their write locks
+  // in shard order so that concurrent callers can't deadlock
+  std::vector<Shard*> locked;
+  locked.reserve(cache_info_entries.size());
+  for (auto cache_info : cache_info_entries) {
+    locked.push_back(&get_shard(cache_info->cache_locator));
+  }
+  std::sort(locked.begin(), locked.end());
+  locked.erase(std::unique(locked.begin(), locked.end()), locked.end());
+
+  std::vector<std::unique_lock<ceph::shared_mutex>> locks;
+  locks.reserve(locked.size());
+  for (auto shard : locked) {
+    locks.emplace_back(shard->lock);
+  }
   if (!enabled) {
     return false;
   }
@@ -111,8 +111,9 @@ bool ObjectCache::chain_cache_entry(const DoutPrefixProvider *dpp,
   for (auto cache_info : cache_info_entries) {
     ldpp_dout(dpp, 10) << "chain_cache_entry: cache_locator="
 		   << cache_info->cache_locator << dendl;
-    auto iter = cache_map.find(cache_info->cache_locator);
-    if (iter == cache_map.end()) {
+    Shard& shard = get_shard(cache_info->cache_locator);
+    auto iter = shard.cache_map.find(cache_info->cache_locator);
+    if (iter == shard.cache_map.end()) {
       ldpp_dout(dpp, 20) << "chain_cache_entry: couldn't find cache locator" << dendl;
       return false;
     }
@@ -141,8 +142,14 @@ bool ObjectCache::chain_cache_entry(const DoutPrefixProvider *dpp,
 
 void ObjectCache::put(const DoutPrefixProvider *dpp, const string& name, ObjectCacheInfo& info, rgw_cache_entry_info *cache_info)
 {
-  std::unique_lock l{lock};
+  if (!enabled) {
+    return;
+  }
 
+  Shard& shard = get_shard(name);
+  std::unique_lock l{shard.lock};
+  // set_enabled() changes the flag under every shard lock, so checking it
+  // again here keeps a put from landing after the disabled cache was cleared
   if (!enabled) {
     return;
   }
@@ -150,21 +157,29 @@ void ObjectCache::put(const DoutPrefixProvider *dpp, const string& name, ObjectC
   ldpp_dout(dpp, 10) << "cache put: name=" << name << " info.flags=0x"
                  << std::hex << info.flags << std::dec << dendl;
 
-  auto [iter, inserted] = cache_map.emplace(name, ObjectCacheEntry{});
+  if (shard.cache_map.find(name) == shard.cache_map.end()) {
+    make_room(dpp, shard);
+  }
+
+  auto [iter, inserted] = shard.cache_map.try_emplace(name);
   ObjectCacheEntry& entry = iter->second;
   entry.info.time_added = ceph::coarse_mono_clock::now();
   if (inserted) {
-    entry.lru_iter = lru.end();
+    // new entries go just behind the hand, so they get a full pass of
+    // the clock before they can be evicted, but only a later hit keeps
+    // them around longer than that
+    entry.clock_iter = shard.clock.insert(shard.hand, name);
+    ldpp_dout(dpp, 10) << "adding " << name << " to cache" << dendl;
+  } else {
+    entry.referenced.store(true, std::memory_order_relaxed);
   }
   ObjectCacheInfo& target = entry.info;
 
-  invalidate_lru(entry);
+  invalidate_chained(entry);
 
   entry.chained_entries.clear();
   entry.gen++;
 
-  touch_lru(dpp, name, entry, entry.lru_iter);
-
   target.status = info.status;
 
   if (info.status < 0) {
@@ -218,80 +233,60 @@ void ObjectCache::put(const DoutPrefixProvider *dpp, const string& name, ObjectC
 // negative lookup. It must only invalidate.
 bool ObjectCache::invalidate_remove(const DoutPrefixProvider *dpp, const string& name)
 {
-  std::unique_lock l{lock};
-
   if (!enabled) {
     return false;
   }
 
-  auto iter = cache_map.find(name);
-  if (iter == cache_map.end())
+  Shard& shard = get_shard(name);
+  std::unique_lock l{shard.lock};
+
+  auto iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end())
     return false;
 
   ldpp_dout(dpp, 10) << "removing " << name << " from cache" << dendl;
-  ObjectCacheEntry& entry = iter->second;
-
-  for (auto& kv : entry.chained_entries) {
-    kv.first->invalidate(kv.second);
-  }
-
-  remove_lru(name, iter->second.lru_iter);
-  cache_map.erase(iter);
+  invalidate_chained(iter->second);
+  remove_entry(shard, iter);
   return true;
 }
 
-void ObjectCache::touch_lru(const DoutPrefixProvider *dpp, const string& name, ObjectCacheEntry& entry,
-			    std::list<string>::iterator& lru_iter)
+void ObjectCache::make_room(const DoutPrefixProvider *dpp, Shard& shard)
 {
-  while (lru_size > (size_t)cct->_conf->rgw_cache_lru_size) {
-    auto iter = lru.begin();
-    if ((*iter).compare(name) == 0) {
-      /*
-       * if the entry we're touching happens to be at the lru end, don't remove it,
-       * lru shrinking can wait for next time
-       */
-      break;
+  // each pass of the hand clears the referenced bit of the entries it
+  // passes, so this loop visits every entry at most twice
+  while (shard.cache_map.size() >= shard_capacity && !shard.clock.empty()) {
+    if (shard.hand == shard.clock.end()) {
+      shard.hand = shard.clock.begin();
     }
-    auto map_iter = cache_map.find(*iter);
-    ldout(cct, 10) << "removing entry: name=" << *iter << " from cache LRU" << dendl;
-    if (map_iter != cache_map.end()) {
-      ObjectCacheEntry& entry = map_iter->second;
-      invalidate_lru(entry);
-      cache_map.erase(map_iter);
+    auto map_iter = shard.cache_map.find(*shard.hand);
+    if (map_iter == shard.cache_map.end()) {
+      // shouldn't happen; drop the stray ring entry
+      shard.hand = shard.clock.erase(shard.hand);
+      continue;
     }
-    lru.pop_front();
-    lru_size--;
-  }
-
-  if (lru_iter == lru.end()) {
-    lru.push_back(name);
-    lru_size++;
-    lru_iter--;
-    ldpp_dout(dpp, 10) << "adding " << name << " to cache LRU end" << dendl;
-  } else {
-    ldpp_dout(dpp, 10) << "moving " << name << " to cache LRU end" << dendl;
-    lru.erase(lru_iter);
-    lru.push_back(name);
-    lru_iter = lru.end();
-    --lru_iter;
+    ObjectCacheEntry& entry = map_iter->second;
+    if (entry.referenced.exchange(false, std::memory_order_relaxed)) {
+      ++shard.hand;
+      continue;
+    }
+    ldpp_dout(dpp, 10) << "removing entry: name=" << map_iter->first
+		       << " from cache" << dendl;
+    invalidate_chained(entry);
+    remove_entry(shard, map_iter);
   }
-
-  lru_counter++;
-  entry.lru_promotion_ts = lru_counter;
 }
 
-void ObjectCache::remove_lru(const string& name,
-			     std::list<string>::iterator& lru_iter)
+void ObjectCache::remove_entry(Shard& shard,
+			       std::unordered_map<std::string, ObjectCacheEntry>::iterator iter)
 {
-  if (lru_iter == lru.end())
-    return;
-
-  lru.erase(lru_iter);
-  lru_size--;
-  lru_iter = lru.end();
+  auto next = shard.clock.erase(iter->second.clock_iter);
+  if (shard.hand == iter->second.clock_iter) {
+    shard.hand = next;
+  }
+  shard.cache_map.erase(iter);
 }
 
-void ObjectCache::invalidate_lru(ObjectCacheEntry& entry)
+void ObjectCache::invalidate_chained(ObjectCacheEntry& entry)
 {
   for (auto iter = entry.chained_entries.begin();
        iter != entry.chained_entries.end(); ++iter) {
@@ -302,7 +297,11 @@ void ObjectCache::invalidate_lru(ObjectCacheEntry& entry)
 
 void ObjectCache::set_enabled(bool status)
 {
-  std::unique_lock l{lock};
+  std::vector<std::unique_lock<ceph::shared_mutex>> locks;
+  locks.reserve(num_shards);
+  for (auto& shard : shards) {
+    locks.emplace_back(shard.lock);
+  }
 
   enabled = status;
 
@@ -313,32 +312,36 @@ void ObjectCache::set_enabled(bool status)
 
 void ObjectCache::invalidate_all()
 {
-  std::unique_lock l{lock};
+  std::vector<std::unique_lock<ceph::shared_mutex>> locks;
+  locks.reserve(num_shards);
+  for (auto& shard : shards) {
+    locks.emplace_back(shard.lock);
+  }
 
   do_invalidate_all();
 }
 
 void ObjectCache::do_invalidate_all()
 {
-  cache_map.clear();
-  lru.clear();
-
-  lru_size = 0;
-  lru_counter = 0;
-  lru_window = 0;
+  for (auto& shard : shards) {
+    shard.cache_map.clear();
+    shard.clock.clear();
+    shard.hand = shard.clock.end();
+  }
 
+  std::shared_lock l{chained_lock};
   for (auto& cache : chained_cache) {
     cache->invalidate_all();
   }
 }
 
 void ObjectCache::chain_cache(RGWChainedCache *cache) {
-  std::unique_lock l{lock};
+  std::unique_lock l{chained_lock};
   chained_cache.push_back(cache);
 }
 
 void ObjectCache::unchain_cache(RGWChainedCache *cache) {
-  std::unique_lock l{lock};
+  std::unique_lock l{chained_lock};
 
   auto iter = chained_cache.begin();
   for (; iter != chained_cache.end(); ++iter) {
@@ -4,6 +4,8 @@
 #ifndef CEPH_RGWCACHE_H
 #define CEPH_RGWCACHE_H
 
+#include <array>
+#include <atomic>
 #include <string>
 #include <map>
 #include <unordered_map>
@@ -151,37 +153,54 @@ public:
 
 struct ObjectCacheEntry {
   ObjectCacheInfo info;
-  std::list<std::string>::iterator lru_iter;
-  uint64_t lru_promotion_ts;
+  // position in the owning shard's CLOCK ring
+  std::list<std::string>::iterator clock_iter;
+  // set on every hit without taking the shard's write lock; cleared by
+  // the CLOCK hand, which evicts entries that were not referenced since
+  // its last pass
+  std::atomic<bool> referenced{false};
   uint64_t gen;
   std::vector<std::pair<RGWChainedCache *, std::string> > chained_entries;
 
-  ObjectCacheEntry() : lru_promotion_ts(0), gen(0) {}
+  ObjectCacheEntry() : gen(0) {}
 };
 
 class ObjectCache {
-  std::unordered_map<std::string, ObjectCacheEntry> cache_map;
-  std::list<std::string> lru;
-  unsigned long lru_size;
-  unsigned long lru_counter;
-  unsigned long lru_window;
-  ceph::shared_mutex lock = ceph::make_shared_mutex("ObjectCache");
-  CephContext *cct;
+  // the cache is split by key hash into independently locked shards
+  // so that lookups of unrelated entries don't contend on one lock
+  static constexpr size_t num_shards = 32;
+
+  struct Shard {
+    ceph::shared_mutex lock = ceph::make_shared_mutex("ObjectCache::Shard");
+    std::unordered_map<std::string, ObjectCacheEntry> cache_map;
+    std::list<std::string> clock;
+    // next eviction candidate in the clock ring
+    std::list<std::string>::iterator hand = clock.end();
+  };
+  std::array<Shard, num_shards> shards;
+  size_t shard_capacity;
 
+  ceph::shared_mutex chained_lock = ceph::make_shared_mutex("ObjectCache::chained");
   std::vector<RGWChainedCache *> chained_cache;
 
-  bool enabled;
+  CephContext *cct;
+  std::atomic<bool> enabled;
   ceph::timespan expiry;
 
-  void touch_lru(const DoutPrefixProvider *dpp, const std::string& name, ObjectCacheEntry& entry,
-		 std::list<std::string>::iterator& lru_iter);
-  void remove_lru(const std::string& name, std::list<std::string>::iterator& lru_iter);
-  void invalidate_lru(ObjectCacheEntry& entry);
+  Shard& get_shard(const std::string& name) {
+    return shards[std::hash<std::string>{}(name) % num_shards];
+  }
+
+  // requires the shard's write lock
+  void make_room(const DoutPrefixProvider *dpp, Shard& shard);
+  void remove_entry(Shard& shard,
+		    std::unordered_map<std::string, ObjectCacheEntry>::iterator iter);
+  void invalidate_chained(ObjectCacheEntry& entry);
 
   void do_invalidate_all();
 
 public:
-  ObjectCache() : lru_size(0), lru_counter(0), lru_window(0), cct(NULL), enabled(false) { }
+  ObjectCache() : shard_capacity(0), cct(NULL), enabled(false) { }
   ~ObjectCache();
   int get(const DoutPrefixProvider *dpp, const std::string& name, ObjectCacheInfo& bl, uint32_t mask, rgw_cache_entry_info *cache_info);
   std::optional<ObjectCacheInfo> get(const DoutPrefixProvider *dpp, const std::string& name) {
@@ -192,10 +211,13 @@ public:
 
   template<typename F>
   void for_each(const F& f) {
-    std::shared_lock l{lock};
-    if (enabled) {
-      auto now  = ceph::coarse_mono_clock::now();
-      for (const auto& [name, entry] : cache_map) {
+    if (!enabled) {
+      return;
+    }
+    auto now  = ceph::coarse_mono_clock::now();
+    for (auto& shard : shards) {
+      std::shared_lock l{shard.lock};
+      for (const auto& [name, entry] : shard.cache_map) {
         if (expiry.count() && (now - entry.info.time_added) < expiry) {
           f(name, entry);
         }
@@ -207,7 +229,8 @@ public:
   bool invalidate_remove(const DoutPrefixProvider *dpp, const std::string& name);
   void set_ctx(CephContext *_cct) {
     cct = _cct;
-    lru_window = cct->_conf->rgw_cache_lru_size / 2;
+    const uint64_t lru_size = std::max<int64_t>(cct->_conf->rgw_cache_lru_size, 1);
+    shard_capacity = (lru_size + num_shards - 1) / num_shards;
     expiry = std::chrono::seconds(cct->_conf.get_val<uint64_t>(
 						"rgw_cache_expiry_interval"));
   }
@@ -657,6 +657,9 @@ public:
       completion_mgr->go_down();
     }
   }
+  bool is_going_down() const {
+    return going_down;
+  }
 
   virtual void report_error(RGWCoroutinesStack *op);
 
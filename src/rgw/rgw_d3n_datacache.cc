@@ -56,6 +56,71 @@ done:
   return r;
 }
 
+void D3nAdmissionFilter::init(uint64_t expected_entries)
+{
+  uint64_t width = 1024;
+  while (width < expected_entries) {
+    width <<= 1;
+  }
+  width_mask = width - 1;
+  sample_size = 10 * width;
+  additions = 0;
+  counters.assign(depth * width, 0);
+}
+
+void D3nAdmissionFilter::age()
+{
+  for (auto& c : counters) {
+    c >>= 1;
+  }
+  additions /= 2;
+}
+
+void D3nAdmissionFilter::record(const std::string& oid)
+{
+  const uint64_t h1 = std::hash<std::string>{}(oid);
+  const uint64_t h2 = (h1 >> 32) | 1;
+  const std::lock_guard l(lock);
+  if (counters.empty()) {
+    return;
+  }
+  bool incremented = false;
+  for (unsigned row = 0; row < depth; row++) {
+    auto& c = counters[slot(h1, h2, row)];
+    if (c < max_count) {
+      ++c;
+      incremented = true;
+    }
+  }
+  if (incremented && ++additions >= sample_size) {
+    age();
+  }
+}
+
+uint8_t D3nAdmissionFilter::estimate(const std::string& oid)
+{
+  const uint64_t h1 = std::hash<std::string>{}(oid);
+  const uint64_t h2 = (h1 >> 32) | 1;
+  const std::lock_guard l(lock);
+  if (counters.empty()) {
+    return 0;
+  }
+  uint8_t freq = max_count;
+  for (unsigned row = 0; row < depth; row++) {
+    freq = std::min(freq, counters[slot(h1, h2, row)]);
+  }
+  return freq;
+}
+
+bool D3nAdmissionFilter::admit(const std::string& oid, const std::string& victim)
+{
+  const uint8_t freq = estimate(oid);
+  if (victim.empty()) {
+    return freq > 1;
+  }
+  return freq > estimate(victim);
+}
+
 D3nDataCache::D3nDataCache()
   : cct(nullptr), io_type(_io_type::ASYNC_IO), free_data_cache_size(0), outstanding_write_size(0)
 {
@@ -97,6 +162,12 @@ void D3nDataCache::init(CephContext *_cct) {
   if (conf_eviction_policy == "random")
     eviction_policy = _eviction_policy::RANDOM;
 
+  admission_enabled = cct->_conf->rgw_d3n_l1_admission_filter;
+  if (admission_enabled) {
+    const uint64_t chunk_size = std::max<uint64_t>(cct->_conf->rgw_get_obj_max_req_size, 1);
+    admission_filter.init(cct->_conf->rgw_d3n_l1_datacache_size / chunk_size);
+  }
+
 #if defined(HAVE_LIBAIO)
   // libaio setup
   struct aioinit ainit{0};
@@ -208,6 +279,21 @@ done:
   return r;
 }
 
+bool D3nDataCache::admit(const std::string& oid, unsigned int len)
+{
+  std::string victim;
+  {
+    const std::lock_guard l(d3n_eviction_lock);
+    if (free_data_cache_size >= outstanding_write_size + len) {
+      return true; // no eviction needed
+    }
+    if (eviction_policy == _eviction_policy::LRU && tail) {
+      victim = tail->oid;
+    }
+  }
+  return admission_filter.admit(oid, victim);
+}
+
 void D3nDataCache::put(bufferlist& bl, unsigned int len, std::string& oid)
 {
   size_t sr = 0;
@@ -226,7 +312,16 @@ void D3nDataCache::put(bufferlist& bl, unsigned int len, std::string& oid)
       ldout(cct, 10) << "D3nDataCache: NOTE: data put in cache already issued, no rewrite" << dendl;
       return;
     }
-    d3n_outstanding_write_list.insert(oid);
+  }
+  if (admission_enabled && !admit(oid, len)) {
+    ldout(cct, 10) << "D3nDataCache: " << __func__ << "(): chunk not admitted, oid=" << oid << dendl;
+    return;
+  }
+  {
+    const std::lock_guard l(d3n_cache_lock);
+    if (!d3n_outstanding_write_list.insert(oid).second) {
+      return;
+    }
   }
   {
     const std::lock_guard l(d3n_eviction_lock);
@@ -268,6 +363,9 @@ void D3nDataCache::put(bufferlist& bl, unsigned int len, std::string& oid)
 
 bool D3nDataCache::get(const string& oid, const off_t len)
 {
+  if (admission_enabled) {
+    admission_filter.record(oid);
+  }
   const std::lock_guard l(d3n_cache_lock);
   bool exist = false;
   string location = cache_location + oid;
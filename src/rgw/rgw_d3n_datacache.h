@@ -60,6 +60,33 @@ struct D3nCacheAioWriteRequest {
   }
 };
 
+/* TinyLFU-style admission filter: a count-min sketch of recent chunk
+ * accesses whose counters are halved every sample period, so the estimate
+ * tracks recent popularity rather than all-time popularity. */
+class D3nAdmissionFilter {
+  static constexpr unsigned depth = 4;
+  static constexpr uint8_t max_count = 15;
+
+  std::mutex lock;
+  std::vector<uint8_t> counters;
+  uint64_t width_mask = 0;
+  uint64_t sample_size = 0;
+  uint64_t additions = 0;
+
+  uint64_t slot(uint64_t h1, uint64_t h2, unsigned row) const {
+    return row * (width_mask + 1) + ((h1 + row * h2) & width_mask);
+  }
+  void age();
+
+public:
+  void init(uint64_t expected_entries);
+  void record(const std::string& oid);
+  uint8_t estimate(const std::string& oid);
+  // admits a chunk if it was seen more often than the chunk it would evict,
+  // or, when that isn't known, if it was seen more than once
+  bool admit(const std::string& oid, const std::string& victim);
+};
+
 struct D3nDataCache {
 
 private:
@@ -84,8 +111,12 @@ private:
   struct D3nChunkDataInfo* head;
   struct D3nChunkDataInfo* tail;
 
+  bool admission_enabled = false;
+  D3nAdmissionFilter admission_filter;
+
 private:
   void add_io();
+  bool admit(const std::string& oid, unsigned int len);
 
 public:
   D3nDataCache();
@@ -208,7 +239,7 @@ int D3nRGWDataCache<T>::get_obj_iterate_cb(const DoutPrefixProvider *dpp, const
     const uint64_t cost = len;
     const uint64_t id = obj_ofs; // use logical object offset for sorting replies
 
-    auto completed = d->aio->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
+    auto completed = d->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
     return d->flush(std::move(completed));
   } else {
     ldpp_dout(dpp, 20) << "D3nDataCache::" << __func__ << "(): oid=" << read_obj.oid << ", is_head_obj=" << is_head_obj << ", obj-ofs=" << obj_ofs << ", read_ofs=" << read_ofs << ", len=" << len << dendl;
@@ -232,7 +263,7 @@ int D3nRGWDataCache<T>::get_obj_iterate_cb(const DoutPrefixProvider *dpp, const
     if (read_ofs != 0 || astate->size != astate->accounted_size || is_compressed || is_encrypted) {
       d->d3n_bypass_cache_write = true;
       lsubdout(g_ceph_context, rgw, 5) << "D3nDataCache: " << __func__ << "(): Note - bypassing datacache: oid=" << read_obj.oid << ", read_ofs!=0 = " << read_ofs << ", size=" << astate->size << " != accounted_size=" << astate->accounted_size << ", is_compressed=" << is_compressed << ", is_encrypted=" << is_encrypted  << dendl;
-      auto completed = d->aio->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
+      auto completed = d->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
       r = d->flush(std::move(completed));
       return r;
     }
@@ -240,7 +271,7 @@ int D3nRGWDataCache<T>::get_obj_iterate_cb(const DoutPrefixProvider *dpp, const
     if (d->rgwrados->d3n_data_cache->get(oid, len)) {
       // Read From Cache
       ldpp_dout(dpp, 20) << "D3nDataCache: " << __func__ << "(): READ FROM CACHE: oid=" << read_obj.oid << ", obj-ofs=" << obj_ofs << ", read_ofs=" << read_ofs << ", len=" << len << dendl;
-      auto completed = d->aio->get(obj, rgw::Aio::d3n_cache_op(dpp, d->yield, read_ofs, len, d->rgwrados->d3n_data_cache->cache_location), cost, id);
+      auto completed = d->get(obj, rgw::Aio::d3n_cache_op(dpp, d->yield, read_ofs, len, d->rgwrados->d3n_data_cache->cache_location), cost, id);
       r = d->flush(std::move(completed));
       if (r < 0) {
         lsubdout(g_ceph_context, rgw, 0) << "D3nDataCache: " << __func__ << "(): Error: failed to drain/flush, r= " << r << dendl;
@@ -249,7 +280,7 @@ int D3nRGWDataCache<T>::get_obj_iterate_cb(const DoutPrefixProvider *dpp, const
     } else {
       // Write To Cache
       ldpp_dout(dpp, 20) << "D3nDataCache: " << __func__ << "(): WRITE TO CACHE: oid=" << read_obj.oid << ", obj-ofs=" << obj_ofs << ", read_ofs=" << read_ofs << " len=" << len << dendl;
-      auto completed = d->aio->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
+      auto completed = d->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
       return d->flush(std::move(completed));
     }
   }
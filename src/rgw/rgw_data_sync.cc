@@ -711,11 +711,6 @@ int RGWRemoteDataLog::init(const rgw_zone_id& _source_zone, RGWRESTConn *_conn,
   return 0;
 }
 
-void RGWRemoteDataLog::finish()
-{
-  stop();
-}
-
 int RGWRemoteDataLog::read_sync_status(const DoutPrefixProvider *dpp, rgw_data_sync_status *sync_status)
 {
   // cannot run concurrently with run_sync(), so run in a separate manager
@@ -1838,6 +1833,8 @@ class RGWDataSyncCR : public RGWCoroutine {
   RGWDataSyncCtx *sc;
   RGWDataSyncEnv *sync_env;
   uint32_t num_shards;
+  uint32_t lane;
+  uint32_t num_lanes;
 
   rgw_data_sync_status sync_status;
 
@@ -1851,9 +1848,11 @@ class RGWDataSyncCR : public RGWCoroutine {
 
   RGWDataSyncModule *data_sync_module{nullptr};
 public:
-  RGWDataSyncCR(RGWDataSyncCtx *_sc, uint32_t _num_shards, RGWSyncTraceNodeRef& _tn, bool *_reset_backoff) : RGWCoroutine(_sc->cct),
+  RGWDataSyncCR(RGWDataSyncCtx *_sc, uint32_t _num_shards, uint32_t _lane, uint32_t _num_lanes,
+                RGWSyncTraceNodeRef& _tn, bool *_reset_backoff) : RGWCoroutine(_sc->cct),
                                                       sc(_sc), sync_env(_sc->env),
                                                       num_shards(_num_shards),
+                                                      lane(_lane), num_lanes(_num_lanes),
                                                       reset_backoff(_reset_backoff), tn(_tn) {
 
   }
@@ -1877,6 +1876,14 @@ public:
         return set_cr_error(retcode);
       }
 
+      /* only lane 0 initializes the status and builds the full sync maps,
+       * the other lanes retry until it is done */
+      if (lane > 0 &&
+          (rgw_data_sync_info::SyncState)sync_status.sync_info.state != rgw_data_sync_info::StateSync) {
+        tn->log(20, SSTR("lane " << lane << " waiting for full sync maps"));
+        return set_cr_error(-EAGAIN);
+      }
+
       /* state: init status */
       if ((rgw_data_sync_info::SyncState)sync_status.sync_info.state == rgw_data_sync_info::StateInit) {
         tn->log(20, SSTR("init"));
@@ -1933,6 +1940,9 @@ public:
           tn->log(10, SSTR("spawning " << num_shards << " shards sync"));
           for (map<uint32_t, rgw_data_sync_marker>::iterator iter = sync_status.sync_markers.begin();
                iter != sync_status.sync_markers.end(); ++iter) {
+            if (iter->first % num_lanes != lane) {
+              continue;
+            }
             RGWDataSyncShardControlCR *cr = new RGWDataSyncShardControlCR(sc, sync_env->svc->zone->get_zone_params().log_pool,
                                                                           iter->first, iter->second, tn);
             cr->get();
@@ -2562,19 +2572,23 @@ class RGWDataSyncControlCR : public RGWBackoffControlCR
   RGWDataSyncCtx *sc;
   RGWDataSyncEnv *sync_env;
   uint32_t num_shards;
+  uint32_t lane;
+  uint32_t num_lanes;
 
   RGWSyncTraceNodeRef tn;
 
   static constexpr bool exit_on_error = false; // retry on all errors
 public:
   RGWDataSyncControlCR(RGWDataSyncCtx *_sc, uint32_t _num_shards,
+                       uint32_t _lane, uint32_t _num_lanes,
                        RGWSyncTraceNodeRef& _tn_parent) : RGWBackoffControlCR(_sc->cct, exit_on_error),
-                                                          sc(_sc), sync_env(_sc->env), num_shards(_num_shards) {
+                                                          sc(_sc), sync_env(_sc->env), num_shards(_num_shards),
+                                                          lane(_lane), num_lanes(_num_lanes) {
     tn = sync_env->sync_tracer->add_node(_tn_parent, "sync");
   }
 
   RGWCoroutine *alloc_cr() override {
-    return new RGWDataSyncCR(sc, num_shards, tn, backoff_ptr());
+    return new RGWDataSyncCR(sc, num_shards, lane, num_lanes, tn, backoff_ptr());
   }
 
   void wakeup(int shard_id, bc::flat_set<rgw_data_notify_entry>& entries) {
@@ -2598,8 +2612,86 @@ public:
   }
 };
 
+/*
+ * An extra data sync lane: a coroutine manager with its own http manager and
+ * thread that runs the datalog shards with shard_id % num_lanes == lane. Lane 0
+ * is the RGWRemoteDataLog itself.
+ */
+class RGWDataSyncLane : public RGWCoroutinesManager {
+  RGWHTTPManager http_manager;
+  RGWDataSyncEnv sync_env;
+  RGWDataSyncCtx sc;
+
+  ceph::shared_mutex lock = ceph::make_shared_mutex("RGWDataSyncLane::lock");
+  RGWDataSyncControlCR *data_sync_cr{nullptr};
+
+  std::thread thread;
+public:
+  RGWDataSyncLane(CephContext *cct, RGWCoroutinesManagerRegistry *cr_registry)
+    : RGWCoroutinesManager(cct, cr_registry),
+      http_manager(cct, completion_mgr) {}
+
+  ~RGWDataSyncLane() override {
+    stop();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  int init(const RGWDataSyncEnv& env, const RGWDataSyncCtx& parent) {
+    sync_env = env;
+    sync_env.http_manager = &http_manager;
+    sc.init(&sync_env, parent.conn, parent.source_zone);
+    return http_manager.start();
+  }
+
+  void start(const DoutPrefixProvider *dpp, uint32_t num_shards,
+             uint32_t lane, uint32_t num_lanes, RGWSyncTraceNodeRef& tn) {
+    lock.lock();
+    data_sync_cr = new RGWDataSyncControlCR(&sc, num_shards, lane, num_lanes, tn);
+    data_sync_cr->get(); // run() will drop a ref, so take another
+    lock.unlock();
+
+    thread = make_named_thread("rgw_data_sync", [this, dpp, lane] {
+      int r = run(dpp, data_sync_cr);
+      if (r < 0) {
+        ldpp_dout(dpp, 0) << "ERROR: data sync lane " << lane
+            << " exited with r=" << r << dendl;
+      }
+      std::unique_lock wl{lock};
+      data_sync_cr->put();
+      data_sync_cr = nullptr;
+    });
+  }
+
+  void wakeup(int shard_id, bc::flat_set<rgw_data_notify_entry>& entries) {
+    std::shared_lock rl{lock};
+    if (!data_sync_cr) {
+      return;
+    }
+    data_sync_cr->wakeup(shard_id, entries);
+  }
+};
+
+RGWRemoteDataLog::~RGWRemoteDataLog() = default;
+
+void RGWRemoteDataLog::finish()
+{
+  stop();
+
+  std::shared_lock rl{lock};
+  for (auto& l : lanes) {
+    l->stop();
+  }
+}
+
 void RGWRemoteDataLog::wakeup(int shard_id, bc::flat_set<rgw_data_notify_entry>& entries) {
   std::shared_lock rl{lock};
+  const uint32_t lane = shard_id % (lanes.size() + 1);
+  if (lane > 0) {
+    lanes[lane - 1]->wakeup(shard_id, entries);
+    return;
+  }
   if (!data_sync_cr) {
     return;
   }
@@ -2608,8 +2700,31 @@ void RGWRemoteDataLog::wakeup(int shard_id, bc::flat_set<rgw_data_notify_entry>&
 
 int RGWRemoteDataLog::run_sync(const DoutPrefixProvider *dpp, int num_shards)
 {
+  const uint32_t num_lanes = std::min<uint32_t>(
+      std::max<uint64_t>(cct->_conf->rgw_data_sync_threads, 1),
+      std::max(num_shards, 1));
+
+  std::vector<std::unique_ptr<RGWDataSyncLane>> new_lanes;
+  for (uint32_t i = 1; i < num_lanes; ++i) {
+    auto l = std::make_unique<RGWDataSyncLane>(cct, cr_registry);
+    int r = l->init(sync_env, sc);
+    if (r < 0) {
+      ldpp_dout(dpp, 0) << "ERROR: failed to start http manager for data sync lane r=" << r << dendl;
+      return r;
+    }
+    new_lanes.push_back(std::move(l));
+  }
+
   lock.lock();
-  data_sync_cr = new RGWDataSyncControlCR(&sc, num_shards, tn);
+  if (is_going_down()) {
+    lock.unlock();
+    return 0;
+  }
+  lanes = std::move(new_lanes);
+  for (uint32_t i = 1; i < num_lanes; ++i) {
+    lanes[i - 1]->start(dpp, num_shards, i, num_lanes, tn);
+  }
+  data_sync_cr = new RGWDataSyncControlCR(&sc, num_shards, 0, num_lanes, tn);
   data_sync_cr->get(); // run() will drop a ref, so take another
   lock.unlock();
 
@@ -2618,8 +2733,12 @@ int RGWRemoteDataLog::run_sync(const DoutPrefixProvider *dpp, int num_shards)
   lock.lock();
   data_sync_cr->put();
   data_sync_cr = NULL;
+  auto old_lanes = std::move(lanes);
+  lanes.clear();
   lock.unlock();
 
+  old_lanes.clear(); // stops and joins the lane threads
+
   if (r < 0) {
     ldpp_dout(dpp, 0) << "ERROR: failed to run sync" << dendl;
     return r;
@@ -3893,10 +4012,30 @@ class RGWBucketFullSyncCR : public RGWCoroutine {
   rgw_obj_key list_marker;
   bucket_list_entry *entry{nullptr};
 
+  // the next page is listed while the objects of the current one are synced
+  boost::intrusive_ptr<RGWCoroutine> next_list_cr;
+  // stacks of listings that haven't been collected yet. a listing may
+  // only be collected after its page was used and next_list_cr was reset
+  // or replaced, so match on every id until its stack is collected
+  std::set<uint64_t> list_stack_ids;
+  rgw_obj_key next_list_marker;
+  bucket_list_result next_list_result;
+
   int total_entries{0};
 
   int sync_result{0};
 
+  int handle_child(uint64_t stack_id, int ret) {
+    if (list_stack_ids.erase(stack_id)) {
+      return 0; // the listing result is checked when the page is used
+    }
+    if (ret < 0) {
+      tn->log(10, "a sync operation returned error");
+      sync_result = ret;
+    }
+    return 0;
+  }
+
   const rgw_raw_obj& status_obj;
   RGWObjVersionTracker& objv;
 
@@ -3992,7 +4131,30 @@ int RGWBucketFullSyncCR::operate(const DoutPrefixProvider *dpp)
         break;
       }
 
-      yield call(new RGWListRemoteBucketCR(sc, bs, list_marker, &list_result));
+      if (next_list_cr) {
+        // wait for the page that was listed ahead, collecting the object
+        // syncs that finish in the meantime
+        while (!next_list_cr->is_done()) {
+          yield wait_for_child();
+          for (bool again = true; again; ) {
+            int ret = 0;
+            uint64_t stack_id = 0;
+            again = collect(&ret, nullptr, &stack_id);
+            handle_child(stack_id, ret);
+          }
+        }
+        retcode = next_list_cr->get_ret_status();
+        next_list_cr.reset();
+        if (next_list_marker == list_marker) {
+          list_result = std::move(next_list_result);
+        } else {
+          // the prefix rules moved the marker past the page we listed
+          retcode = 0;
+          yield call(new RGWListRemoteBucketCR(sc, bs, list_marker, &list_result));
+        }
+      } else {
+        yield call(new RGWListRemoteBucketCR(sc, bs, list_marker, &list_result));
+      }
       if (retcode < 0 && retcode != -ENOENT) {
         set_status("failed bucket listing, going down");
         drain_all();
@@ -4001,6 +4163,13 @@ int RGWBucketFullSyncCR::operate(const DoutPrefixProvider *dpp)
       if (list_result.entries.size() > 0) {
         tn->set_flag(RGW_SNS_FLAG_ACTIVE); /* actually have entries to sync */
       }
+      if (list_result.is_truncated && !list_result.entries.empty()) {
+        next_list_marker = list_result.entries.back().key;
+        next_list_result = bucket_list_result{};
+        next_list_cr = new RGWListRemoteBucketCR(sc, bs, next_list_marker,
+                                                 &next_list_result);
+        list_stack_ids.insert(spawn(next_list_cr.get(), false)->get_id());
+      }
       entries_iter = list_result.entries.begin();
       for (; entries_iter != list_result.entries.end(); ++entries_iter) {
         if (lease_cr && !lease_cr->is_locked()) {
@@ -4030,11 +4199,7 @@ int RGWBucketFullSyncCR::operate(const DoutPrefixProvider *dpp)
         }
         drain_with_cb(cct->_conf->rgw_bucket_sync_spawn_window,
                       [&](uint64_t stack_id, int ret) {
-                if (ret < 0) {
-                  tn->log(10, "a sync operation returned error");
-                  sync_result = ret;
-                }
-                return 0;
+                return handle_child(stack_id, ret);
               });
       }
     } while (list_result.is_truncated && sync_result == 0);
@@ -4042,12 +4207,9 @@ int RGWBucketFullSyncCR::operate(const DoutPrefixProvider *dpp)
 
     /* wait for all operations to complete */
     drain_all_cb([&](uint64_t stack_id, int ret) {
-      if (ret < 0) {
-        tn->log(10, "a sync operation returned error");
-        sync_result = ret;
-      }
-      return 0;
+      return handle_child(stack_id, ret);
     });
+    next_list_cr.reset();
     tn->unset_flag(RGW_SNS_FLAG_ACTIVE);
     if (lease_cr && !lease_cr->is_locked()) {
       return set_cr_error(-ECANCELED);
@@ -355,6 +355,7 @@ struct RGWDataSyncCtx {
 };
 
 class RGWRados;
+class RGWDataSyncLane;
 
 class RGWRemoteDataLog : public RGWCoroutinesManager {
   const DoutPrefixProvider *dpp;
@@ -369,6 +370,8 @@ class RGWRemoteDataLog : public RGWCoroutinesManager {
 
   ceph::shared_mutex lock = ceph::make_shared_mutex("RGWRemoteDataLog::lock");
   RGWDataSyncControlCR *data_sync_cr;
+  // extra lanes for rgw_data_sync_threads > 1, protected by lock
+  std::vector<std::unique_ptr<RGWDataSyncLane>> lanes;
 
   RGWSyncTraceNodeRef tn;
 
@@ -378,6 +381,7 @@ public:
   RGWRemoteDataLog(const DoutPrefixProvider *dpp,
                    rgw::sal::RadosStore* _store,
                    RGWAsyncRadosProcessor *async_rados);
+  ~RGWRemoteDataLog() override;
   int init(const rgw_zone_id& _source_zone, RGWRESTConn *_conn, RGWSyncErrorLogger *_error_logger,
            RGWSyncTraceManager *_sync_tracer, RGWSyncModuleInstanceRef& module,
            PerfCounters* _counters);
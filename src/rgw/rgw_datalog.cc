@@ -496,6 +496,8 @@ int RGWDataChangesLog::start(const DoutPrefixProvider *dpp, const RGWZone* _zone
   bes = std::move(*besr);
   renew_thread = make_named_thread("rgw_dt_lg_renew",
 				   &RGWDataChangesLog::renew_run, this);
+  batch_thread = make_named_thread("rgw_dt_lg_batch",
+				   &RGWDataChangesLog::batch_run, this);
   return 0;
 }
 
@@ -620,6 +622,128 @@ std::string RGWDataChangesLog::get_oid(uint64_t gen_id, int i) const {
 	  fmt::format("{}.{}", prefix, i));
 }
 
+int RGWDataChangesLog::push_change(const DoutPrefixProvider *dpp, int index,
+				   const rgw_bucket_shard& bs, uint64_t gen,
+				   ceph::real_time now)
+{
+  if (cct->_conf->rgw_data_log_batch_interval_msec > 0) {
+    return push_batched(dpp, index, bs, gen);
+  }
+
+  ceph::buffer::list bl;
+  rgw_data_change change;
+  change.entity_type = ENTITY_TYPE_BUCKET;
+  change.key = bs.get_key();
+  change.timestamp = now;
+  change.gen = gen;
+  encode(change, bl);
+
+  auto be = bes->head();
+  ++change_pushes;
+  return be->push(dpp, index, now, change.key, std::move(bl));
+}
+
+/* Changes to the same bucket shard are already collapsed by add_entry(),
+ * which lets a single writer send while the others wait on its
+ * ChangeStatus. This collapses the sends of different bucket shards that
+ * map to the same log shard into one push. Every caller waits until the
+ * push that carries its change has completed, and gets its result, so a
+ * change is still in the log before the operation that made it returns;
+ * a crash loses nothing that was acknowledged. The push itself is sent by
+ * batch_run(), so no request thread sleeps out the interval. */
+int RGWDataChangesLog::push_batched(const DoutPrefixProvider *dpp, int index,
+				    const rgw_bucket_shard& bs, uint64_t gen)
+{
+  std::unique_lock l{batch_lock};
+  if (going_down()) {
+    // batch_run() may already have flushed its last batch
+    l.unlock();
+    return push_batch(dpp, index, {{bs, gen}});
+  }
+  auto& pending = pending_pushes[index];
+  pending.changes.insert({bs, gen});
+  if (!pending.cond) {
+    pending.cond = new RefCountedCond;
+    pending.since = ceph::coarse_mono_clock::now();
+    batch_cond.notify_one();
+  }
+  auto cond = pending.cond;
+  cond->get();
+  l.unlock();
+
+  int ret = cond->wait();
+  cond->put();
+  return ret;
+}
+
+int RGWDataChangesLog::push_batch(const DoutPrefixProvider *dpp, int index,
+				  const bc::flat_set<BucketGen>& batch)
+{
+  auto now = real_clock::now();
+  auto be = bes->head();
+  RGWDataChangesBE::entries entries;
+  for (const auto& [bs, gen] : batch) {
+    rgw_data_change change;
+    bufferlist bl;
+    change.entity_type = ENTITY_TYPE_BUCKET;
+    change.key = bs.get_key();
+    change.timestamp = now;
+    change.gen = gen;
+    encode(change, bl);
+    be->prepare(now, change.key, std::move(bl), entries);
+  }
+
+  ldpp_dout(dpp, 20) << "RGWDataChangesLog::push_batch() pushing "
+		     << batch.size() << " changes to shard " << index << dendl;
+  ++change_pushes;
+  return be->push(dpp, index, std::move(entries));
+}
+
+void RGWDataChangesLog::batch_run() noexcept
+{
+  const DoutPrefix dp(cct, dout_subsys, "rgw data changes log: ");
+  std::unique_lock l{batch_lock};
+  // flush whatever is left on shutdown, so no writer is left waiting
+  while (!going_down() || !pending_pushes.empty()) {
+    if (pending_pushes.empty()) {
+      batch_cond.wait(l);
+      continue;
+    }
+    const auto interval = std::chrono::milliseconds(
+	std::max<int64_t>(cct->_conf->rgw_data_log_batch_interval_msec, 0));
+    const auto now = ceph::coarse_mono_clock::now();
+    std::vector<std::pair<int, PendingPush>> ready;
+    auto next = ceph::coarse_mono_time::max();
+    for (auto i = pending_pushes.begin(); i != pending_pushes.end();) {
+      const auto due = i->second.since + interval;
+      if (due <= now || going_down()) {
+	ready.emplace_back(i->first, std::move(i->second));
+	i = pending_pushes.erase(i);
+      } else {
+	next = std::min(next, due);
+	++i;
+      }
+    }
+    if (ready.empty()) {
+      batch_cond.wait_for(l, next - now);
+      continue;
+    }
+    l.unlock();
+    for (auto& [index, pending] : ready) {
+      int ret = push_batch(&dp, index, pending.changes);
+      pending.cond->done(ret);
+      pending.cond->put();
+    }
+    l.lock();
+  }
+}
+
+void RGWDataChangesLog::batch_stop()
+{
+  std::lock_guard l{batch_lock};
+  batch_cond.notify_all();
+}
+
 int RGWDataChangesLog::add_entry(const DoutPrefixProvider *dpp,
 				 const RGWBucketInfo& bucket_info,
 				 const rgw::bucket_log_layout_generation& gen,
@@ -694,18 +818,9 @@ int RGWDataChangesLog::add_entry(const DoutPrefixProvider *dpp,
 
     sl.unlock();
 
-    ceph::buffer::list bl;
-    rgw_data_change change;
-    change.entity_type = ENTITY_TYPE_BUCKET;
-    change.key = bs.get_key();
-    change.timestamp = now;
-    change.gen = gen.gen;
-    encode(change, bl);
-
     ldpp_dout(dpp, 20) << "RGWDataChangesLog::add_entry() sending update with now=" << now << " cur_expiration=" << expiration << dendl;
 
-    auto be = bes->head();
-    ret = be->push(dpp, index, now, change.key, std::move(bl));
+    ret = push_change(dpp, index, bs, gen.gen, now);
 
     now = real_clock::now();
 
@@ -968,6 +1083,10 @@ RGWDataChangesLog::~RGWDataChangesLog() {
     renew_stop();
     renew_thread.join();
   }
+  if (batch_thread.joinable()) {
+    batch_stop();
+    batch_thread.join();
+  }
 }
 
 void RGWDataChangesLog::renew_run() noexcept {
@@ -270,6 +270,31 @@ class RGWDataChangesLog {
 
   bc::flat_set<BucketGen> cur_cycle;
 
+  // changes gathered for a single push to a log shard. the batch thread
+  // pushes it once rgw_data_log_batch_interval_msec has passed since its
+  // first change, and its writers wait on the result
+  struct PendingPush {
+    bc::flat_set<BucketGen> changes;
+    RefCountedCond* cond = nullptr;
+    ceph::coarse_mono_time since;
+  };
+  ceph::mutex batch_lock = ceph::make_mutex("RGWDataChangesLog::batch_lock");
+  ceph::condition_variable batch_cond;
+  bc::flat_map<int, PendingPush> pending_pushes;
+  std::thread batch_thread;
+  // number of pushes sent for changes from add_entry()
+  std::atomic<uint64_t> change_pushes = 0;
+
+  int push_change(const DoutPrefixProvider *dpp, int index,
+		  const rgw_bucket_shard& bs, uint64_t gen,
+		  ceph::real_time now);
+  int push_batched(const DoutPrefixProvider *dpp, int index,
+		   const rgw_bucket_shard& bs, uint64_t gen);
+  int push_batch(const DoutPrefixProvider *dpp, int index,
+		 const bc::flat_set<BucketGen>& batch);
+  void batch_run() noexcept;
+  void batch_stop();
+
   ChangeStatusPtr _get_change(const rgw_bucket_shard& bs, uint64_t gen);
   void register_renew(const rgw_bucket_shard& bs,
 		      const rgw::bucket_log_layout_generation& gen);
@@ -308,6 +333,9 @@ public:
   int trim_entries(const DoutPrefixProvider *dpp, int shard_id, std::string_view marker,
 		   librados::AioCompletion* c); // :(
   int get_info(const DoutPrefixProvider *dpp, int shard_id, RGWDataChangesLogInfo *info);
+  uint64_t get_change_pushes() const {
+    return change_pushes;
+  }
 
   using LogMarker = RGWDataChangesLogMarker;
 
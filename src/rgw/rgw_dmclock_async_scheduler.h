@@ -56,6 +56,10 @@ class AsyncScheduler : public md_config_obs_t, public Scheduler {
   /// returns a throttle unit granted by async_request()
   void request_complete() override;
 
+  bool is_saturated() const override {
+    return outstanding_requests >= max_requests;
+  }
+
   /// cancel all queued requests, invoking their completion handlers with an
   /// operation_aborted error and default-constructed result
   void cancel();
@@ -162,6 +166,7 @@ auto AsyncScheduler::async_request(const client_id& client,
 class SimpleThrottler : public md_config_obs_t, public dmclock::Scheduler {
 public:
   SimpleThrottler(CephContext *cct) :
+    cct(cct),
     max_requests(cct->_conf.get_val<int64_t>("rgw_max_concurrent_requests")),
     counters(cct, "simple-throttler")
   {
@@ -170,6 +175,9 @@ public:
     }
     cct->_conf.add_observer(this);
   }
+  ~SimpleThrottler() override {
+    cct->_conf.remove_observer(this);
+  }
 
   const char** get_tracked_conf_keys() const override {
     static const char* keys[] = { "rgw_max_concurrent_requests", nullptr };
@@ -194,6 +202,10 @@ public:
 
   }
 
+  bool is_saturated() const override {
+    return outstanding_requests >= max_requests;
+  }
+
 private:
   int schedule_request_impl(const client_id&, const ReqParams&,
                             const Time&, const Cost&,
@@ -210,6 +222,7 @@ private:
     return 0 ;
   }
 
+  CephContext *cct;
   std::atomic<int64_t> max_requests;
   std::atomic<int64_t> outstanding_requests = 0;
   ThrottleCounters counters;
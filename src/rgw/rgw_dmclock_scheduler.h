@@ -76,6 +76,8 @@ public:
     return std::make_pair(r,SchedulerCompleter(std::bind(&Scheduler::request_complete,this)));
   }
   virtual void request_complete() {};
+  /// true if a newly scheduled request would have to wait or be rejected
+  virtual bool is_saturated() const { return false; }
 
   virtual ~Scheduler() {};
 private:
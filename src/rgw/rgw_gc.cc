@@ -15,7 +15,9 @@
 #include "include/random.h"
 #include "rgw_gc_log.h"
 
+#include <algorithm>
 #include <list> // XXX
+#include <thread>
 #include <sstream>
 #include "xxhash.h"
 
@@ -312,11 +314,17 @@ class RGWGCIOManager {
 #define MAX_AIO_DEFAULT 10
   size_t max_aio{MAX_AIO_DEFAULT};
 
+  /* number of gc entries this manager listed for removal. a pass stops
+   * listing at rgw_gc_processor_max_time and skips shards that another
+   * gateway holds, so this is what the pass got to, not the whole backlog */
+  uint64_t listed_entries{0};
+
 public:
-  RGWGCIOManager(const DoutPrefixProvider* _dpp, CephContext *_cct, RGWGC *_gc) : dpp(_dpp),
-                                                                                  cct(_cct),
-                                                                                  gc(_gc) {
-    max_aio = cct->_conf->rgw_gc_max_concurrent_io;
+  RGWGCIOManager(const DoutPrefixProvider* _dpp, CephContext *_cct, RGWGC *_gc,
+                 size_t _max_aio = 0) : dpp(_dpp),
+                                        cct(_cct),
+                                        gc(_gc) {
+    max_aio = _max_aio ? _max_aio : cct->_conf->rgw_gc_max_concurrent_io;
     remove_tags.resize(min(static_cast<int>(cct->_conf->rgw_gc_max_objs), rgw_shards_max()));
     tag_io_size.resize(min(static_cast<int>(cct->_conf->rgw_gc_max_objs), rgw_shards_max()));
   }
@@ -375,6 +383,10 @@ public:
       goto done;
     }
 
+    if (io.type == IO::TailIO && perfcounter) {
+      perfcounter->inc(l_rgw_gc_tail_remove);
+    }
+
     if (! gc->transitioned_objects_cache[io.index]) {
       schedule_tag_removal(io.index, io.tag);
     }
@@ -411,6 +423,14 @@ public:
     }
   }
 
+  void add_listed_entries(size_t n) {
+    listed_entries += n;
+  }
+
+  uint64_t get_listed_entries() const {
+    return listed_entries;
+  }
+
   void add_tag_io_size(int index, string tag, size_t size) {
     auto& ts = tag_io_size[index];
     ts.emplace(tag, size);
@@ -576,6 +596,7 @@ int RGWGC::process(int index, int max_secs, bool expired_only,
       goto done;
 
     marker = next_marker;
+    io_manager.add_listed_entries(entries.size());
 
     string last_pool;
     std::list<cls_rgw_gc_obj_info>::iterator iter;
@@ -678,19 +699,47 @@ int RGWGC::process(bool expired_only)
 
   const int start = ceph::util::generate_random_number(0, max_objs - 1);
 
-  RGWGCIOManager io_manager(this, store->ctx(), this);
+  const int num_threads = std::clamp<int>(cct->_conf->rgw_gc_processor_threads, 1, max_objs);
 
-  for (int i = 0; i < max_objs; i++) {
-    int index = (i + start) % max_objs;
-    int ret = process(index, max_secs, expired_only, io_manager);
-    if (ret < 0)
-      return ret;
+  /* each thread takes the next unprocessed shard. the rgw_gc_max_concurrent_io
+   * budget is split between the threads, so the total stays the same. with a
+   * single thread, the calling thread walks all the shards itself */
+  const size_t max_aio = std::max<size_t>(cct->_conf->rgw_gc_max_concurrent_io / num_threads, 1);
+  std::atomic<int> next{0};
+  std::atomic<int> error{0};
+  std::atomic<uint64_t> listed{0};
+
+  auto process_shards = [&] {
+    RGWGCIOManager io_manager(this, store->ctx(), this, max_aio);
+
+    for (int i = next++; i < max_objs && !error; i = next++) {
+      int index = (i + start) % max_objs;
+      int ret = process(index, max_secs, expired_only, io_manager);
+      if (ret < 0) {
+        error = ret;
+        break;
+      }
+    }
+    if (!going_down()) {
+      io_manager.drain();
+    }
+    listed += io_manager.get_listed_entries();
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int i = 1; i < num_threads; i++) {
+    threads.push_back(make_named_thread("rgw_gc_proc", process_shards));
   }
-  if (!going_down()) {
-    io_manager.drain();
+  process_shards();
+  for (auto& t : threads) {
+    t.join();
+  }
+  if (perfcounter) {
+    perfcounter->set(l_rgw_gc_backlog, listed);
   }
 
-  return 0;
+  return error;
 }
 
 bool RGWGC::going_down()
@@ -50,7 +50,9 @@ public:
     stop_processor();
     finalize();
   }
-  std::vector<bool> transitioned_objects_cache;
+  // one byte per shard rather than vector<bool>, so that processor threads
+  // can update their own shards concurrently
+  std::vector<char> transitioned_objects_cache;
   int send_chain(cls_rgw_obj_chain& chain, const std::string& tag);
 
   // asynchronously defer garbage collection on an object that's still being read
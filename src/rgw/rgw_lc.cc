@@ -372,6 +372,7 @@ class LCObjsLister {
   vector<rgw_bucket_dir_entry>::iterator obj_iter;
   rgw_bucket_dir_entry pre_obj;
   int64_t delay_ms;
+  int error{0};
 
 public:
   LCObjsLister(rgw::sal::Store* _store, rgw::sal::Bucket* _bucket) :
@@ -419,6 +420,7 @@ public:
         if (ret < 0) {
           ldpp_dout(dpp, 0) << "ERROR: list_op returned ret=" << ret
 				 << dendl;
+          error = ret;
           return false;
         }
       }
@@ -433,6 +435,11 @@ public:
     return pre_obj;
   }
 
+  /* nonzero if get_obj() stopped early because a listing failed */
+  int get_error() const {
+    return error;
+  }
+
   void next() {
     pre_obj = *obj_iter;
     ++obj_iter;
@@ -1503,6 +1510,346 @@ int LCOpRule::process(rgw_bucket_dir_entry& o,
 
 }
 
+/*
+ * Expiration index.  For an unversioned bucket whose enabled rules only
+ * expire current objects, every write records the object under the time
+ * its earliest matching rule makes it due.  Once one full listing of the
+ * bucket has populated the index, bucket_lc_process() only visits the
+ * entries that have come due instead of listing the whole bucket.
+ */
+
+static std::string lc_expiration_index_oid(const std::string& bucket_marker)
+{
+  return "lc_exp." + bucket_marker;
+}
+
+/* entries due within this window of now are left for the next run, so that
+ * an entry added while the index is being drained isn't trimmed unseen */
+static constexpr auto lc_expiration_index_lag = std::chrono::minutes(5);
+
+static constexpr uint32_t lc_expiration_index_batch = 1000;
+
+/* the index has to be rebuilt whenever the rules, or the way they are
+ * evaluated, change */
+static std::string expiration_index_fingerprint(CephContext *cct,
+						const bufferlist& lc_bl)
+{
+  return fmt::format("{:08x}.{}", lc_bl.crc32c(0),
+		     cct->_conf->rgw_lc_debug_interval);
+}
+
+namespace rgw::lc {
+
+bool expiration_index_supported(RGWLifecycleConfiguration& config,
+				bool versioned)
+{
+  if (versioned) {
+    return false;
+  }
+
+  bool expires = false;
+  for (auto& [prefix, op] : config.get_prefix_map()) {
+    if (!is_valid_op(op)) {
+      continue;
+    }
+    if (op.dm_expiration ||
+	op.noncur_expiration > 0 ||
+	!op.transitions.empty() ||
+	!op.noncur_transitions.empty()) {
+      return false;
+    }
+    if (op.expiration > 0 || op.expiration_date != boost::none) {
+      expires = true;
+    }
+  }
+  return expires;
+}
+
+/* earliest time at which LCOpAction_CurrentExpiration::check() will accept
+ * an object with the given name and mtime, or real_time::max() if no rule
+ * applies to it.  Tag filters are ignored here; they are checked when the
+ * entry is processed */
+ceph::real_time expiration_due(CephContext *cct,
+			       RGWLifecycleConfiguration& config,
+			       const std::string& name,
+			       ceph::real_time mtime)
+{
+  auto due = ceph::real_time::max();
+
+  for (auto& [prefix, op] : config.get_prefix_map()) {
+    if (!is_valid_op(op) || !boost::starts_with(name, prefix)) {
+      continue;
+    }
+    ceph::real_time t;
+    if (op.expiration > 0) {
+      if (cct->_conf->rgw_lc_debug_interval <= 0) {
+	/* obj_has_expired() measures from the start of the current day */
+	utime_t expire_at(mtime + make_timespan(double(op.expiration)*24*60*60));
+	utime_t day = expire_at.round_to_day();
+	if (day < expire_at) {
+	  day = (expire_at + utime_t(24*60*60, 0)).round_to_day();
+	}
+	t = day.to_real_time();
+      } else {
+	t = mtime + make_timespan(double(op.expiration)*
+				  cct->_conf->rgw_lc_debug_interval);
+      }
+    } else if (op.expiration_date != boost::none) {
+      t = std::max(*op.expiration_date, mtime);
+    } else {
+      continue;
+    }
+    due = std::min(due, t);
+  }
+
+  return due;
+}
+
+int ExpirationIndexBuilder::add(const DoutPrefixProvider *dpp,
+				const std::string& name,
+				ceph::real_time mtime)
+{
+  auto due = expiration_due(cct, config, name, mtime);
+  if (due == ceph::real_time::max()) {
+    return 0;
+  }
+  entries.emplace_back(due, name);
+  if (entries.size() < max_entries) {
+    return 0;
+  }
+  return flush(dpp);
+}
+
+int ExpirationIndexBuilder::flush(const DoutPrefixProvider *dpp)
+{
+  if (entries.empty()) {
+    return 0;
+  }
+  int ret = sal_lc->add_expirations(dpp, oid, entries, null_yield);
+  entries.clear();
+  return ret;
+}
+
+int drain_expiration_index(const DoutPrefixProvider *dpp,
+			   rgw::sal::Lifecycle* sal_lc,
+			   const std::string& oid,
+			   ceph::real_time until,
+			   uint32_t max_entries,
+			   const std::function<bool()>& should_stop,
+			   const std::function<void(const std::vector<rgw::sal::Lifecycle::LCExpiration>&)>& process,
+			   optional_yield y)
+{
+  std::string marker;
+  bool truncated = true;
+  while (truncated) {
+    if (should_stop()) {
+      break;
+    }
+
+    std::vector<rgw::sal::Lifecycle::LCExpiration> entries;
+    std::string next_marker;
+    int ret = sal_lc->list_expirations(dpp, oid, until, marker, max_entries,
+				       entries, &next_marker, &truncated, y);
+    if (ret == -ENOENT) {
+      break;
+    }
+    if (ret < 0) {
+      ldpp_dout(dpp, 0) << "ERROR: failed to list lifecycle expiration index "
+			<< oid << " ret=" << ret << dendl;
+      return ret;
+    }
+    if (entries.empty()) {
+      break;
+    }
+
+    process(entries);
+
+    ret = sal_lc->trim_expirations(dpp, oid, until, next_marker, y);
+    if (ret < 0) {
+      ldpp_dout(dpp, 0) << "ERROR: failed to trim lifecycle expiration index "
+			<< oid << " ret=" << ret << dendl;
+      return ret;
+    }
+    marker = std::move(next_marker);
+  }
+  return 0;
+}
+
+} // namespace rgw::lc
+
+int RGWLC::add_to_expiration_index(const DoutPrefixProvider *dpp,
+				   rgw::sal::Bucket* bucket,
+				   const rgw_obj_key& key,
+				   ceph::real_time mtime,
+				   optional_yield y)
+{
+  if (!cct->_conf->rgw_lc_expiration_index || bucket->versioned()) {
+    return 0;
+  }
+  if (!key.ns.empty()) {
+    /* multipart parts and meta objects aren't listed, and are expired
+     * by the multipart rules instead */
+    return 0;
+  }
+
+  const auto oid = lc_expiration_index_oid(bucket->get_marker());
+  auto& attrs = bucket->get_attrs();
+  auto aiter = attrs.find(RGW_ATTR_LC);
+  if (aiter == attrs.end()) {
+    if (attrs.empty()) {
+      /* the bucket attrs weren't loaded for this write, so we can't tell
+       * whether the object belongs in an index */
+      return sal_lc->invalidate_expirations(dpp, oid, y);
+    }
+    return 0;
+  }
+
+  RGWLifecycleConfiguration config(cct);
+  try {
+    auto iter = aiter->second.cbegin();
+    config.decode(iter);
+  } catch (const buffer::error& e) {
+    return 0;
+  }
+  if (!rgw::lc::expiration_index_supported(config, false)) {
+    return 0;
+  }
+
+  auto due = rgw::lc::expiration_due(cct, config, key.name, mtime);
+  if (due == ceph::real_time::max()) {
+    return 0;
+  }
+
+  int ret = sal_lc->add_expirations(dpp, oid, {{due, key.name}}, y);
+  if (ret == -EOPNOTSUPP) {
+    return 0;
+  }
+  if (ret < 0) {
+    ldpp_dout(dpp, 0) << "ERROR: failed to add " << key
+		      << " to lifecycle expiration index " << oid
+		      << " ret=" << ret << dendl;
+    /* make the next lifecycle run rebuild the index */
+    int r = sal_lc->invalidate_expirations(dpp, oid, y);
+    if (r < 0) {
+      ldpp_dout(dpp, 0) << "ERROR: failed to invalidate lifecycle expiration index "
+			<< oid << " ret=" << r << dendl;
+    }
+  }
+  return ret;
+}
+
+/* fill in the listing fields the current expiration action relies on */
+static int stat_expiration_entry(const DoutPrefixProvider *dpp,
+				 rgw::sal::Bucket* bucket,
+				 rgw_bucket_dir_entry& o)
+{
+  auto obj = bucket->get_object(o.key);
+  RGWObjState *state;
+  int ret = obj->get_obj_state(dpp, &state, null_yield);
+  if (ret < 0) {
+    return ret;
+  }
+  if (!state->exists) {
+    return -ENOENT;
+  }
+
+  o.exists = true;
+  o.meta.mtime = state->mtime;
+  o.meta.size = state->size;
+  o.meta.accounted_size = state->accounted_size;
+
+  auto aiter = state->attrset.find(RGW_ATTR_ACL);
+  if (aiter != state->attrset.end()) {
+    RGWAccessControlPolicy policy;
+    try {
+      auto iter = aiter->second.cbegin();
+      policy.decode(iter);
+    } catch (const buffer::error& e) {
+      return -EIO;
+    }
+    o.meta.owner = policy.get_owner().get_id().to_str();
+    o.meta.owner_display_name = policy.get_owner().get_display_name();
+  }
+  return 0;
+}
+
+int RGWLC::bucket_lc_process_index(rgw::sal::Bucket* bucket,
+				   RGWLifecycleConfiguration& config,
+				   const std::string& oid, LCWorker* worker,
+				   time_t stop_at, bool once)
+{
+  auto pf = [this, bucket, oid](RGWLC::LCWorker* wk, WorkQ* wq, WorkItem& wi) {
+    auto wt =
+      boost::get<std::tuple<LCOpRule, rgw_bucket_dir_entry>>(wi);
+    auto& [op_rule, o] = wt;
+
+    int ret = stat_expiration_entry(wk->dpp, bucket, o);
+    if (ret == -ENOENT) {
+      /* removed since it was indexed */
+      return;
+    }
+    if (ret == 0) {
+      ret = op_rule.process(o, wk->dpp, wq);
+    }
+    if (ret < 0) {
+      ldpp_dout(wk->get_lc(), 0)
+	<< "ERROR: expiration of " << o.key << " returned ret=" << ret
+	<< ", retrying on the next run thread:" << wq->thr_name()
+	<< dendl;
+      /* the listed entries are trimmed once drained, so queue it again */
+      sal_lc->add_expirations(wk->dpp, oid, {{ceph::real_clock::now(), o.key.name}},
+			      null_yield);
+    }
+  };
+  worker->workpool->setf(pf);
+
+  auto& prefix_map = config.get_prefix_map();
+  const auto until = ceph::real_clock::now() - lc_expiration_index_lag;
+
+  /* the lister is only needed to build op_env; nothing is listed */
+  LCObjsLister ol(store, bucket);
+  std::vector<std::pair<std::string, LCOpRule>> rules;
+  for (auto& [prefix, op] : prefix_map) {
+    if (!is_valid_op(op)) {
+      continue;
+    }
+    op_env oenv(op, store, worker, bucket, ol);
+    LCOpRule orule(oenv);
+    orule.build();
+    rules.emplace_back(prefix, std::move(orule));
+  }
+
+  auto should_stop = [&] {
+    if (worker_should_stop(stop_at, once)) {
+      ldpp_dout(this, 5) << __func__ << " interval budget EXPIRED worker "
+			 << worker->ix << dendl;
+      return true;
+    }
+    return false;
+  };
+  auto process = [&](const std::vector<rgw::sal::Lifecycle::LCExpiration>& entries) {
+    for (auto& entry : entries) {
+      rgw_bucket_dir_entry o;
+      o.key = cls_rgw_obj_key(entry.key);
+      for (auto& [prefix, orule] : rules) {
+	if (boost::starts_with(entry.key, prefix)) {
+	  std::tuple<LCOpRule, rgw_bucket_dir_entry> t1 = {orule, o};
+	  worker->workpool->enqueue(WorkItem{t1});
+	}
+      }
+    }
+    worker->workpool->drain();
+  };
+  int ret = rgw::lc::drain_expiration_index(this, sal_lc.get(), oid, until,
+					    lc_expiration_index_batch,
+					    should_stop, process, null_yield);
+  if (ret < 0) {
+    return ret;
+  }
+
+  return handle_multipart_expiration(bucket, prefix_map, worker, stop_at, once);
+}
+
 int RGWLC::bucket_lc_process(string& shard_id, LCWorker* worker,
 			     time_t stop_at, bool once)
 {
@@ -1586,6 +1933,55 @@ int RGWLC::bucket_lc_process(string& shard_id, LCWorker* worker,
   };
   worker->workpool->setf(pf);
 
+  /* use the expiration index if it is complete for the current rules,
+   * otherwise rebuild it while listing */
+  bool build_index = cct->_conf->rgw_lc_expiration_index &&
+    rgw::lc::expiration_index_supported(config, bucket->versioned());
+  std::string index_oid;
+  std::string index_building;
+  std::string index_complete;
+  if (build_index) {
+    index_oid = lc_expiration_index_oid(bucket->get_marker());
+    const auto fp = expiration_index_fingerprint(cct, aiter->second);
+    index_building = fp + ":building";
+    index_complete = fp + ":complete";
+    std::string state;
+    ret = sal_lc->get_expiration_state(this, index_oid, state, null_yield);
+    if (ret == 0 && state == index_complete) {
+      return bucket_lc_process_index(bucket.get(), config, index_oid, worker,
+				     stop_at, once);
+    }
+    if (ret == -EOPNOTSUPP) {
+      build_index = false;
+    } else if (ret < 0 && ret != -ENOENT && ret != -ENODATA) {
+      ldpp_dout(this, 0) << "ERROR: failed to read lifecycle expiration index state "
+			 << index_oid << " ret=" << ret << dendl;
+      build_index = false;
+    } else if (state != index_building) {
+      /* entries written under other rules can't be trusted */
+      ret = sal_lc->rm_expirations(this, index_oid, null_yield);
+      if (ret == 0) {
+	ret = sal_lc->set_expiration_state(this, index_oid, index_building,
+					   null_yield);
+      }
+      if (ret < 0) {
+	ldpp_dout(this, 0) << "ERROR: failed to reset lifecycle expiration index "
+			   << index_oid << " ret=" << ret << dendl;
+	build_index = false;
+      }
+    }
+  }
+  rgw::lc::ExpirationIndexBuilder index_builder(cct, config, sal_lc.get(),
+						index_oid,
+						lc_expiration_index_batch);
+  auto index_error = [&](int r) {
+    if (r < 0) {
+      ldpp_dout(this, 0) << "ERROR: failed to add to lifecycle expiration index "
+			 << index_oid << " ret=" << r << dendl;
+      build_index = false;
+    }
+  };
+
   multimap<string, lc_op>& prefix_map = config.get_prefix_map();
   ldpp_dout(this, 10) << __func__ <<  "() prefix_map size="
 		      << prefix_map.size()
@@ -1634,10 +2030,30 @@ int RGWLC::bucket_lc_process(string& shard_id, LCWorker* worker,
     rgw_bucket_dir_entry* o{nullptr};
     for (; ol.get_obj(this, &o /* , fetch_barrier */); ol.next()) {
       orule.update();
+      if (build_index && o->is_visible()) {
+	index_error(index_builder.add(this, o->key.name, o->meta.mtime));
+      }
       std::tuple<LCOpRule, rgw_bucket_dir_entry> t1 = {orule, *o};
       worker->workpool->enqueue(WorkItem{t1});
     }
     worker->workpool->drain();
+    if (ol.get_error() < 0) {
+      build_index = false;
+    }
+  }
+
+  if (build_index) {
+    index_error(index_builder.flush(this));
+  }
+  if (build_index) {
+    /* a failed write since the reset clears the state, and that
+     * must not be overwritten */
+    ret = sal_lc->set_expiration_state(this, index_oid, index_complete,
+				       null_yield, &index_building);
+    if (ret < 0) {
+      ldpp_dout(this, 5) << "lifecycle expiration index " << index_oid
+			 << " not completed ret=" << ret << dendl;
+    }
   }
 
   ret = handle_multipart_expiration(bucket.get(), prefix_map, worker, stop_at, once);
@@ -2443,6 +2859,14 @@ int RGWLC::set_bucket_config(rgw::sal::Bucket* bucket,
 
   rgw_bucket& b = bucket->get_key();
 
+  /* entries indexed under the old rules may be due at the wrong time */
+  ret = sal_lc->invalidate_expirations(this, lc_expiration_index_oid(bucket->get_marker()),
+				       null_yield);
+  if (ret < 0 && ret != -EOPNOTSUPP) {
+    ldpp_dout(this, 0) << "RGWLC::RGWPutLC() failed to invalidate expiration index of bucket="
+        << b.name << " returned err=" << ret << dendl;
+    return ret;
+  }
 
   ret = guard_lc_modify(this, store, sal_lc.get(), b, cookie,
 			[&](rgw::sal::Lifecycle* sal_lc, const string& oid,
@@ -2474,6 +2898,16 @@ int RGWLC::remove_bucket_config(rgw::sal::Bucket* bucket,
 			    const rgw::sal::Lifecycle::LCEntry& entry) {
     return sal_lc->rm_entry(oid, entry);
   });
+  if (ret < 0) {
+    return ret;
+  }
+
+  int r = sal_lc->rm_expirations(this, lc_expiration_index_oid(bucket->get_marker()),
+				 null_yield);
+  if (r < 0 && r != -EOPNOTSUPP) {
+    ldpp_dout(this, 0) << "RGWLC::RGWDeleteLC() failed to remove expiration index of bucket="
+        << b.name << " returned err=" << r << dendl;
+  }
 
   return ret;
 } /* RGWLC::remove_bucket_config */
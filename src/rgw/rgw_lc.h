@@ -4,9 +4,11 @@
 #ifndef CEPH_RGW_LC_H
 #define CEPH_RGW_LC_H
 
+#include <functional>
 #include <map>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #include "common/debug.h"
 
@@ -541,6 +543,12 @@ public:
                         RGWLifecycleConfiguration *config);
   int remove_bucket_config(rgw::sal::Bucket* bucket,
                            const rgw::sal::Attrs& bucket_attrs);
+  /* record a newly written object in the bucket's expiration index */
+  int add_to_expiration_index(const DoutPrefixProvider *dpp,
+			      rgw::sal::Bucket* bucket,
+			      const rgw_obj_key& key,
+			      ceph::real_time mtime,
+			      optional_yield y);
 
   CephContext *get_cct() const override { return cct; }
   rgw::sal::Lifecycle* get_lc() const { return sal_lc.get(); }
@@ -552,6 +560,10 @@ public:
   int handle_multipart_expiration(rgw::sal::Bucket* target,
 				  const std::multimap<std::string, lc_op>& prefix_map,
 				  LCWorker* worker, time_t stop_at, bool once);
+  int bucket_lc_process_index(rgw::sal::Bucket* bucket,
+			      RGWLifecycleConfiguration& config,
+			      const std::string& oid, LCWorker* worker,
+			      time_t stop_at, bool once);
 };
 
 namespace rgw::lc {
@@ -576,6 +588,56 @@ bool s3_multipart_abort_header(
   ceph::real_time& abort_date,
   std::string& rule_id);
 
+/* whether a bucket's lifecycle rules can be served from an expiration
+ * index, i.e. they only expire current objects */
+bool expiration_index_supported(RGWLifecycleConfiguration& config,
+				bool versioned);
+
+/* earliest time at which the current expiration rules will accept an
+ * object with the given name and mtime, or real_time::max() if no rule
+ * applies to it */
+ceph::real_time expiration_due(CephContext *cct,
+			       RGWLifecycleConfiguration& config,
+			       const std::string& name,
+			       ceph::real_time mtime);
+
+/* batches the objects of a full bucket listing into its expiration index */
+class ExpirationIndexBuilder {
+  CephContext *cct;
+  RGWLifecycleConfiguration& config;
+  rgw::sal::Lifecycle* sal_lc;
+  std::string oid;
+  uint32_t max_entries;
+  std::vector<rgw::sal::Lifecycle::LCExpiration> entries;
+
+public:
+  ExpirationIndexBuilder(CephContext *_cct,
+			 RGWLifecycleConfiguration& _config,
+			 rgw::sal::Lifecycle* _sal_lc,
+			 const std::string& _oid,
+			 uint32_t _max_entries)
+    : cct(_cct), config(_config), sal_lc(_sal_lc), oid(_oid),
+      max_entries(_max_entries) {}
+
+  /* queue an object if a rule applies to it, writing out a full batch */
+  int add(const DoutPrefixProvider *dpp, const std::string& name,
+	  ceph::real_time mtime);
+  /* write out any queued objects */
+  int flush(const DoutPrefixProvider *dpp);
+};
+
+/* hand each batch of index entries due before @a until to @a process, and
+ * trim the batch once it returns; entries added meanwhile with a later due
+ * time are kept */
+int drain_expiration_index(const DoutPrefixProvider *dpp,
+			   rgw::sal::Lifecycle* sal_lc,
+			   const std::string& oid,
+			   ceph::real_time until,
+			   uint32_t max_entries,
+			   const std::function<bool()>& should_stop,
+			   const std::function<void(const std::vector<rgw::sal::Lifecycle::LCExpiration>&)>& process,
+			   optional_yield y);
+
 } // namespace rgw::lc
 
 #endif
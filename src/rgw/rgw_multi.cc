@@ -6,6 +6,8 @@
 #include <iostream>
 #include <map>
 
+#include <boost/algorithm/string/predicate.hpp>
+
 #include "include/types.h"
 
 #include "rgw_xml.h"
@@ -81,6 +83,113 @@ bool is_v2_upload_id(const string& upload_id)
          (strncmp(uid, MULTIPART_UPLOAD_ID_PREFIX_LEGACY, sizeof(MULTIPART_UPLOAD_ID_PREFIX_LEGACY) - 1) == 0);
 }
 
+int list_multipart_parts(const DoutPrefixProvider *dpp,
+                         RGWMultipartPartsOmap& omap, bool sorted_omap,
+                         int num_parts, int marker,
+                         map<uint32_t, RGWUploadPartInfo>* parts,
+                         int *next_marker, bool *truncated)
+{
+  map<string, bufferlist> parts_map;
+  map<string, bufferlist>::iterator iter;
+
+  parts->clear();
+
+  int ret;
+  if (sorted_omap) {
+    string p;
+    p = "part.";
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%08d", marker);
+    p.append(buf);
+
+    ret = omap.get_vals(dpp, p, num_parts + 1, &parts_map);
+    if (ret >= 0 && (int)parts_map.size() > num_parts) {
+      /* unpadded part keys start with a nonzero digit, so they sort after
+       * every padded one and may be past this page, where the check below
+       * doesn't see them. look them up directly, or later pages would
+       * start after the marker and never return the parts they hold */
+      map<string, bufferlist> unpadded;
+      ret = omap.get_vals(dpp, "part.0~", 1, &unpadded); // past "part.0*"
+      if (ret >= 0 && !unpadded.empty() &&
+          boost::algorithm::starts_with(unpadded.begin()->first, "part.")) {
+        return list_multipart_parts(dpp, omap, false, num_parts, marker,
+                                    parts, next_marker, truncated);
+      }
+    }
+  } else {
+    ret = omap.get_all(dpp, &parts_map);
+  }
+  if (ret < 0) {
+    return ret;
+  }
+
+  int i;
+  int last_num = 0;
+
+  for (i = 0, iter = parts_map.begin();
+       (i < num_parts || !sorted_omap) && iter != parts_map.end();
+       ++iter, ++i) {
+    bufferlist& bl = iter->second;
+    auto bli = bl.cbegin();
+    RGWUploadPartInfo info;
+    try {
+      decode(info, bli);
+    } catch (buffer::error& err) {
+      ldpp_dout(dpp, 0) << "ERROR: could not part info, caught buffer::error" <<
+	dendl;
+      return -EIO;
+    }
+    if (sorted_omap) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "part.%08d", (int)info.num);
+      if (iter->first != buf) {
+        /* ouch, the part's key isn't the zero padded one we sort by. this
+         * could be a case of mixed rgw versions working on the same upload,
+         * where one gateway doesn't support correctly sorted omap keys for
+         * multipart upload, just assume data is unsorted. gaps in the part
+         * numbers are fine, the keys still sort by part number.
+         */
+        return list_multipart_parts(dpp, omap, false, num_parts, marker,
+                                    parts, next_marker, truncated);
+      }
+    }
+    if (sorted_omap ||
+      (int)info.num > marker) {
+      last_num = info.num;
+      (*parts)[info.num] = std::move(info);
+    }
+  }
+
+  if (sorted_omap) {
+    if (truncated) {
+      *truncated = (iter != parts_map.end());
+    }
+  } else {
+    /* rebuild a map with only num_parts entries */
+    map<uint32_t, RGWUploadPartInfo> new_parts;
+    map<uint32_t, RGWUploadPartInfo>::iterator piter;
+    for (i = 0, piter = parts->begin();
+	 i < num_parts && piter != parts->end();
+	 ++i, ++piter) {
+      last_num = piter->first;
+      new_parts[piter->first] = std::move(piter->second);
+    }
+
+    if (truncated) {
+      *truncated = (piter != parts->end());
+    }
+
+    parts->swap(new_parts);
+  }
+
+  if (next_marker) {
+    *next_marker = last_num;
+  }
+
+  return 0;
+}
+
 void RGWUploadPartInfo::generate_test_instances(list<RGWUploadPartInfo*>& o)
 {
   RGWUploadPartInfo *i = new RGWUploadPartInfo;
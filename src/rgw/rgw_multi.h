@@ -109,4 +109,26 @@ public:
 
 extern bool is_v2_upload_id(const std::string& upload_id);
 
+/* the omap of a multipart upload's meta object, which maps a key for
+ * each part to its encoded RGWUploadPartInfo */
+class RGWMultipartPartsOmap {
+public:
+  virtual ~RGWMultipartPartsOmap() = default;
+
+  virtual int get_vals(const DoutPrefixProvider *dpp, const std::string& marker,
+                       uint64_t count, std::map<std::string, bufferlist>* m) = 0;
+  virtual int get_all(const DoutPrefixProvider *dpp,
+                      std::map<std::string, bufferlist>* m) = 0;
+};
+
+/* lists up to num_parts parts numbered above marker. v2 uploads key
+ * their parts by the zero padded part number and are listed a page at a
+ * time, unless an older gateway added parts under unpadded keys; those,
+ * like the parts of pre-v2 uploads, are read in full and sorted here */
+extern int list_multipart_parts(const DoutPrefixProvider *dpp,
+                                RGWMultipartPartsOmap& omap, bool sorted_omap,
+                                int num_parts, int marker,
+                                std::map<uint32_t, RGWUploadPartInfo>* parts,
+                                int *next_marker, bool *truncated);
+
 #endif
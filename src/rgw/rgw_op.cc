@@ -4042,8 +4042,14 @@ void RGWPutObj::execute(optional_yield y)
   boost::optional<RGWPutObj_Compress> compressor;
 
   std::unique_ptr<rgw::sal::DataProcessor> encrypt;
+  // must be destroyed before the compressor or encrypt filter it runs
+  std::optional<rgw::putobj::OffloadProcessor> offload;
 
   if (!append) { // compression and encryption only apply to full object uploads
+    if (rgw::putobj::OffloadProcessor::enabled(s->cct)) {
+      offload.emplace(s->cct, y, filter);
+      filter = offload->get_output();
+    }
     op_ret = get_encrypt_filter(&encrypt, filter);
     if (op_ret < 0) {
       return;
@@ -4062,6 +4068,15 @@ void RGWPutObj::execute(optional_yield y)
         s->object->set_compressed();
       }
     }
+    if (offload) {
+      if (filter == offload->get_output()) { // nothing to offload
+        offload.reset();
+        filter = processor.get();
+      } else {
+        offload->set_stage(filter);
+        filter = &*offload;
+      }
+    }
   }
   tracepoint(rgw_op, before_data_transfer, s->req_id.c_str());
   do {
@@ -35,6 +35,8 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_keystone_token_cache_miss, "keystone_token_cache_miss", "Keystone token cache miss");
 
   plb.add_u64_counter(l_rgw_gc_retire, "gc_retire_object", "GC object retires");
+  plb.add_u64_counter(l_rgw_gc_tail_remove, "gc_tail_remove", "GC tail objects removed");
+  plb.add_u64(l_rgw_gc_backlog, "gc_backlog", "GC entries listed for removal by the last GC pass");
 
   plb.add_u64_counter(l_rgw_lc_expire_current, "lc_expire_current",
 		      "Lifecycle current expiration");
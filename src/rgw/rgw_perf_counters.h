@@ -32,6 +32,8 @@ enum {
   l_rgw_keystone_token_cache_miss,
 
   l_rgw_gc_retire,
+  l_rgw_gc_tail_remove,
+  l_rgw_gc_backlog,
 
   l_rgw_lc_expire_current,
   l_rgw_lc_expire_noncurrent,
@@ -13,6 +13,8 @@
  *
  */
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include "rgw_putobj.h"
 
 namespace rgw::putobj {
@@ -96,4 +98,157 @@ int StripeProcessor::process(bufferlist&& data, uint64_t offset)
   return Pipe::process(std::move(data), offset - bounds.first);
 }
 
+
+// worker threads shared by all OffloadProcessors of a CephContext
+struct OffloadPool {
+  std::unique_ptr<boost::asio::thread_pool> pool;
+  explicit OffloadPool(CephContext *cct)
+    : pool(std::make_unique<boost::asio::thread_pool>(
+            std::max<int64_t>(cct->_conf->rgw_put_obj_offload_threads, 1)))
+  {}
+};
+
+static boost::asio::thread_pool& get_offload_pool(CephContext *cct)
+{
+  auto& p = cct->lookup_or_create_singleton_object<OffloadPool>(
+      "rgw::putobj::OffloadPool", false, cct);
+  return *p.pool;
+}
+
+bool OffloadProcessor::enabled(CephContext *cct)
+{
+  return cct->_conf->rgw_put_obj_offload_threads > 0;
+}
+
+int OffloadProcessor::Output::process(bufferlist&& data, uint64_t offset)
+{
+  std::lock_guard lock{parent->mutex};
+  parent->pending_size += data.length();
+  parent->output.emplace_back(std::move(data), offset);
+  return 0;
+}
+
+OffloadProcessor::OffloadProcessor(CephContext *cct, optional_yield y,
+                                   rgw::sal::DataProcessor *next)
+  : Pipe(next), cct(cct), y(y),
+    max_pending(std::max<uint64_t>(cct->_conf->rgw_put_obj_offload_max_pending, 1))
+{}
+
+OffloadProcessor::~OffloadProcessor()
+{
+  // the worker may still be inside the stage, which is owned by the caller
+  std::unique_lock lock{mutex};
+  canceled = true;
+  cond.wait(lock, [this] { return !running; });
+}
+
+template <typename CompletionToken>
+auto OffloadProcessor::async_wait(CompletionToken&& token,
+                                  std::unique_lock<ceph::mutex>& lock)
+{
+  using boost::asio::async_completion;
+  async_completion<CompletionToken, Signature> init(token);
+  completion = Completion::create(y.get_io_context().get_executor(),
+                                  std::move(init.completion_handler));
+  // the worker posts the completion to our strand, so it can't resume us
+  // before we suspend
+  lock.unlock();
+  return init.result.get();
+}
+
+void OffloadProcessor::wait(std::unique_lock<ceph::mutex>& lock)
+{
+  if (y) {
+    boost::system::error_code ec;
+    async_wait(y.get_yield_context()[ec], lock);
+    lock.lock();
+  } else {
+    cond.wait(lock);
+  }
+}
+
+void OffloadProcessor::notify()
+{
+  // called with the mutex held
+  cond.notify_all();
+  if (completion) {
+    ceph::async::post(std::move(completion), boost::system::error_code{});
+  }
+}
+
+void OffloadProcessor::run()
+{
+  std::unique_lock lock{mutex};
+  while (!input.empty() && !canceled && error == 0) {
+    auto [data, offset] = std::move(input.front());
+    input.pop_front();
+    pending_size -= data.length();
+    lock.unlock();
+
+    int r = stage->process(std::move(data), offset);
+
+    lock.lock();
+    if (r < 0) {
+      error = r;
+    }
+    notify();
+  }
+  running = false;
+  notify();
+}
+
+int OffloadProcessor::forward_output()
+{
+  std::unique_lock lock{mutex};
+  while (!output.empty()) {
+    auto [data, offset] = std::move(output.front());
+    output.pop_front();
+    pending_size -= data.length();
+    lock.unlock();
+
+    int r = Pipe::process(std::move(data), offset);
+    if (r < 0) {
+      return r;
+    }
+    lock.lock();
+  }
+  return error;
+}
+
+int OffloadProcessor::process(bufferlist&& data, uint64_t offset)
+{
+  ceph_assert(stage);
+  const bool flush = (data.length() == 0);
+  {
+    std::lock_guard lock{mutex};
+    if (error < 0) {
+      return error;
+    }
+    pending_size += data.length();
+    input.emplace_back(std::move(data), offset);
+    if (!running) {
+      running = true;
+      boost::asio::post(get_offload_pool(cct), [this] { run(); });
+    }
+  }
+
+  // forward whatever the stage has produced so far. wait for more while
+  // over the memory limit, or until everything is written on flush
+  for (;;) {
+    int r = forward_output();
+    if (r < 0) {
+      return r;
+    }
+    std::unique_lock lock{mutex};
+    if (!output.empty()) {
+      continue;
+    }
+    const bool done = flush ? !running : pending_size <= max_pending;
+    if (done || (!running && input.empty())) {
+      return error;
+    }
+    wait(lock);
+  }
+}
+
 } // namespace rgw::putobj
@@ -15,7 +15,12 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
 #include "include/buffer.h"
+#include "common/async/completion.h"
+#include "common/async/yield_context.h"
+#include "common/ceph_mutex.h"
 #include "rgw_sal.h"
 
 namespace rgw::putobj {
@@ -70,4 +75,67 @@ class StripeProcessor : public Pipe {
   int process(bufferlist&& data, uint64_t data_offset) override;
 };
 
+
+// pipe that runs a cpu-intensive stage such as compression or encryption on
+// a shared worker pool. while the stage works on one buffer, the request can
+// read the next buffer from the client and write earlier output to rados.
+// buffers pass through the stage one at a time and in order, so the stage
+// needs no locking of its own. its output must go to get_output() rather
+// than to the next processor:
+//
+//   OffloadProcessor offload(cct, y, next);
+//   RGWPutObj_Compress compress(cct, plugin, offload.get_output());
+//   offload.set_stage(&compress);
+class OffloadProcessor : public Pipe {
+  // collects the stage's output for the request to forward in order
+  class Output : public rgw::sal::DataProcessor {
+    OffloadProcessor *parent;
+   public:
+    explicit Output(OffloadProcessor *parent) : parent(parent) {}
+    int process(bufferlist&& data, uint64_t offset) override;
+  };
+
+  using Buffer = std::pair<bufferlist, uint64_t>; // data, offset
+  using Signature = void(boost::system::error_code);
+  using Completion = ceph::async::Completion<Signature>;
+
+  CephContext *cct;
+  optional_yield y;
+  const uint64_t max_pending;
+  Output out{this};
+  rgw::sal::DataProcessor *stage = nullptr;
+
+  ceph::mutex mutex = ceph::make_mutex("OffloadProcessor");
+  ceph::condition_variable cond;
+  std::unique_ptr<Completion> completion; // waiting coroutine
+  std::deque<Buffer> input; // waiting for the stage
+  std::deque<Buffer> output; // produced by the stage
+  uint64_t pending_size = 0; // bytes in input and output
+  bool running = false; // a worker is draining the input
+  bool canceled = false;
+  int error = 0; // first error returned by the stage
+
+  template <typename CompletionToken>
+  auto async_wait(CompletionToken&& token, std::unique_lock<ceph::mutex>& lock);
+
+  void run();
+  void notify();
+  void wait(std::unique_lock<ceph::mutex>& lock);
+  int forward_output();
+
+ public:
+  OffloadProcessor(CephContext *cct, optional_yield y,
+                   rgw::sal::DataProcessor *next);
+  virtual ~OffloadProcessor() override;
+
+  // the processor the stage should pass its output to
+  rgw::sal::DataProcessor *get_output() { return &out; }
+  void set_stage(rgw::sal::DataProcessor *s) { stage = s; }
+
+  int process(bufferlist&& data, uint64_t offset) override;
+
+  // true if rgw_put_obj_offload_threads enables offloading
+  static bool enabled(CephContext *cct);
+};
+
 } // namespace rgw::putobj
@@ -24,6 +24,7 @@
 #include "rgw_sal.h"
 #include "rgw_sal_rados.h"
 #include "rgw_quota.h"
+#include "rgw_quota_cache.h"
 #include "rgw_bucket.h"
 #include "rgw_user.h"
 
@@ -37,35 +38,107 @@
 
 using namespace std;
 
-struct RGWQuotaCacheStats {
-  RGWStorageStats stats;
-  utime_t expiration;
-  utime_t async_refresh_time;
+static size_t quota_shard_hash(const rgw_bucket& bucket)
+{
+  return std::hash<std::string>{}(bucket.bucket_id) ^
+      std::hash<std::string>{}(bucket.name);
+}
+
+static size_t quota_shard_hash(const rgw_user& user)
+{
+  return std::hash<std::string>{}(user.id) ^
+      std::hash<std::string>{}(user.tenant);
+}
+
+/* lru_map split into independently locked shards, so that requests for
+ * different buckets or users don't all serialize on a single mutex */
+template<class T>
+class RGWQuotaStatsMap {
+  static constexpr size_t num_shards = 16;
+  using map_type = lru_map<T, RGWQuotaCacheStats>;
+  std::vector<std::unique_ptr<map_type>> shards;
+
+  map_type& shard(const T& key) {
+    return *shards[quota_shard_hash(key) % shards.size()];
+  }
+public:
+  explicit RGWQuotaStatsMap(int size) {
+    const int shard_size = std::max<int>(1, (size + num_shards - 1) / num_shards);
+    shards.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards.push_back(std::make_unique<map_type>(shard_size));
+    }
+  }
+
+  bool find(const T& key, RGWQuotaCacheStats& value) {
+    return shard(key).find(key, value);
+  }
+  bool find_and_update(const T& key, RGWQuotaCacheStats *value,
+                       typename map_type::UpdateContext *ctx) {
+    return shard(key).find_and_update(key, value, ctx);
+  }
+  void add(const T& key, RGWQuotaCacheStats& value) {
+    shard(key).add(key, value);
+  }
 };
 
 template<class T>
 class RGWQuotaCache {
 protected:
   rgw::sal::Store* store;
-  lru_map<T, RGWQuotaCacheStats> stats_map;
+  RGWQuotaStatsMap<T> stats_map;
   RefCountedWaitObject *async_refcount;
 
+  /* claims the refresh of an entry and marks its fetch as issued */
   class StatsAsyncTestSet : public lru_map<T, RGWQuotaCacheStats>::UpdateContext {
-    int objs_delta;
-    uint64_t added_bytes;
-    uint64_t removed_bytes;
   public:
-    StatsAsyncTestSet() : objs_delta(0), added_bytes(0), removed_bytes(0) {}
+    uint64_t gen = 0;
     bool update(RGWQuotaCacheStats *entry) override {
-      if (entry->async_refresh_time.sec() == 0)
+      if (!entry->claim_refresh())
         return false;
 
-      entry->async_refresh_time = utime_t(0, 0);
+      gen = entry->fetch_issued();
+      return true;
+    }
+  };
+
+  /* marks a fetch that didn't claim the refresh as issued */
+  class StatsFetchIssued : public lru_map<T, RGWQuotaCacheStats>::UpdateContext {
+  public:
+    uint64_t gen = 0;
+    bool update(RGWQuotaCacheStats *entry) override {
+      gen = entry->fetch_issued();
+      return true;
+    }
+  };
 
+  /* installs freshly fetched stats, keeping the local changes made while
+   * they were being fetched */
+  class StatsReconcile : public lru_map<T, RGWQuotaCacheStats>::UpdateContext {
+    const uint64_t gen;
+    const RGWStorageStats& fetched;
+    const utime_t expiration;
+    const utime_t async_refresh_time;
+  public:
+    StatsReconcile(uint64_t gen, const RGWStorageStats& fetched,
+                   utime_t expiration, utime_t async_refresh_time)
+      : gen(gen), fetched(fetched), expiration(expiration),
+        async_refresh_time(async_refresh_time) {}
+    bool update(RGWQuotaCacheStats *entry) override {
+      /* a superseded result is dropped, the later fetch installs its own */
+      entry->fetched(gen, fetched, expiration, async_refresh_time);
       return true;
     }
   };
 
+  /* lets another refresh be started after one failed */
+  class StatsRefreshFailed : public lru_map<T, RGWQuotaCacheStats>::UpdateContext {
+  public:
+    bool update(RGWQuotaCacheStats *entry) override {
+      return entry->refresh_failed(ceph_clock_now());
+    }
+  };
+
   virtual int fetch_stats_from_storage(const rgw_user& user, const rgw_bucket& bucket, RGWStorageStats& stats, optional_yield y, const DoutPrefixProvider *dpp) = 0;
 
   virtual bool map_find(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs) = 0;
@@ -86,19 +159,24 @@ public:
                 const DoutPrefixProvider* dpp);
   void adjust_stats(const rgw_user& user, rgw_bucket& bucket, int objs_delta, uint64_t added_bytes, uint64_t removed_bytes);
 
-  void set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs, RGWStorageStats& stats);
+  void set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs, RGWStorageStats& stats,
+                 uint64_t gen);
   int async_refresh(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs);
-  void async_refresh_response(const rgw_user& user, rgw_bucket& bucket, RGWStorageStats& stats);
+  void async_refresh_response(const rgw_user& user, rgw_bucket& bucket, RGWStorageStats& stats,
+                              uint64_t gen);
   void async_refresh_fail(const rgw_user& user, rgw_bucket& bucket);
 
   class AsyncRefreshHandler {
   protected:
     rgw::sal::Store* store;
     RGWQuotaCache<T> *cache;
+    uint64_t gen = 0; /* generation of the fetch, passed back with its result */
   public:
     AsyncRefreshHandler(rgw::sal::Store* _store, RGWQuotaCache<T> *_cache) : store(_store), cache(_cache) {}
     virtual ~AsyncRefreshHandler() {}
 
+    void set_gen(uint64_t _gen) { gen = _gen; }
+
     virtual int init_fetch() = 0;
     virtual void drop_reference() = 0;
   };
@@ -120,6 +198,7 @@ int RGWQuotaCache<T>::async_refresh(const rgw_user& user, const rgw_bucket& buck
 
 
   AsyncRefreshHandler *handler = allocate_refresh_handler(user, bucket);
+  handler->set_gen(test_update.gen);
 
   int ret = handler->init_fetch();
   if (ret < 0) {
@@ -136,32 +215,40 @@ void RGWQuotaCache<T>::async_refresh_fail(const rgw_user& user, rgw_bucket& buck
 {
   ldout(store->ctx(), 20) << "async stats refresh response for bucket=" << bucket << dendl;
 
+  StatsRefreshFailed failed;
+  map_find_and_update(user, bucket, &failed);
+
   async_refcount->put();
 }
 
 template<class T>
-void RGWQuotaCache<T>::async_refresh_response(const rgw_user& user, rgw_bucket& bucket, RGWStorageStats& stats)
+void RGWQuotaCache<T>::async_refresh_response(const rgw_user& user, rgw_bucket& bucket, RGWStorageStats& stats,
+                                              uint64_t gen)
 {
   ldout(store->ctx(), 20) << "async stats refresh response for bucket=" << bucket << dendl;
 
   RGWQuotaCacheStats qs;
 
-  map_find(user, bucket, qs);
-
-  set_stats(user, bucket, qs, stats);
+  set_stats(user, bucket, qs, stats, gen);
 
   async_refcount->put();
 }
 
 template<class T>
-void RGWQuotaCache<T>::set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs, RGWStorageStats& stats)
+void RGWQuotaCache<T>::set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs, RGWStorageStats& stats,
+                                 uint64_t gen)
 {
-  qs.stats = stats;
   qs.expiration = ceph_clock_now();
   qs.async_refresh_time = qs.expiration;
   qs.expiration += store->ctx()->_conf->rgw_bucket_quota_ttl;
   qs.async_refresh_time += store->ctx()->_conf->rgw_bucket_quota_ttl / 2;
 
+  StatsReconcile reconcile(gen, stats, qs.expiration, qs.async_refresh_time);
+  if (map_find_and_update(user, bucket, &reconcile)) {
+    return;
+  }
+
+  qs.stats = stats;
   map_add(user, bucket, qs);
 }
 
@@ -169,6 +256,7 @@ template<class T>
 int RGWQuotaCache<T>::get_stats(const rgw_user& user, const rgw_bucket& bucket, RGWStorageStats& stats, optional_yield y, const DoutPrefixProvider* dpp) {
   RGWQuotaCacheStats qs;
   utime_t now = ceph_clock_now();
+  uint64_t gen = 0;
   if (map_find(user, bucket, qs)) {
     if (qs.async_refresh_time.sec() > 0 && now >= qs.async_refresh_time) {
       int r = async_refresh(user, bucket, qs);
@@ -179,17 +267,38 @@ int RGWQuotaCache<T>::get_stats(const rgw_user& user, const rgw_bucket& bucket,
       }
     }
 
-    if (qs.expiration > ceph_clock_now()) {
+    if (qs.expiration > now) {
       stats = qs.stats;
       return 0;
     }
+
+    /* the entry expired. only one request refreshes it, the others keep
+     * using the expired stats (with local changes applied) for up to
+     * another ttl rather than all fetching the same stats */
+    StatsAsyncTestSet test_update;
+    if (map_find_and_update(user, bucket, &test_update)) {
+      gen = test_update.gen;
+    } else {
+      utime_t stale_limit = qs.expiration;
+      stale_limit += store->ctx()->_conf->rgw_bucket_quota_ttl;
+      if (now < stale_limit) {
+        stats = qs.stats;
+        return 0;
+      }
+      StatsFetchIssued issued;
+      map_find_and_update(user, bucket, &issued);
+      gen = issued.gen;
+    }
   }
 
   int ret = fetch_stats_from_storage(user, bucket, stats, y, dpp);
-  if (ret < 0 && ret != -ENOENT)
+  if (ret < 0 && ret != -ENOENT) {
+    StatsRefreshFailed failed;
+    map_find_and_update(user, bucket, &failed);
     return ret;
+  }
 
-  set_stats(user, bucket, qs, stats);
+  set_stats(user, bucket, qs, stats, gen);
 
   return 0;
 }
@@ -210,27 +319,7 @@ public:
   }
 
   bool update(RGWQuotaCacheStats * const entry) override {
-    const uint64_t rounded_added = rgw_rounded_objsize(added_bytes);
-    const uint64_t rounded_removed = rgw_rounded_objsize(removed_bytes);
-
-    if (((int64_t)(entry->stats.size + added_bytes - removed_bytes)) >= 0) {
-      entry->stats.size += added_bytes - removed_bytes;
-    } else {
-      entry->stats.size = 0;
-    }
-
-    if (((int64_t)(entry->stats.size_rounded + rounded_added - rounded_removed)) >= 0) {
-      entry->stats.size_rounded += rounded_added - rounded_removed;
-    } else {
-      entry->stats.size_rounded = 0;
-    }
-
-    if (((int64_t)(entry->stats.num_objects + objs_delta)) >= 0) {
-      entry->stats.num_objects += objs_delta;
-    } else {
-      entry->stats.num_objects = 0;
-    }
-
+    entry->adjust(objs_delta, added_bytes, removed_bytes);
     return true;
   }
 };
@@ -307,7 +396,7 @@ void BucketAsyncRefreshHandler::handle_response(const int r)
     bs.num_objects += s.num_objects;
   }
 
-  cache->async_refresh_response(user, bucket, bs);
+  cache->async_refresh_response(user, bucket, bs, gen);
 }
 
 class RGWBucketStatsCache : public RGWQuotaCache<rgw_bucket> {
@@ -417,7 +506,7 @@ void UserAsyncRefreshHandler::handle_response(int r)
     return;
   }
 
-  cache->async_refresh_response(user, bucket, stats);
+  cache->async_refresh_response(user, bucket, stats, gen);
 }
 
 class RGWUserStatsCache : public RGWQuotaCache<rgw_user> {
@@ -0,0 +1,124 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include "include/utime.h"
+#include "rgw_common.h"
+
+static inline void apply_stats_delta(RGWStorageStats& stats, int64_t objs_delta,
+                                     uint64_t added_bytes, uint64_t removed_bytes)
+{
+  const uint64_t rounded_added = rgw_rounded_objsize(added_bytes);
+  const uint64_t rounded_removed = rgw_rounded_objsize(removed_bytes);
+
+  if (((int64_t)(stats.size + added_bytes - removed_bytes)) >= 0) {
+    stats.size += added_bytes - removed_bytes;
+  } else {
+    stats.size = 0;
+  }
+
+  if (((int64_t)(stats.size_rounded + rounded_added - rounded_removed)) >= 0) {
+    stats.size_rounded += rounded_added - rounded_removed;
+  } else {
+    stats.size_rounded = 0;
+  }
+
+  if (((int64_t)(stats.num_objects + objs_delta)) >= 0) {
+    stats.num_objects += objs_delta;
+  } else {
+    stats.num_objects = 0;
+  }
+}
+
+/*
+ * Cached quota stats of a bucket or user.
+ *
+ * Local changes made after a fetch of the stats was issued are kept, and
+ * applied on top of the fetched stats when that fetch lands. Changes made
+ * before it was issued are already in what it reads and are dropped.
+ *
+ * A change whose index update the fetch already saw, but which was
+ * applied here after the fetch was issued, is still counted twice. That
+ * overcount is bounded by the writes in flight during a single fetch, and
+ * lasts until the next refresh.
+ */
+struct RGWQuotaCacheStats {
+  RGWStorageStats stats;
+  utime_t expiration;
+  utime_t async_refresh_time; /* zero while a refresh is in flight */
+
+  /* generation of the latest fetch issued for this entry */
+  uint64_t fetch_gen = 0;
+
+  /* local changes made since the latest fetch was issued */
+  int64_t pending_objs_delta = 0;
+  uint64_t pending_added_bytes = 0;
+  uint64_t pending_removed_bytes = 0;
+
+  /* claim the refresh of this entry, so that concurrent requests don't all
+   * fetch the same stats; fails if a refresh is already in flight */
+  bool claim_refresh() {
+    if (async_refresh_time.sec() == 0)
+      return false;
+
+    async_refresh_time = utime_t(0, 0);
+    return true;
+  }
+
+  /* let another refresh be claimed after one failed */
+  bool refresh_failed(utime_t now) {
+    if (async_refresh_time.sec() != 0)
+      return false;
+
+    async_refresh_time = now;
+    return true;
+  }
+
+  /* called as a fetch is issued; returns the generation that has to be
+   * passed to fetched() with its result */
+  uint64_t fetch_issued() {
+    pending_objs_delta = 0;
+    pending_added_bytes = 0;
+    pending_removed_bytes = 0;
+    return ++fetch_gen;
+  }
+
+  void adjust(int64_t objs_delta, uint64_t added_bytes, uint64_t removed_bytes) {
+    apply_stats_delta(stats, objs_delta, added_bytes, removed_bytes);
+
+    pending_objs_delta += objs_delta;
+    pending_added_bytes += added_bytes;
+    pending_removed_bytes += removed_bytes;
+  }
+
+  /* install the stats read by fetch generation gen. the result of a fetch
+   * that was superseded by a later one is dropped, and false returned */
+  bool fetched(uint64_t gen, const RGWStorageStats& fetched_stats,
+               utime_t _expiration, utime_t _async_refresh_time) {
+    if (gen != fetch_gen)
+      return false;
+
+    stats = fetched_stats;
+    apply_stats_delta(stats, pending_objs_delta,
+                      pending_added_bytes, pending_removed_bytes);
+    pending_objs_delta = 0;
+    pending_added_bytes = 0;
+    pending_removed_bytes = 0;
+    expiration = _expiration;
+    async_refresh_time = _async_refresh_time;
+    return true;
+  }
+};
@@ -25,6 +25,7 @@
 #include "rgw_sal.h"
 #include "rgw_zone.h"
 #include "rgw_cache.h"
+#include "rgw_bucket_list_merge.h"
 #include "rgw_acl.h"
 #include "rgw_acl_s3.h" /* for dumping s3policy in debug log */
 #include "rgw_aio_throttle.h"
@@ -801,6 +802,34 @@ struct complete_op_data {
   }
 };
 
+// completions destined for the same bucket index shard object that are
+// sent together in a single bucket_complete_op_batch call
+struct complete_op_batch {
+  RGWSI_RADOS::Obj bucket_obj;
+  ceph::mono_time deadline;
+  std::vector<complete_op_data*> entries;
+  // index keys written by the entries; the cls method reads each key
+  // before any of the batch's writes land, so a key may only appear once
+  std::set<cls_rgw_obj_key> keys;
+
+  bool conflicts(const complete_op_data* entry) const {
+    if (keys.count(entry->key)) {
+      return true;
+    }
+    for (const auto& k : entry->remove_objs) {
+      if (keys.count(k)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  void add(complete_op_data* entry) {
+    entries.push_back(entry);
+    keys.insert(entry->key);
+    keys.insert(entry->remove_objs.begin(), entry->remove_objs.end());
+  }
+};
+
 class RGWIndexCompletionManager {
   RGWRados* const store;
   const uint32_t num_shards;
@@ -813,12 +842,22 @@ class RGWIndexCompletionManager {
   bool _stop{false};
   std::thread retry_thread;
 
+  // batches that are still open for more completions, keyed by bucket
+  // index shard object; only used when
+  // rgw_bucket_index_complete_batch_window_ms is nonzero
+  std::map<rgw_raw_obj, std::unique_ptr<complete_op_batch>> batches;
+  std::condition_variable batch_cond;
+  std::mutex batches_lock;
+  std::thread batch_thread;
+
   // used to distribute the completions and the locks they use across
   // their respective vectors; it will get incremented and can wrap
   // around back to 0 without issue
   std::atomic<uint32_t> cur_shard {0};
 
   void process();
+  void process_batches();
+  void send_batch(std::unique_ptr<complete_op_batch> batch);
   
   void add_completion(complete_op_data *completion);
   
@@ -828,6 +867,14 @@ class RGWIndexCompletionManager {
       cond.notify_all();
       retry_thread.join();
     }
+    if (batch_thread.joinable()) {
+      {
+        std::lock_guard l{batches_lock};
+        _stop = true;
+      }
+      batch_cond.notify_all();
+      batch_thread.join();
+    }
 
     for (uint32_t i = 0; i < num_shards; ++i) {
       std::lock_guard l{locks[i]};
@@ -853,7 +900,8 @@ public:
 				std::to_string(i));
       })},
     completions(num_shards),
-    retry_thread(&RGWIndexCompletionManager::process, this)
+    retry_thread(&RGWIndexCompletionManager::process, this),
+    batch_thread(&RGWIndexCompletionManager::process_batches, this)
     {}
 
   ~RGWIndexCompletionManager() {
@@ -870,29 +918,53 @@ public:
                          rgw_zone_set *zones_trace,
                          complete_op_data **result);
 
-  bool handle_completion(completion_t cb, complete_op_data *arg);
+  bool handle_completion(int r, complete_op_data *arg);
+
+  bool batching_enabled() const {
+    return store->ctx()->_conf->rgw_bucket_index_complete_batch_window_ms > 0;
+  }
+
+  // queues a completion created by create_completion() to be sent
+  // with others for the same bucket index shard object instead of
+  // sending it with its own rados completion
+  void add_to_batch(const RGWSI_RADOS::Obj& bucket_obj, complete_op_data *entry);
 
   CephContext* ctx() {
     return store->ctx();
   }
 };
 
-static void obj_complete_cb(completion_t cb, void *arg)
+static void complete_op_finish(complete_op_data *completion, int r)
 {
-  complete_op_data *completion = reinterpret_cast<complete_op_data*>(arg);
   completion->lock.lock();
   if (completion->stopped) {
     completion->lock.unlock(); /* can drop lock, no one else is referencing us */
     delete completion;
     return;
   }
-  bool need_delete = completion->manager->handle_completion(cb, completion);
+  bool need_delete = completion->manager->handle_completion(r, completion);
   completion->lock.unlock();
   if (need_delete) {
     delete completion;
   }
 }
 
+static void obj_complete_cb(completion_t cb, void *arg)
+{
+  complete_op_data *completion = reinterpret_cast<complete_op_data*>(arg);
+  complete_op_finish(completion, rados_aio_get_return_value(cb));
+}
+
+static void obj_complete_batch_cb(completion_t cb, void *arg)
+{
+  std::unique_ptr<complete_op_batch> batch{
+    reinterpret_cast<complete_op_batch*>(arg)};
+  const int r = rados_aio_get_return_value(cb);
+  for (auto completion : batch->entries) {
+    complete_op_finish(completion, r);
+  }
+}
+
 void RGWIndexCompletionManager::process()
 {
   DoutPrefix dpp(store->ctx(), dout_subsys, "rgw index completion thread: ");
@@ -953,6 +1025,122 @@ void RGWIndexCompletionManager::process()
   }
 }
 
+void RGWIndexCompletionManager::process_batches()
+{
+  std::unique_lock l{batches_lock};
+  while (!_stop) {
+    if (batches.empty()) {
+      batch_cond.wait(l, [this] { return _stop || !batches.empty(); });
+      continue;
+    }
+
+    // send every batch whose window has closed and sleep until the
+    // next one does
+    const auto now = ceph::mono_clock::now();
+    auto next_deadline = ceph::mono_time::max();
+    std::vector<std::unique_ptr<complete_op_batch>> due;
+    for (auto i = batches.begin(); i != batches.end(); ) {
+      if (i->second->deadline <= now) {
+        due.push_back(std::move(i->second));
+        i = batches.erase(i);
+      } else {
+        next_deadline = std::min(next_deadline, i->second->deadline);
+        ++i;
+      }
+    }
+
+    if (due.empty()) {
+      batch_cond.wait_until(l, next_deadline);
+      continue;
+    }
+
+    l.unlock();
+    for (auto& batch : due) {
+      send_batch(std::move(batch));
+    }
+    l.lock();
+  }
+
+  // don't strand completions that were waiting for their window
+  for (auto& [obj, batch] : batches) {
+    send_batch(std::move(batch));
+  }
+  batches.clear();
+}
+
+void RGWIndexCompletionManager::send_batch(std::unique_ptr<complete_op_batch> batch)
+{
+  std::vector<rgw_cls_obj_complete_op> ops;
+  ops.reserve(batch->entries.size());
+  for (auto c : batch->entries) {
+    auto& op = ops.emplace_back();
+    op.op = c->op;
+    op.tag = c->tag;
+    op.key = c->key;
+    op.ver = c->ver;
+    op.meta = c->dir_meta;
+    op.log_op = c->log_op;
+    op.bilog_flags = c->bilog_op;
+    op.remove_objs = c->remove_objs;
+    op.zones_trace = c->zones_trace;
+  }
+
+  ldout(ctx(), 20) << __func__ << "(): sending " << ops.size() <<
+    " completions to " << batch->bucket_obj.get_raw_obj() << dendl;
+
+  librados::ObjectWriteOperation o;
+  cls_rgw_guard_bucket_resharding(o, -ERR_BUSY_RESHARDING);
+  cls_rgw_bucket_complete_op_batch(o, ops);
+
+  auto batch_ptr = batch.release();
+  librados::AioCompletion *completion =
+    librados::Rados::aio_create_completion(batch_ptr, obj_complete_batch_cb);
+  int r = batch_ptr->bucket_obj.aio_operate(completion, &o);
+  completion->release();
+  if (r < 0) {
+    // the callback won't fire, so finish the entries here
+    std::unique_ptr<complete_op_batch> failed{batch_ptr};
+    for (auto c : failed->entries) {
+      complete_op_finish(c, r);
+    }
+  }
+}
+
+void RGWIndexCompletionManager::add_to_batch(const RGWSI_RADOS::Obj& bucket_obj,
+                                             complete_op_data *entry)
+{
+  auto& conf = ctx()->_conf;
+  std::unique_ptr<complete_op_batch> conflicting;
+  std::unique_ptr<complete_op_batch> full;
+  {
+    std::lock_guard l{batches_lock};
+    auto& batch = batches[bucket_obj.get_raw_obj()];
+    if (batch && batch->conflicts(entry)) {
+      // a second completion of the same key would read the entry as it
+      // was before the batch, so send the open batch first
+      conflicting = std::move(batch);
+    }
+    if (!batch) {
+      batch = std::make_unique<complete_op_batch>();
+      batch->bucket_obj = bucket_obj;
+      batch->deadline = ceph::mono_clock::now() +
+        std::chrono::milliseconds(conf->rgw_bucket_index_complete_batch_window_ms);
+      batch_cond.notify_all();
+    }
+    batch->add(entry);
+    if (batch->entries.size() >= conf->rgw_bucket_index_complete_batch_max) {
+      full = std::move(batch);
+      batches.erase(bucket_obj.get_raw_obj());
+    }
+  }
+  if (conflicting) {
+    send_batch(std::move(conflicting));
+  }
+  if (full) {
+    send_batch(std::move(full));
+  }
+}
+
 void RGWIndexCompletionManager::create_completion(const rgw_obj& obj,
                                                   RGWModifyOp op, string& tag,
                                                   rgw_bucket_entry_ver& ver,
@@ -1007,7 +1195,7 @@ void RGWIndexCompletionManager::add_completion(complete_op_data *completion) {
   cond.notify_all();
 }
 
-bool RGWIndexCompletionManager::handle_completion(completion_t cb, complete_op_data *arg)
+bool RGWIndexCompletionManager::handle_completion(int r, complete_op_data *arg)
 {
   int shard_id = arg->manager_shard_id;
   {
@@ -1024,8 +1212,9 @@ bool RGWIndexCompletionManager::handle_completion(completion_t cb, complete_op_d
     comps.erase(iter);
   }
 
-  int r = rados_aio_get_return_value(cb);
-  if (r != -ERR_BUSY_RESHARDING) {
+  // -EOPNOTSUPP comes from batches sent to an osd that doesn't know
+  // bucket_complete_op_batch; the retry path sends them one at a time
+  if (r != -ERR_BUSY_RESHARDING && r != -EOPNOTSUPP) {
     ldout(arg->manager->ctx(), 20) << __func__ << "(): completion " << 
       (r == 0 ? "ok" : "failed with " + to_string(r)) << 
       " for obj=" << arg->key << dendl;
@@ -3287,6 +3476,17 @@ int RGWRados::Object::Write::_do_write_meta(const DoutPrefixProvider *dpp,
       /* ignoring error, nothing we can do at this point */
     }
   }
+
+  if (store->get_lc() && store->ctx()->_conf->rgw_lc_expiration_index) {
+    r = store->get_lc()->add_to_expiration_index(dpp, target->get_target()->get_bucket(),
+                                                 obj.key, meta.set_mtime, y);
+    if (r < 0) {
+      ldpp_dout(dpp, 0) << "ERROR: add_to_expiration_index() returned r=" << r
+                        << ", object may not be expired until its lifecycle index is rebuilt"
+                        << dendl;
+      /* ignoring error, the write itself succeeded */
+    }
+  }
   meta.canceled = false;
 
   /* update quota cache */
@@ -6471,6 +6671,70 @@ int RGWRados::Object::Read::read(int64_t ofs, int64_t end, bufferlist& bl, optio
   return bl.length();
 }
 
+// exponentially weighted moving average
+static void update_average(double& average, double sample)
+{
+  average = (average == 0 ? sample : average + (sample - average) / 8);
+}
+
+void get_obj_data::update_window()
+{
+  if (read_latency == 0 || drain_rate == 0) {
+    return;
+  }
+  // keep twice the bytes the client consumes during one read in flight,
+  // and move part of the way there so a single sample can't swing it
+  const double target = std::clamp(2 * drain_rate * read_latency,
+                                   double(min_window), double(max_window));
+  const auto next = std::clamp<uint64_t>(window + (target - window) / 4,
+                                         min_window, max_window);
+  if (next != window) {
+    lsubdout(g_ceph_context, rgw, 20) << "get_obj_data: read window " <<
+      window << " -> " << next << " (read latency " << read_latency <<
+      "s, drain rate " << drain_rate << "B/s)" << dendl;
+    window = next;
+  }
+}
+
+rgw::AioResultList get_obj_data::get(const RGWSI_RADOS::Obj& obj,
+                                     rgw::Aio::OpFunc&& f,
+                                     uint64_t cost, uint64_t id)
+{
+  rgw::AioResultList results;
+  auto account = [this, &results] (rgw::AioResultList&& c, bool waited) {
+    const auto now = ceph::mono_clock::now();
+    for (auto& e : c) {
+      auto i = pending.find(e.id);
+      if (i != pending.end()) {
+        if (waited) {
+          // reads that a blocking wait returned completed just now, so
+          // they measure the read latency
+          update_average(read_latency,
+                         ceph::to_seconds<double>(now - i->second.issued));
+        }
+        pending_size -= i->second.cost;
+        pending.erase(i);
+      }
+    }
+    results.splice(results.end(), c);
+  };
+
+  while (pending_size > 0 && pending_size + cost > window) {
+    auto c = aio->poll();
+    if (!c.empty()) {
+      account(std::move(c), false);
+      continue;
+    }
+    account(aio->wait(), true);
+    update_window();
+  }
+
+  pending.emplace(id, pending_read{cost, ceph::mono_clock::now()});
+  pending_size += cost;
+  account(aio->get(obj, std::move(f), cost, id), false);
+  return results;
+}
+
 int get_obj_data::flush(rgw::AioResultList&& results) {
   int r = rgw::check_for_errors(results);
   if (r < 0) {
@@ -6487,10 +6751,16 @@ int get_obj_data::flush(rgw::AioResultList&& results) {
 
     bl_list.push_back(bl);
     offset += bl.length();
+    const auto start = ceph::mono_clock::now();
     int r = client_cb->handle_data(bl, 0, bl.length());
     if (r < 0) {
       return r;
     }
+    const auto elapsed = ceph::to_seconds<double>(ceph::mono_clock::now() - start);
+    if (elapsed > 0) {
+      update_average(drain_rate, bl.length() / elapsed);
+      update_window();
+    }
 
     if (rgwrados->get_use_datacache()) {
       const std::lock_guard l(d3n_get_data.d3n_lock);
@@ -6562,7 +6832,7 @@ int RGWRados::get_obj_iterate_cb(const DoutPrefixProvider *dpp,
   const uint64_t cost = len;
   const uint64_t id = obj_ofs; // use logical object offset for sorting replies
 
-  auto completed = d->aio->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
+  auto completed = d->get(obj, rgw::Aio::librados_op(std::move(op), d->yield), cost, id);
 
   return d->flush(std::move(completed));
 }
@@ -6574,9 +6844,11 @@ int RGWRados::Object::Read::iterate(const DoutPrefixProvider *dpp, int64_t ofs,
   CephContext *cct = store->ctx();
   const uint64_t chunk_size = cct->_conf->rgw_get_obj_max_req_size;
   const uint64_t window_size = cct->_conf->rgw_get_obj_window_size;
+  const uint64_t max_window_size = std::max<uint64_t>(window_size,
+      cct->_conf->rgw_get_obj_max_window_size);
 
-  auto aio = rgw::make_throttle(window_size, y);
-  get_obj_data data(store, cb, &*aio, ofs, y);
+  auto aio = rgw::make_throttle(max_window_size, y);
+  get_obj_data data(store, cb, &*aio, ofs, y, window_size, max_window_size);
 
   int r = store->iterate_obj(dpp, source->get_ctx(), source->get_bucket_info(),
 			     source->get_target(),
@@ -8421,7 +8693,6 @@ int RGWRados::cls_obj_complete_op(BucketShard& bs, const rgw_obj& obj, RGWModify
     ", remove_objs=" << (remove_objs ? *remove_objs : std::list<rgw_obj_index_key>()) << dendl_bitx;
   ldout_bitx_c(bitx, cct, 25) << "BACKTRACE: " << __func__ << ": " << ClibBackTrace(0) << dendl_bitx;
 
-  ObjectWriteOperation o;
   rgw_bucket_dir_entry_meta dir_meta;
   dir_meta = ent.meta;
   dir_meta.category = category;
@@ -8436,14 +8707,22 @@ int RGWRados::cls_obj_complete_op(BucketShard& bs, const rgw_obj& obj, RGWModify
   ver.pool = pool;
   ver.epoch = epoch;
   cls_rgw_obj_key key(ent.key.name, ent.key.instance);
-  cls_rgw_guard_bucket_resharding(o, -ERR_BUSY_RESHARDING);
-  cls_rgw_bucket_complete_op(o, op, tag, ver, key, dir_meta, remove_objs,
-                             svc.zone->get_zone().log_data, bilog_flags, &zones_trace);
   complete_op_data *arg;
   index_completion_manager->create_completion(obj, op, tag, ver, key, dir_meta, remove_objs,
                                               svc.zone->get_zone().log_data, bilog_flags, &zones_trace, &arg);
   librados::AioCompletion *completion = arg->rados_completion;
-  int ret = bs.bucket_obj.aio_operate(arg->rados_completion, &o);
+  int ret = 0;
+  if (index_completion_manager->batching_enabled()) {
+    // the batch is sent with its own rados completion, so this one is
+    // never used
+    index_completion_manager->add_to_batch(bs.bucket_obj, arg);
+  } else {
+    ObjectWriteOperation o;
+    cls_rgw_guard_bucket_resharding(o, -ERR_BUSY_RESHARDING);
+    cls_rgw_bucket_complete_op(o, op, tag, ver, key, dir_meta, remove_objs,
+                               svc.zone->get_zone().log_data, bilog_flags, &zones_trace);
+    ret = bs.bucket_obj.aio_operate(arg->rados_completion, &o);
+  }
   completion->release(); /* can't reference arg here, as it might have already been released */
 
   ldout_bitx_c(bitx, cct, 10) << "EXITING " << __func__ << ": ret=" << ret << dendl_bitx;
@@ -8615,105 +8894,12 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     return r;
   }
 
-  // to manage the iterators through each shard's list results
-  struct ShardTracker {
-    const size_t shard_idx;
-    rgw_cls_list_ret& result;
-    const std::string& oid_name;
-    RGWRados::ent_map_t::iterator cursor;
-    RGWRados::ent_map_t::iterator end;
-
-    // manages an iterator through a shard and provides other
-    // accessors
-    ShardTracker(size_t _shard_idx,
-		 rgw_cls_list_ret& _result,
-		 const std::string& _oid_name):
-      shard_idx(_shard_idx),
-      result(_result),
-      oid_name(_oid_name),
-      cursor(_result.dir.m.begin()),
-      end(_result.dir.m.end())
-    {}
-
-    inline const std::string& entry_name() const {
-      return cursor->first;
-    }
-    rgw_bucket_dir_entry& dir_entry() const {
-      return cursor->second;
-    }
-    inline bool is_truncated() const {
-      return result.is_truncated;
-    }
-    inline ShardTracker& advance() {
-      ++cursor;
-      // return a self-reference to allow for chaining of calls, such
-      // as x.advance().at_end()
-      return *this;
-    }
-    inline bool at_end() const {
-      return cursor == end;
-    }
-  }; // ShardTracker
-
-  // add the next unique candidate, or return false if we reach the end
-  auto next_candidate = [] (CephContext *cct, ShardTracker& t,
-                            std::map<std::string, size_t>& candidates,
-                            size_t tracker_idx) {
-    while (!t.at_end()) {
-      if (candidates.emplace(t.entry_name(), tracker_idx).second) {
-        return;
-      }
-      t.advance(); // skip duplicate common prefixes
-    }
-  };
-
-  // one tracker per shard requested (may not be all shards)
-  std::vector<ShardTracker> results_trackers;
-  results_trackers.reserve(shard_list_results.size());
-  for (auto& r : shard_list_results) {
-    results_trackers.emplace_back(r.first, r.second, shard_oids[r.first]);
-
-    // if any *one* shard's result is trucated, the entire result is
-    // truncated
-    *is_truncated = *is_truncated || r.second.is_truncated;
-
-    // unless *all* are shards are cls_filtered, the entire result is
-    // not filtered
-    *cls_filtered = *cls_filtered && r.second.cls_filtered;
-  }
-
-  // create a map to track the next candidate entry from ShardTracker
-  // (key=candidate, value=index into results_trackers); as we consume
-  // entries from shards, we replace them with the next entries in the
-  // shards until we run out
-  std::map<std::string, size_t> candidates;
-  size_t tracker_idx = 0;
-  for (auto& t : results_trackers) {
-    // it's important that the values in the map refer to the index
-    // into the results_trackers vector, which may not be the same
-    // as the shard number (i.e., when not all shards are requested)
-    next_candidate(cct, t, candidates, tracker_idx);
-    ++tracker_idx;
-  }
-
-  rgw_bucket_dir_entry*
-    last_entry_visited = nullptr; // to set last_entry (marker)
   std::map<std::string, bufferlist> updates;
-  uint32_t count = 0;
-  while (count < num_entries && !candidates.empty()) {
-    r = 0;
-    // select the next entry in lexical order (first key in map);
-    // again tracker_idx is not necessarily shard number, but is index
-    // into results_trackers vector
-    tracker_idx = candidates.begin()->second;
-    auto& tracker = results_trackers.at(tracker_idx);
-
-    const std::string& name = tracker.entry_name();
-    rgw_bucket_dir_entry& dirent = tracker.dir_entry();
-
-    ldpp_dout(dpp, 20) << __PRETTY_FUNCTION__ << ": currently processing " <<
-      dirent.key << " from shard " << tracker.shard_idx << dendl;
 
+  // entries with uncommitted ops are checked against the current state,
+  // and clean-up is suggested if their tags are old
+  auto check_entry = [&] (const std::string& oid,
+			  rgw_bucket_dir_entry& dirent) -> int {
     const bool force_check =
       force_check_filter && force_check_filter(dirent.key.name);
 
@@ -8730,56 +8916,46 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
       ldout_bitx(bitx, dpp, 20) << "INFO: " << __func__ <<
 	" calling check_disk_state bucket=" << bucket_info.bucket <<
 	" entry=" << dirent.key << dendl_bitx;
-      r = check_disk_state(dpp, sub_ctx, bucket_info, dirent, dirent,
-			   updates[tracker.oid_name], y);
+      int r = check_disk_state(dpp, sub_ctx, bucket_info, dirent, dirent,
+			       updates[oid], y);
       if (r < 0 && r != -ENOENT) {
 	ldpp_dout(dpp, 0) << __PRETTY_FUNCTION__ <<
 	  ": check_disk_state for \"" << dirent.key <<
 	  "\" failed with r=" << r << dendl;
-	return r;
       }
-    } else {
-      r = 0;
+      return r;
     }
+    return 0;
+  };
 
-    // at this point either r >= 0 or r == -ENOENT
-    if (r >= 0) { // i.e., if r != -ENOENT
-      ldpp_dout(dpp, 10) << __PRETTY_FUNCTION__ << ": got " <<
-	dirent.key << dendl;
-
-      auto [it, inserted] = m.insert_or_assign(name, std::move(dirent));
-      last_entry_visited = &it->second;
-      if (inserted) {
-	++count;
-      } else {
-	ldpp_dout(dpp, 0) << "WARNING: " << __PRETTY_FUNCTION__ <<
-	  " reassigned map value at \"" << name <<
-	  "\", which should not happen" << dendl;
-      }
-    } else {
-      ldpp_dout(dpp, 10) << __PRETTY_FUNCTION__ << ": skipping " <<
-	dirent.key.name << "[" << dirent.key.instance << "]" << dendl;
-      last_entry_visited = &tracker.dir_entry();
+  auto refill_shard = [&] (int shard, const std::string& oid,
+			   const cls_rgw_obj_key& marker,
+			   uint32_t max_entries,
+			   rgw_cls_list_ret* result) -> int {
+    std::map<int, std::string> refill_oid{{shard, oid}};
+    std::map<int, rgw_cls_list_ret> refill_result;
+    int ret = CLSRGWIssueBucketList(ioctx, marker, prefix, delimiter,
+				    max_entries, list_versions, refill_oid,
+				    refill_result, 1)();
+    if (ret < 0) {
+      ldpp_dout(dpp, 0) << __PRETTY_FUNCTION__ <<
+	": refill of shard " << shard << " for " << bucket_info.bucket <<
+	" failed with r=" << ret << dendl;
+      return ret;
     }
+    *result = std::move(refill_result[shard]);
+    return 0;
+  };
 
-    // refresh the candidates map
-    candidates.erase(candidates.begin());
-    tracker.advance();
-
-    next_candidate(cct, tracker, candidates, tracker_idx);
-
-    if (tracker.at_end() && tracker.is_truncated()) {
-      // once we exhaust one shard that is truncated, we need to stop,
-      // as we cannot be certain that one of the next entries needs to
-      // come from that shard; S3 and swift protocols allow returning
-      // fewer than what was requested
-      ldpp_dout(dpp, 10) << __PRETTY_FUNCTION__ <<
-	": stopped accumulating results at count=" << count <<
-	", dirent=\"" << dirent.key <<
-	"\", because its shard is untruncated and exhaused" << dendl;
-      break;
-    }
-  } // while we haven't provided requested # of result entries
+  std::optional<cls_rgw_obj_key> last_entry_visited; // to set last_entry (marker)
+  r = rgw::bucket_list::merge_ordered(dpp, shard_list_results, shard_oids,
+				      num_entries, num_entries_per_shard,
+				      check_entry, refill_shard, m,
+				      is_truncated, cls_filtered,
+				      last_entry_visited);
+  if (r < 0) {
+    return r;
+  }
 
   // suggest updates if there are any
   for (auto& miter : updates) {
@@ -8797,28 +8973,8 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     }
   } // updates loop
 
-  // determine truncation by checking if all the returned entries are
-  // consumed or not
-  *is_truncated = false;
-  for (const auto& t : results_trackers) {
-    if (!t.at_end() || t.is_truncated()) {
-      *is_truncated = true;
-      break;
-    }
-  }
-
-  ldpp_dout(dpp, 20) << __PRETTY_FUNCTION__ <<
-    ": returning, count=" << count << ", is_truncated=" << *is_truncated <<
-    dendl;
-
-  if (*is_truncated && count < num_entries) {
-    ldpp_dout(dpp, 10) << __PRETTY_FUNCTION__ <<
-      ": requested " << num_entries << " entries but returning " <<
-      count << ", which is truncated" << dendl;
-  }
-
-  if (last_entry_visited != nullptr && last_entry) {
-    *last_entry = last_entry_visited->key;
+  if (last_entry_visited && last_entry) {
+    *last_entry = *last_entry_visited;
     ldpp_dout(dpp, 20) << __PRETTY_FUNCTION__ <<
       ": returning, last_entry=" << *last_entry << dendl;
   } else {
@@ -1598,9 +1598,29 @@ struct get_obj_data {
   rgw::AioResultList completed; // completed read results, sorted by offset
   optional_yield yield;
 
+  // adaptive read-ahead window, between rgw_get_obj_window_size and
+  // rgw_get_obj_max_window_size. it follows the bytes the client consumes
+  // during one read latency, both measured as moving averages, so it
+  // grows on high latency clusters while the client keeps up and decays
+  // again once the client drains slower than the reads return
+  uint64_t min_window;
+  uint64_t window;
+  uint64_t max_window;
+  uint64_t pending_size = 0; // cost of reads issued but not yet completed
+  struct pending_read {
+    uint64_t cost;
+    ceph::mono_time issued;
+  };
+  boost::container::flat_map<uint64_t, pending_read> pending; // by id
+  double read_latency = 0; // seconds
+  double drain_rate = 0; // bytes per second
+
   get_obj_data(RGWRados* rgwrados, RGWGetDataCB* cb, rgw::Aio* aio,
-               uint64_t offset, optional_yield yield)
-               : rgwrados(rgwrados), client_cb(cb), aio(aio), offset(offset), yield(yield) {}
+               uint64_t offset, optional_yield yield,
+               uint64_t window, uint64_t max_window)
+               : rgwrados(rgwrados), client_cb(cb), aio(aio), offset(offset), yield(yield),
+                 min_window(window), window(window),
+                 max_window(std::max(window, max_window)) {}
   ~get_obj_data() {
     if (rgwrados->get_use_datacache()) {
       const std::lock_guard l(d3n_get_data.d3n_lock);
@@ -1610,7 +1630,12 @@ struct get_obj_data {
   D3nGetObjData d3n_get_data;
   std::atomic_bool d3n_bypass_cache_write{false};
 
+  // issue a read through the adaptive window, returning any reads that
+  // completed in the meantime
+  rgw::AioResultList get(const RGWSI_RADOS::Obj& obj, rgw::Aio::OpFunc&& f,
+                         uint64_t cost, uint64_t id);
   int flush(rgw::AioResultList&& results);
+  void update_window();
 
   void cancel() {
     // wait for all completions to drain and ignore the results
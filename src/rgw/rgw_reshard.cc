@@ -246,6 +246,99 @@ public:
   }
 }; // class BucketReshardManager
 
+// find the shard of the target index layout that holds the given key
+static int get_target_shard(rgw::sal::RadosStore* store,
+                            const RGWBucketInfo& bucket_info,
+                            const rgw::bucket_index_layout_generation& target,
+                            const rgw_obj_key& key,
+                            int *shard_index,
+                            const DoutPrefixProvider *dpp)
+{
+  rgw_obj obj(bucket_info.bucket, key);
+  RGWMPObj mp;
+  if (key.ns == RGW_OBJ_NS_MULTIPART && mp.from_meta(key.name)) {
+    // place the multipart .meta object on the same shard as its head object
+    obj.index_hash_source = mp.get_key();
+  }
+  int target_shard_id;
+  int ret = store->getRados()->get_target_shard_id(target.layout.normal,
+                                                   obj.get_hash_object(),
+                                                   &target_shard_id);
+  if (ret < 0) {
+    ldpp_dout(dpp, -1) << "ERROR: get_target_shard_id() returned ret=" << ret << dendl;
+    return ret;
+  }
+  *shard_index = (target_shard_id > 0 ? target_shard_id : 0);
+  return 0;
+}
+
+// keys that cls_rgw records on a shard while it is IN_LOGRECORD
+static const std::string reshard_log_prefix =
+    std::string(1, char(0x80)) + RGW_BI_RESHARD_LOG_PREFIX;
+
+static int list_reshard_log(const DoutPrefixProvider *dpp,
+                            RGWRados::BucketShard& bs,
+                            uint32_t max,
+                            std::map<std::string, bufferlist> *entries,
+                            bool *is_truncated)
+{
+  librados::ObjectReadOperation op;
+  int rval = 0;
+  // the copied keys are removed from the log, so always list from the start
+  op.omap_get_vals2(reshard_log_prefix, reshard_log_prefix, max,
+                    entries, is_truncated, &rval);
+  int ret = bs.bucket_obj.operate(dpp, &op, nullptr, null_yield);
+  if (ret < 0) {
+    return ret;
+  }
+  return rval;
+}
+
+// drop whatever is left in the reshard logs of the current index shards
+static int clear_reshard_log(rgw::sal::RadosStore* store,
+                             const RGWBucketInfo& bucket_info,
+                             const DoutPrefixProvider *dpp)
+{
+  const auto& current = bucket_info.layout.current_index;
+  if (current.layout.type != rgw::BucketIndexType::Normal) {
+    return 0;
+  }
+  const uint32_t max = store->ctx()->_conf.get_val<uint64_t>("rgw_reshard_batch_size");
+  int ret = 0;
+  for (uint32_t i = 0; i < current.layout.normal.num_shards; ++i) {
+    RGWRados::BucketShard bs(store->getRados());
+    int r = bs.init(dpp, bucket_info, current, i);
+    if (r < 0) {
+      ret = r;
+      continue;
+    }
+    bool is_truncated = true;
+    while (is_truncated) {
+      std::map<std::string, bufferlist> entries;
+      r = list_reshard_log(dpp, bs, max, &entries, &is_truncated);
+      if (r < 0 || entries.empty()) {
+        break;
+      }
+      std::set<std::string> keys;
+      for (auto& e : entries) {
+        keys.insert(e.first);
+      }
+      librados::ObjectWriteOperation op;
+      op.omap_rm_keys(keys);
+      r = bs.bucket_obj.operate(dpp, &op, null_yield);
+      if (r < 0) {
+        break;
+      }
+    }
+    if (r < 0 && r != -ENOENT) {
+      ldpp_dout(dpp, 1) << "WARNING: " << __func__ << " failed to clear "
+          "reshard log of shard " << i << ": " << cpp_strerror(r) << dendl;
+      ret = r;
+    }
+  }
+  return ret;
+}
+
 RGWBucketReshard::RGWBucketReshard(rgw::sal::RadosStore* _store,
 				   const RGWBucketInfo& _bucket_info,
 				   const std::map<std::string, bufferlist>& _bucket_attrs,
@@ -505,6 +598,7 @@ static int init_reshard(rgw::sal::RadosStore* store,
 			std::map<std::string, bufferlist>& bucket_attrs,
                         ReshardFaultInjector& fault,
                         uint32_t new_num_shards,
+                        bool online,
                         const DoutPrefixProvider *dpp)
 {
   int ret = init_target_layout(store, bucket_info, bucket_attrs, fault, new_num_shards, dpp);
@@ -514,7 +608,9 @@ static int init_reshard(rgw::sal::RadosStore* store,
 
   if (ret = fault.check("block_writes");
       ret == 0) { // no fault injected, block writes to the current index shards
+    // or, when online, have them record the keys that are written instead
     ret = set_resharding_status(dpp, store, bucket_info,
+                                online ? cls_rgw_reshard_status::IN_LOGRECORD :
                                 cls_rgw_reshard_status::IN_PROGRESS);
   }
 
@@ -543,6 +639,9 @@ static int cancel_reshard(rgw::sal::RadosStore* store,
     ret = 0; // non-fatal error
   }
 
+  // remove the keys left over from an online reshard (ignore errors)
+  clear_reshard_log(store, bucket_info, dpp);
+
   if (bucket_info.layout.target_index) {
     return revert_target_layout(store, bucket_info, bucket_attrs, fault, dpp);
   }
@@ -852,7 +951,6 @@ int RGWBucketReshard::do_reshard(const rgw::bucket_index_layout_generation& curr
 
 	marker = entry.idx;
 
-	int target_shard_id;
 	cls_rgw_obj_key cls_key;
 	RGWObjCategory category;
 	rgw_bucket_category_stats stats;
@@ -865,42 +963,21 @@ int RGWBucketReshard::do_reshard(const rgw::bucket_index_layout_generation& curr
 	  ldpp_dout(dpp, 10) << "Dropping entry with empty name, idx=" << marker << dendl;
 	  continue;
 	}
-	rgw_obj obj(bucket_info.bucket, key);
-	RGWMPObj mp;
-	if (key.ns == RGW_OBJ_NS_MULTIPART && mp.from_meta(key.name)) {
-	  // place the multipart .meta object on the same shard as its head object
-	  obj.index_hash_source = mp.get_key();
-	}
-	ret = store->getRados()->get_target_shard_id(bucket_info.layout.target_index->layout.normal,
-						     obj.get_hash_object(), &target_shard_id);
+	int shard_index;
+	ret = get_target_shard(store, bucket_info, target, key, &shard_index, dpp);
 	if (ret < 0) {
-	  ldpp_dout(dpp, -1) << "ERROR: get_target_shard_id() returned ret=" << ret << dendl;
 	  return ret;
 	}
 
-	int shard_index = (target_shard_id > 0 ? target_shard_id : 0);
-
 	ret = target_shards_mgr.add_entry(shard_index, entry, account,
 					  category, stats);
 	if (ret < 0) {
 	  return ret;
 	}
 
-	Clock::time_point now = Clock::now();
-	if (reshard_lock.should_renew(now)) {
-	  // assume outer locks have timespans at least the size of ours, so
-	  // can call inside conditional
-	  if (outer_reshard_lock) {
-	    ret = outer_reshard_lock->renew(now);
-	    if (ret < 0) {
-	      return ret;
-	    }
-	  }
-	  ret = reshard_lock.renew(now);
-	  if (ret < 0) {
-	    ldpp_dout(dpp, -1) << "Error renewing bucket lock: " << ret << dendl;
-	    return ret;
-	  }
+	ret = renew_locks(dpp);
+	if (ret < 0) {
+	  return ret;
 	}
 	if (verbose_json_out) {
 	  formatter->close_section();
@@ -927,6 +1004,230 @@ int RGWBucketReshard::do_reshard(const rgw::bucket_index_layout_generation& curr
   return 0;
 } // RGWBucketReshard::do_reshard
 
+int RGWBucketReshard::renew_locks(const DoutPrefixProvider *dpp)
+{
+  Clock::time_point now = Clock::now();
+  if (!reshard_lock.should_renew(now)) {
+    return 0;
+  }
+  // assume outer locks have timespans at least the size of ours, so
+  // can call inside conditional
+  if (outer_reshard_lock) {
+    int ret = outer_reshard_lock->renew(now);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  int ret = reshard_lock.renew(now);
+  if (ret < 0) {
+    ldpp_dout(dpp, -1) << "Error renewing bucket lock: " << ret << dendl;
+    return ret;
+  }
+  return 0;
+}
+
+// list the index entries of the given object name on a shard
+static int list_key_entries(rgw::sal::RadosStore* store,
+                            RGWRados::BucketShard& bs,
+                            const std::string& name,
+                            int max_entries,
+                            list<rgw_cls_bi_entry> *entries)
+{
+  string marker;
+  bool is_truncated = true;
+  while (is_truncated) {
+    list<rgw_cls_bi_entry> page;
+    int ret = store->getRados()->bi_list(bs, name, marker, max_entries,
+                                         &page, &is_truncated);
+    if (ret == -ENOENT) {
+      return 0;
+    } else if (ret < 0) {
+      return ret;
+    }
+    for (auto& entry : page) {
+      marker = entry.idx;
+      cls_rgw_obj_key key;
+      RGWObjCategory category;
+      rgw_bucket_category_stats stats;
+      entry.get_info(&key, &category, &stats);
+      if (key.name == name) {
+        entries->push_back(std::move(entry));
+      }
+    }
+  }
+  return 0;
+}
+
+static void account_entries(const list<rgw_cls_bi_entry>& entries, bool add,
+                            map<RGWObjCategory, rgw_bucket_category_stats>& delta)
+{
+  for (const auto& entry : entries) {
+    cls_rgw_obj_key key;
+    RGWObjCategory category;
+    rgw_bucket_category_stats stats;
+    if (!entry.get_info(&key, &category, &stats)) {
+      continue;
+    }
+    // the update is applied with unsigned modular arithmetic, so removed
+    // entries are accounted by adding their two's complement
+    auto& d = delta[category];
+    if (add) {
+      d.num_entries += stats.num_entries;
+      d.total_size += stats.total_size;
+      d.total_size_rounded += stats.total_size_rounded;
+      d.actual_size += stats.actual_size;
+    } else {
+      d.num_entries -= stats.num_entries;
+      d.total_size -= stats.total_size;
+      d.total_size_rounded -= stats.total_size_rounded;
+      d.actual_size -= stats.actual_size;
+    }
+  }
+}
+
+// replace the target shard's entries for a logged object name with the
+// current entries of the source shard
+static int copy_logged_key(rgw::sal::RadosStore* store,
+                           const RGWBucketInfo& bucket_info,
+                           RGWRados::BucketShard& source,
+                           const rgw::bucket_index_layout_generation& target,
+                           const cls_rgw_obj_key& key,
+                           int max_entries,
+                           const DoutPrefixProvider *dpp)
+{
+  int shard_index;
+  int ret = get_target_shard(store, bucket_info, target, rgw_obj_key(key),
+                             &shard_index, dpp);
+  if (ret < 0) {
+    return ret;
+  }
+  RGWRados::BucketShard dest(store->getRados());
+  ret = dest.init(dpp, bucket_info, target, shard_index);
+  if (ret < 0) {
+    return ret;
+  }
+
+  list<rgw_cls_bi_entry> source_entries;
+  ret = list_key_entries(store, source, key.name, max_entries, &source_entries);
+  if (ret < 0) {
+    ldpp_dout(dpp, 0) << "ERROR: " << __func__ << " failed to list source "
+        "entries of " << key << ": " << cpp_strerror(ret) << dendl;
+    return ret;
+  }
+  // nothing but the resharder writes to the target shards, so their entries
+  // can't change between here and the update below
+  list<rgw_cls_bi_entry> target_entries;
+  ret = list_key_entries(store, dest, key.name, max_entries, &target_entries);
+  if (ret < 0) {
+    ldpp_dout(dpp, 0) << "ERROR: " << __func__ << " failed to list target "
+        "entries of " << key << ": " << cpp_strerror(ret) << dendl;
+    return ret;
+  }
+
+  map<RGWObjCategory, rgw_bucket_category_stats> delta;
+  account_entries(source_entries, true, delta);
+  account_entries(target_entries, false, delta);
+
+  std::set<std::string> stale;
+  for (const auto& entry : target_entries) {
+    stale.insert(entry.idx);
+  }
+  for (const auto& entry : source_entries) {
+    stale.erase(entry.idx);
+  }
+
+  librados::ObjectWriteOperation op;
+  if (!stale.empty()) {
+    op.omap_rm_keys(stale);
+  }
+  for (auto& entry : source_entries) {
+    store->getRados()->bi_put(op, dest, entry);
+  }
+  cls_rgw_bucket_update_stats(op, false, delta);
+
+  ret = dest.bucket_obj.operate(dpp, &op, null_yield);
+  if (ret < 0) {
+    ldpp_dout(dpp, 0) << "ERROR: " << __func__ << " failed to update target "
+        "entries of " << key << ": " << cpp_strerror(ret) << dendl;
+    return ret;
+  }
+  return 0;
+}
+
+int RGWBucketReshard::copy_reshard_log(const rgw::bucket_index_layout_generation& current,
+                                       const rgw::bucket_index_layout_generation& target,
+                                       int max_entries,
+                                       uint64_t *num_keys,
+                                       const DoutPrefixProvider *dpp)
+{
+  *num_keys = 0;
+  const int num_source_shards = current.layout.normal.num_shards;
+  for (int i = 0; i < num_source_shards; ++i) {
+    RGWRados::BucketShard source(store->getRados());
+    int ret = source.init(dpp, bucket_info, current, i);
+    if (ret < 0) {
+      return ret;
+    }
+
+    bool is_truncated = true;
+    while (is_truncated) {
+      std::map<std::string, bufferlist> entries;
+      ret = list_reshard_log(dpp, source, max_entries, &entries, &is_truncated);
+      if (ret < 0 && ret != -ENOENT) {
+        ldpp_dout(dpp, 0) << "ERROR: " << __func__ << " failed to list "
+            "reshard log: " << cpp_strerror(ret) << dendl;
+        return ret;
+      }
+      if (entries.empty()) {
+        break;
+      }
+
+      // an object written several times is only copied once per batch
+      std::map<std::string, cls_rgw_obj_key> keys;
+      std::set<std::string> log_keys;
+      for (auto& [idx, bl] : entries) {
+        cls_rgw_obj_key key;
+        try {
+          auto p = bl.cbegin();
+          decode(key, p);
+        } catch (ceph::buffer::error& err) {
+          ldpp_dout(dpp, 0) << "ERROR: " << __func__ << " failed to decode "
+              "reshard log entry " << idx << dendl;
+          return -EIO;
+        }
+        keys.emplace(key.name, std::move(key));
+        log_keys.insert(idx);
+      }
+
+      for (const auto& [name, key] : keys) {
+        ret = copy_logged_key(store, bucket_info, source, target, key,
+                              max_entries, dpp);
+        if (ret < 0) {
+          return ret;
+        }
+      }
+
+      // log entries that were written during the copy sort after these, and
+      // are left for the next pass
+      librados::ObjectWriteOperation op;
+      op.omap_rm_keys(log_keys);
+      ret = source.bucket_obj.operate(dpp, &op, null_yield);
+      if (ret < 0) {
+        ldpp_dout(dpp, 0) << "ERROR: " << __func__ << " failed to trim "
+            "reshard log: " << cpp_strerror(ret) << dendl;
+        return ret;
+      }
+      *num_keys += keys.size();
+
+      ret = renew_locks(dpp);
+      if (ret < 0) {
+        return ret;
+      }
+    }
+  }
+  return 0;
+} // RGWBucketReshard::copy_reshard_log
+
 int RGWBucketReshard::get_status(const DoutPrefixProvider *dpp, list<cls_rgw_bucket_instance_entry> *status)
 {
   return store->svc()->bi_rados->get_reshard_status(dpp, bucket_info, status);
@@ -955,8 +1256,11 @@ int RGWBucketReshard::execute(int num_shards,
     }
   }
 
+  const bool online = store->ctx()->_conf.get_val<bool>("rgw_reshard_online");
+
   // prepare the target index and add its layout the bucket info
-  ret = init_reshard(store, bucket_info, bucket_attrs, fault, num_shards, dpp);
+  ret = init_reshard(store, bucket_info, bucket_attrs, fault, num_shards,
+                     online, dpp);
   if (ret < 0) {
     return ret;
   }
@@ -968,6 +1272,41 @@ int RGWBucketReshard::execute(int num_shards,
                      max_op_entries, verbose, out, formatter, dpp);
   }
 
+  if (ret == 0 && online) {
+    // catch up with the writes made during the copy. each pass should be
+    // shorter than the last; stop once one is small enough to repeat with
+    // writes blocked
+    static constexpr int max_log_passes = 5;
+    for (int pass = 0; pass < max_log_passes; ++pass) {
+      uint64_t num_keys = 0;
+      ret = copy_reshard_log(bucket_info.layout.current_index,
+                             *bucket_info.layout.target_index,
+                             max_op_entries, &num_keys, dpp);
+      ldpp_dout(dpp, 10) << __func__ << " reshard log pass " << pass
+          << " copied " << num_keys << " keys" << dendl;
+      if (ret < 0 || num_keys <= static_cast<uint64_t>(max_op_entries)) {
+        break;
+      }
+    }
+  }
+
+  if (ret == 0 && online) {
+    // block writes, and copy the keys written since the last pass
+    if (ret = fault.check("block_writes");
+        ret == 0) {
+      ret = set_resharding_status(dpp, store, bucket_info,
+                                  cls_rgw_reshard_status::IN_PROGRESS);
+    }
+    if (ret == 0) {
+      uint64_t num_keys = 0;
+      ret = copy_reshard_log(bucket_info.layout.current_index,
+                             *bucket_info.layout.target_index,
+                             max_op_entries, &num_keys, dpp);
+      ldpp_dout(dpp, 10) << __func__ << " final reshard log pass copied "
+          << num_keys << " keys" << dendl;
+    }
+  }
+
   if (ret < 0) {
     cancel_reshard(store, bucket_info, bucket_attrs, fault, dpp);
 
@@ -90,6 +90,14 @@ class RGWBucketReshard {
                  std::ostream *os,
 		 Formatter *formatter,
                  const DoutPrefixProvider *dpp);
+  // copy the keys recorded in the reshard logs of the current index shards
+  // to the target shards, and remove them from the logs
+  int copy_reshard_log(const rgw::bucket_index_layout_generation& current,
+                       const rgw::bucket_index_layout_generation& target,
+                       int max_entries,
+                       uint64_t *num_keys,
+                       const DoutPrefixProvider *dpp);
+  int renew_locks(const DoutPrefixProvider *dpp);
 public:
 
   // pass nullptr for the final parameter if no outer reshard lock to
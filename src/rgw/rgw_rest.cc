@@ -759,20 +759,22 @@ void dump_range(req_state* const s,
 }
 
 
-int dump_body(req_state* const s,
-              const char* const buf,
-              const size_t len)
+static void ratelimit_body(req_state* const s, const size_t len)
 {
-  bool healthchk = false;
   // we dont want to limit health checks
-  if(s->op_type == RGW_OP_GET_HEALTH_CHECK)
-    healthchk = true;
-  if(len > 0 && !healthchk) {
+  if(len > 0 && s->op_type != RGW_OP_GET_HEALTH_CHECK) {
     const char *method = s->info.method;
     s->ratelimit_data->decrease_bytes(method, s->ratelimit_user_name, len, &s->user_ratelimit);
     if(!rgw::sal::Bucket::empty(s->bucket.get()))
       s->ratelimit_data->decrease_bytes(method, s->ratelimit_bucket_marker, len, &s->bucket_ratelimit);
   }
+}
+
+int dump_body(req_state* const s,
+              const char* const buf,
+              const size_t len)
+{
+  ratelimit_body(s, len);
   try {
     return RESTFUL_IO(s)->send_body(buf, len);
   } catch (rgw::io::Exception& e) {
@@ -780,9 +782,31 @@ int dump_body(req_state* const s,
   }
 }
 
+static int dump_body_list(req_state* const s, const ceph::buffer::list& bl)
+{
+  ratelimit_body(s, bl.length());
+  try {
+    return RESTFUL_IO(s)->send_body_list(bl);
+  } catch (rgw::io::Exception& e) {
+    return -e.code().value();
+  }
+}
+
 int dump_body(req_state* const s, /* const */ ceph::buffer::list& bl)
 {
-  return dump_body(s, bl.c_str(), bl.length());
+  return dump_body_list(s, bl);
+}
+
+int dump_body(req_state* const s, const ceph::buffer::list& bl,
+              const off_t ofs, const size_t len)
+{
+  if (ofs == 0 && len == bl.length()) {
+    return dump_body_list(s, bl);
+  }
+  // share the buffers of the requested range instead of flattening bl
+  ceph::buffer::list range;
+  range.substr_of(bl, ofs, len);
+  return dump_body_list(s, range);
 }
 
 int dump_body(req_state* const s, const std::string& str)
@@ -814,5 +814,7 @@ extern void dump_access_control(req_state *s, RGWOp *op);
 
 extern int dump_body(req_state* s, const char* buf, size_t len);
 extern int dump_body(req_state* s, /* const */ ceph::buffer::list& bl);
+extern int dump_body(req_state* s, const ceph::buffer::list& bl,
+                     off_t ofs, size_t len);
 extern int dump_body(req_state* s, const std::string& str);
 extern int recv_body(req_state* s, char* buf, size_t max);
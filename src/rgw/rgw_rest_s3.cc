@@ -559,7 +559,7 @@ done:
 
 send_data:
   if (get_data && !op_ret) {
-    int r = dump_body(s, bl.c_str() + bl_ofs, bl_len);
+    int r = dump_body(s, bl, bl_ofs, bl_len);
     if (r < 0)
       return r;
   }
@@ -261,6 +261,8 @@ void aws_response_handler::send_stats_response()
 RGWSelectObj_ObjStore_S3::RGWSelectObj_ObjStore_S3():
   m_buff_header(std::make_unique<char[]>(1000)),
   m_parquet_type(false),
+  m_csv_query_set(false),
+  m_range_cache_ofs(0),
   chunk_number(0)
 {
   set_get_data(true);
@@ -334,47 +336,53 @@ int RGWSelectObj_ObjStore_S3::run_s3select(const char* query, const char* input,
   const char* s3select_resource_id = "resourcse-id";
   const char* s3select_processTime_error = "s3select-ProcessingTime-Error";
 
-  s3select_syntax.parse_query(query);
-  if (m_row_delimiter.size()) {
-    csv.row_delimiter = *m_row_delimiter.c_str();
-  }
-  if (m_column_delimiter.size()) {
-    csv.column_delimiter = *m_column_delimiter.c_str();
-  }
-  if (m_quot.size()) {
-    csv.quot_char = *m_quot.c_str();
-  }
-  if (m_escape_char.size()) {
-    csv.escape_char = *m_escape_char.c_str();
-  }
-  if (m_enable_progress.compare("true")==0) {
-    enable_progress = true;
-  } else {
-    enable_progress = false;
-  }
-  if (output_row_delimiter.size()) {
-    csv.output_row_delimiter = *output_row_delimiter.c_str();
-  }
-  if (output_column_delimiter.size()) {
-    csv.output_column_delimiter = *output_column_delimiter.c_str();
-  }
-  if (output_quot.size()) {
-    csv.output_quot_char = *output_quot.c_str();
-  }
-  if (output_escape_char.size()) {
-    csv.output_escape_char = *output_escape_char.c_str();
-  }
-  if(output_quote_fields.compare("ALWAYS") == 0) {
-    csv.quote_fields_always = true;
-  } else if(output_quote_fields.compare("ASNEEDED") == 0) {
-    csv.quote_fields_asneeded = true;
-  }
-  if(m_header_info.compare("IGNORE")==0) {
-    csv.ignore_header_info=true;
-  } else if(m_header_info.compare("USE")==0) {
-    csv.use_header_info=true;
+  // the query and csv definitions are the same for every segment of the
+  // object, and csv_object keeps its stream state between calls. parse them
+  // on the first segment only
+  if (!m_csv_query_set) {
+    s3select_syntax.parse_query(query);
+    if (m_row_delimiter.size()) {
+      csv.row_delimiter = *m_row_delimiter.c_str();
+    }
+    if (m_column_delimiter.size()) {
+      csv.column_delimiter = *m_column_delimiter.c_str();
+    }
+    if (m_quot.size()) {
+      csv.quot_char = *m_quot.c_str();
+    }
+    if (m_escape_char.size()) {
+      csv.escape_char = *m_escape_char.c_str();
+    }
+    if (m_enable_progress.compare("true")==0) {
+      enable_progress = true;
+    } else {
+      enable_progress = false;
+    }
+    if (output_row_delimiter.size()) {
+      csv.output_row_delimiter = *output_row_delimiter.c_str();
+    }
+    if (output_column_delimiter.size()) {
+      csv.output_column_delimiter = *output_column_delimiter.c_str();
+    }
+    if (output_quot.size()) {
+      csv.output_quot_char = *output_quot.c_str();
+    }
+    if (output_escape_char.size()) {
+      csv.output_escape_char = *output_escape_char.c_str();
+    }
+    if(output_quote_fields.compare("ALWAYS") == 0) {
+      csv.quote_fields_always = true;
+    } else if(output_quote_fields.compare("ASNEEDED") == 0) {
+      csv.quote_fields_asneeded = true;
+    }
+    if(m_header_info.compare("IGNORE")==0) {
+      csv.ignore_header_info=true;
+    } else if(m_header_info.compare("USE")==0) {
+      csv.use_header_info=true;
+    }
+    m_s3_csv_object.set_csv_query(&s3select_syntax, csv);
+    m_csv_query_set = true;
   }
-  m_s3_csv_object.set_csv_query(&s3select_syntax, csv);
   m_aws_response_handler.init_response();
   if (s3select_syntax.get_error_description().empty() == false) {
     //error-flow (syntax-error)
@@ -539,16 +547,40 @@ int RGWSelectObj_ObjStore_S3::range_request(int64_t ofs, int64_t len, void* buff
 {
   //purpose: implementation for arrow::ReadAt, this may take several async calls.
   //send_response_date(call_back) accumulate buffer, upon completion control is back to ReadAt.
-  range_req_str = "bytes=" + std::to_string(ofs) + "-" + std::to_string(ofs+len-1);
+  //small reads (footer, metadata, page headers) are served from a read-ahead window,
+  //instead of issuing a complete GET for each of them.
+  if (ofs >= m_range_cache_ofs && ofs + len <= m_range_cache_ofs + static_cast<int64_t>(m_range_cache.size())) {
+    ldout(s->cct, 10) << "S3select: range-request served from read-ahead: offset " << ofs << " length " << len << dendl;
+    memcpy(buff, m_range_cache.data() + (ofs - m_range_cache_ofs), len);
+    return len;
+  }
+  int64_t read_ofs = ofs;
+  int64_t read_len = len;
+  const int64_t read_ahead = s->cct->_conf->rgw_s3select_parquet_read_ahead;
+  if (len < read_ahead && s->obj_size > 0 && ofs + len <= static_cast<int64_t>(s->obj_size)) {
+    //the window ends at the object size, so a read of the footer also covers the metadata before it
+    const int64_t end = std::min<int64_t>(ofs + read_ahead, s->obj_size);
+    read_ofs = std::max<int64_t>(0, end - read_ahead);
+    read_len = end - read_ofs;
+  }
+  range_req_str = "bytes=" + std::to_string(read_ofs) + "-" + std::to_string(read_ofs+read_len-1);
   range_str = range_req_str.c_str();
   range_parsed = false;
   RGWGetObj::parse_range();
   requested_buffer.clear();
-  m_request_range = len;
-  ldout(s->cct, 10) << "S3select: calling execute(async):" << " request-offset :" << ofs << " request-length :" << len << " buffer size : " << requested_buffer.size() << dendl;
+  m_request_range = read_len;
+  ldout(s->cct, 10) << "S3select: calling execute(async):" << " request-offset :" << read_ofs << " request-length :" << read_len << " buffer size : " << requested_buffer.size() << dendl;
   RGWGetObj::execute(y);
-  memcpy(buff, requested_buffer.data(), len);
-  ldout(s->cct, 10) << "S3select: done waiting, buffer is complete buffer-size:" << requested_buffer.size() << dendl;
+  if (requested_buffer.size() < static_cast<size_t>(read_len)) {
+    ldout(s->cct, 10) << "S3select: range-request is incomplete buffer-size:" << requested_buffer.size() << " request range length:" << read_len << dendl;
+    return -EIO;
+  }
+  memcpy(buff, requested_buffer.data() + (ofs - read_ofs), len);
+  if (read_len != len) {
+    m_range_cache = std::move(requested_buffer);
+    m_range_cache_ofs = read_ofs;
+  }
+  ldout(s->cct, 10) << "S3select: done waiting, buffer is complete buffer-size:" << read_len << dendl;
   return len;
 }
 
@@ -598,18 +630,9 @@ int RGWSelectObj_ObjStore_S3::parquet_processing(bufferlist& bl, off_t ofs, off_
       end_header(s, this, "application/xml", CHUNKED_TRANSFER_ENCODING);
     }
     chunk_number++;
-    size_t append_in_callback = 0;
-    int part_no = 1;
-    //concat the requested buffer
-    for (auto& it : bl.buffers()) {
-      if(it.length() == 0) {
-        ldout(s->cct, 10) << "S3select: get zero-buffer while appending request-buffer " << dendl;
-      }
-      append_in_callback += it.length();
-      ldout(s->cct, 10) << "S3select: part " << part_no++ << " it.length() = " << it.length() << dendl;
-      requested_buffer.append(&(it)[0]+ofs, len);
-    }
-    ldout(s->cct, 10) << "S3select:append_in_callback = " << append_in_callback << dendl;
+    //concat the requested buffer; bl may hold several segments
+    bl.begin(ofs).copy(len, requested_buffer);
+    ldout(s->cct, 10) << "S3select:append_in_callback = " << len << " segments = " << bl.get_num_buffers() << dendl;
     if (requested_buffer.size() < m_request_range) {
       ldout(s->cct, 10) << "S3select: need another round buffe-size: " << requested_buffer.size() << " request range length:" << m_request_range << dendl;
       return 0;
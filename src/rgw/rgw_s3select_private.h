@@ -181,12 +181,17 @@ private:
 
   //parquet request
   bool m_parquet_type;
+  //csv request; set once the query was parsed and handed to m_s3_csv_object
+  bool m_csv_query_set;
 #ifdef _ARROW_EXIST
   s3selectEngine::rgw_s3select_api m_rgw_api;
 #endif
   //a request for range may statisfy by several calls to send_response_date;
   size_t m_request_range;
   std::string requested_buffer;
+  //read-ahead window of the last small range request
+  std::string m_range_cache;
+  int64_t m_range_cache_ofs;
   std::string range_req_str;
   std::function<int(std::string&)> fp_result_header_format;
   std::function<int(std::string&)> fp_s3select_result_format;
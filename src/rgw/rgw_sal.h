@@ -1406,6 +1406,58 @@ public:
   /** Store a modified head to the backing store */
   virtual int put_head(const std::string& oid, const LCHead& head) = 0;
 
+  /** Entry in a per-bucket expiration index, ordered by due time */
+  struct LCExpiration {
+    ceph::real_time due;
+    std::string key;
+
+    LCExpiration() = default;
+    LCExpiration(ceph::real_time _due, const std::string& _key) : due(_due), key(_key) {}
+  };
+
+  /** Add entries to an expiration index.  Stores that don't keep an expiration
+   * index return -EOPNOTSUPP from these, and lifecycle falls back to listing */
+  virtual int add_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			      const std::vector<LCExpiration>& entries, optional_yield y) {
+    return -EOPNOTSUPP;
+  }
+  /** List entries due before @a until, starting after @a marker */
+  virtual int list_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			       ceph::real_time until, const std::string& marker,
+			       uint32_t max_entries, std::vector<LCExpiration>& entries,
+			       std::string* next_marker, bool* truncated,
+			       optional_yield y) {
+    return -EOPNOTSUPP;
+  }
+  /** Remove entries due before @a until, up to and including @a to_marker */
+  virtual int trim_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			       ceph::real_time until, const std::string& to_marker,
+			       optional_yield y) {
+    return -EOPNOTSUPP;
+  }
+  /** Remove an expiration index entirely */
+  virtual int rm_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			     optional_yield y) {
+    return -EOPNOTSUPP;
+  }
+  /** Get the build state of an expiration index */
+  virtual int get_expiration_state(const DoutPrefixProvider* dpp, const std::string& oid,
+				   std::string& state, optional_yield y) {
+    return -EOPNOTSUPP;
+  }
+  /** Set the build state of an expiration index, optionally only if it is
+   * currently @a expected */
+  virtual int set_expiration_state(const DoutPrefixProvider* dpp, const std::string& oid,
+				   const std::string& state, optional_yield y,
+				   const std::string* expected = nullptr) {
+    return -EOPNOTSUPP;
+  }
+  /** Clear the build state of an existing expiration index so that it is rebuilt */
+  virtual int invalidate_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+				     optional_yield y) {
+    return -EOPNOTSUPP;
+  }
+
   /** Get a serializer for lifecycle */
   virtual LCSerializer* get_serializer(const std::string& lock_name, const std::string& oid, const std::string& cookie) = 0;
 };
@@ -47,6 +47,7 @@
 #include "services/svc_zone_utils.h"
 #include "services/svc_role_rados.h"
 #include "cls/rgw/cls_rgw_client.h"
+#include "cls/timeindex/cls_timeindex_client.h"
 
 #include "rgw_pubsub.h"
 
@@ -2296,14 +2297,31 @@ int RadosMultipartUpload::init(const DoutPrefixProvider *dpp, optional_yield y,
   return ret;
 }
 
+namespace {
+
+class RadosMultipartPartsOmap : public RGWMultipartPartsOmap {
+  rgw::sal::Object* obj;
+
+public:
+  RadosMultipartPartsOmap(rgw::sal::Object* obj) : obj(obj) {}
+
+  int get_vals(const DoutPrefixProvider *dpp, const std::string& marker,
+               uint64_t count, std::map<std::string, bufferlist>* m) override {
+    return obj->omap_get_vals(dpp, marker, count, m, nullptr, null_yield);
+  }
+  int get_all(const DoutPrefixProvider *dpp,
+              std::map<std::string, bufferlist>* m) override {
+    return obj->omap_get_all(dpp, m, null_yield);
+  }
+};
+
+} // anonymous namespace
+
 int RadosMultipartUpload::list_parts(const DoutPrefixProvider *dpp, CephContext *cct,
 				     int num_parts, int marker,
 				     int *next_marker, bool *truncated,
 				     bool assume_unsorted)
 {
-  map<string, bufferlist> parts_map;
-  map<string, bufferlist>::iterator iter;
-
   std::unique_ptr<rgw::sal::Object> obj = bucket->get_object(
 		      rgw_obj_key(get_meta(), std::string(), RGW_OBJ_NS_MULTIPART));
   obj->set_in_extra_data(true);
@@ -2312,85 +2330,18 @@ int RadosMultipartUpload::list_parts(const DoutPrefixProvider *dpp, CephContext
 
   parts.clear();
 
-  int ret;
-  if (sorted_omap) {
-    string p;
-    p = "part.";
-    char buf[32];
-
-    snprintf(buf, sizeof(buf), "%08d", marker);
-    p.append(buf);
-
-    ret = obj->omap_get_vals(dpp, p, num_parts + 1, &parts_map,
-                                 nullptr, null_yield);
-  } else {
-    ret = obj->omap_get_all(dpp, &parts_map, null_yield);
-  }
+  RadosMultipartPartsOmap omap(obj.get());
+  std::map<uint32_t, RGWUploadPartInfo> infos;
+  int ret = list_multipart_parts(dpp, omap, sorted_omap, num_parts, marker,
+                                 &infos, next_marker, truncated);
   if (ret < 0) {
     return ret;
   }
 
-  int i;
-  int last_num = 0;
-
-  uint32_t expected_next = marker + 1;
-
-  for (i = 0, iter = parts_map.begin();
-       (i < num_parts || !sorted_omap) && iter != parts_map.end();
-       ++iter, ++i) {
-    bufferlist& bl = iter->second;
-    auto bli = bl.cbegin();
+  for (auto& [num, info] : infos) {
     std::unique_ptr<RadosMultipartPart> part = std::make_unique<RadosMultipartPart>();
-    try {
-      decode(part->info, bli);
-    } catch (buffer::error& err) {
-      ldpp_dout(dpp, 0) << "ERROR: could not part info, caught buffer::error" <<
-	dendl;
-      return -EIO;
-    }
-    if (sorted_omap) {
-      if (part->info.num != expected_next) {
-        /* ouch, we expected a specific part num here, but we got a
-         * different one. Either a part is missing, or it could be a
-         * case of mixed rgw versions working on the same upload,
-         * where one gateway doesn't support correctly sorted omap
-         * keys for multipart upload just assume data is unsorted.
-         */
-        return list_parts(dpp, cct, num_parts, marker, next_marker, truncated, true);
-      }
-      expected_next++;
-    }
-    if (sorted_omap ||
-      (int)part->info.num > marker) {
-      last_num = part->info.num;
-      parts[part->info.num] = std::move(part);
-    }
-  }
-
-  if (sorted_omap) {
-    if (truncated) {
-      *truncated = (iter != parts_map.end());
-    }
-  } else {
-    /* rebuild a map with only num_parts entries */
-    std::map<uint32_t, std::unique_ptr<MultipartPart>> new_parts;
-    std::map<uint32_t, std::unique_ptr<MultipartPart>>::iterator piter;
-    for (i = 0, piter = parts.begin();
-	 i < num_parts && piter != parts.end();
-	 ++i, ++piter) {
-      last_num = piter->first;
-      new_parts[piter->first] = std::move(piter->second);
-    }
-
-    if (truncated) {
-      *truncated = (piter != parts.end());
-    }
-
-    parts.swap(new_parts);
-  }
-
-  if (next_marker) {
-    *next_marker = last_num;
+    part->info = std::move(info);
+    parts[num] = std::move(part);
   }
 
   return 0;
@@ -2418,7 +2369,11 @@ int RadosMultipartUpload::complete(const DoutPrefixProvider *dpp,
 
   int total_parts = 0;
   int handled_parts = 0;
-  int max_parts = 1000;
+  /* sorted omap is listed a page at a time. unsorted omap is read in full
+   * on every list_parts() call, so take all the parts in one page rather
+   * than reading and decoding them once per page */
+  int max_parts = is_v2_upload_id(get_upload_id()) ?
+    1000 : std::max<int>(part_etags.size(), 1);
   int marker = 0;
   uint64_t min_part_size = cct->_conf->rgw_multipart_min_part_size;
   auto etags_iter = part_etags.begin();
@@ -2789,6 +2744,144 @@ int RadosLifecycle::put_head(const std::string& oid, const LCHead& head)
   return cls_rgw_lc_put_head(*store->getRados()->get_lc_pool_ctx(), oid, cls_head);
 }
 
+static const char* RGW_LC_EXP_STATE_ATTR = "lc.exp.state";
+
+int RadosLifecycle::add_expirations(const DoutPrefixProvider* dpp,
+				    const std::string& oid,
+				    const std::vector<LCExpiration>& entries,
+				    optional_yield y)
+{
+  std::list<cls_timeindex_entry> cls_entries;
+
+  for (auto& entry : entries) {
+    /* the key extension is truncated when parsed back from the index, so
+     * keep the full object name in the value as well */
+    bufferlist bl;
+    ceph::encode(entry.key, bl);
+    cls_timeindex_entry cls_entry;
+    cls_timeindex_add_prepare_entry(cls_entry, utime_t(entry.due), entry.key, bl);
+    cls_entries.push_back(std::move(cls_entry));
+  }
+
+  librados::ObjectWriteOperation op;
+  cls_timeindex_add(op, cls_entries);
+  return rgw_rados_operate(dpp, *store->getRados()->get_lc_pool_ctx(), oid, &op, y);
+}
+
+int RadosLifecycle::list_expirations(const DoutPrefixProvider* dpp,
+				     const std::string& oid, ceph::real_time until,
+				     const std::string& marker, uint32_t max_entries,
+				     std::vector<LCExpiration>& entries,
+				     std::string* next_marker, bool* truncated,
+				     optional_yield y)
+{
+  entries.clear();
+
+  std::list<cls_timeindex_entry> cls_entries;
+  librados::ObjectReadOperation op;
+  cls_timeindex_list(op, utime_t(), utime_t(until), marker, max_entries,
+		     cls_entries, next_marker, truncated);
+
+  int ret = rgw_rados_operate(dpp, *store->getRados()->get_lc_pool_ctx(), oid,
+			      &op, nullptr, y);
+  if (ret < 0) {
+    return ret;
+  }
+
+  for (auto& entry : cls_entries) {
+    LCExpiration e;
+    e.due = entry.key_ts.to_real_time();
+    try {
+      auto iter = entry.value.cbegin();
+      ceph::decode(e.key, iter);
+    } catch (buffer::error& err) {
+      return -EIO;
+    }
+    entries.push_back(std::move(e));
+  }
+
+  return 0;
+}
+
+int RadosLifecycle::trim_expirations(const DoutPrefixProvider* dpp,
+				     const std::string& oid, ceph::real_time until,
+				     const std::string& to_marker, optional_yield y)
+{
+  /* each trim call removes a bounded number of keys */
+  for (;;) {
+    librados::ObjectWriteOperation op;
+    cls_timeindex_trim(op, utime_t(), utime_t(until), std::string(), to_marker);
+    int ret = rgw_rados_operate(dpp, *store->getRados()->get_lc_pool_ctx(), oid,
+				&op, y);
+    if (ret == -ENODATA) {
+      return 0;
+    }
+    if (ret < 0) {
+      return ret;
+    }
+  }
+}
+
+int RadosLifecycle::rm_expirations(const DoutPrefixProvider* dpp,
+				   const std::string& oid, optional_yield y)
+{
+  librados::ObjectWriteOperation op;
+  op.remove();
+  int ret = rgw_rados_operate(dpp, *store->getRados()->get_lc_pool_ctx(), oid,
+			      &op, y);
+  if (ret == -ENOENT) {
+    ret = 0;
+  }
+  return ret;
+}
+
+int RadosLifecycle::get_expiration_state(const DoutPrefixProvider* dpp,
+					 const std::string& oid, std::string& state,
+					 optional_yield y)
+{
+  librados::ObjectReadOperation op;
+  bufferlist bl;
+  op.getxattr(RGW_LC_EXP_STATE_ATTR, &bl, nullptr);
+  int ret = rgw_rados_operate(dpp, *store->getRados()->get_lc_pool_ctx(), oid,
+			      &op, nullptr, y);
+  if (ret < 0) {
+    return ret;
+  }
+  state = bl.to_str();
+  return 0;
+}
+
+int RadosLifecycle::set_expiration_state(const DoutPrefixProvider* dpp,
+					 const std::string& oid, const std::string& state,
+					 optional_yield y, const std::string* expected)
+{
+  librados::ObjectWriteOperation op;
+  if (expected) {
+    bufferlist cmp_bl;
+    cmp_bl.append(*expected);
+    op.cmpxattr(RGW_LC_EXP_STATE_ATTR, CEPH_OSD_CMPXATTR_OP_EQ, cmp_bl);
+  }
+  bufferlist bl;
+  bl.append(state);
+  op.setxattr(RGW_LC_EXP_STATE_ATTR, bl);
+  return rgw_rados_operate(dpp, *store->getRados()->get_lc_pool_ctx(), oid, &op, y);
+}
+
+int RadosLifecycle::invalidate_expirations(const DoutPrefixProvider* dpp,
+					   const std::string& oid,
+					   optional_yield y)
+{
+  librados::ObjectWriteOperation op;
+  op.assert_exists();
+  op.setxattr(RGW_LC_EXP_STATE_ATTR, bufferlist());
+  int ret = rgw_rados_operate(dpp, *store->getRados()->get_lc_pool_ctx(), oid, &op, y);
+  if (ret == -ENOENT) {
+    /* no index to invalidate */
+    ret = 0;
+  }
+  return ret;
+}
+
 LCSerializer* RadosLifecycle::get_serializer(const std::string& lock_name, const std::string& oid, const std::string& cookie)
 {
   return new LCRadosSerializer(store, oid, lock_name, cookie);
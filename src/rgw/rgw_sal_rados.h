@@ -702,6 +702,25 @@ public:
   virtual int rm_entry(const std::string& oid, const LCEntry& entry) override;
   virtual int get_head(const std::string& oid, LCHead& head) override;
   virtual int put_head(const std::string& oid, const LCHead& head) override;
+  virtual int add_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			      const std::vector<LCExpiration>& entries, optional_yield y) override;
+  virtual int list_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			       ceph::real_time until, const std::string& marker,
+			       uint32_t max_entries, std::vector<LCExpiration>& entries,
+			       std::string* next_marker, bool* truncated,
+			       optional_yield y) override;
+  virtual int trim_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			       ceph::real_time until, const std::string& to_marker,
+			       optional_yield y) override;
+  virtual int rm_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+			     optional_yield y) override;
+  virtual int get_expiration_state(const DoutPrefixProvider* dpp, const std::string& oid,
+				   std::string& state, optional_yield y) override;
+  virtual int set_expiration_state(const DoutPrefixProvider* dpp, const std::string& oid,
+				   const std::string& state, optional_yield y,
+				   const std::string* expected = nullptr) override;
+  virtual int invalidate_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+				     optional_yield y) override;
   virtual LCSerializer* get_serializer(const std::string& lock_name, const std::string& oid, const std::string& cookie) override;
 };
 
@@ -152,6 +152,131 @@ using namespace std;
     }					\
   }while(0);
 
+/* wrap a write op's SQL_EXECUTE in the database's write batch */
+#define SQL_WRITE_BATCH_BEGIN(dpp, sdb)				\
+  SQLiteWriteBatch *batch = SQLiteWriteBatch::get(*sdb);	\
+  SQLiteWriteBatch::TxnRef txn;					\
+  if (batch) {							\
+    txn = batch->begin(dpp);					\
+  }
+
+#define SQL_WRITE_BATCH_END(dpp, ret)				\
+  do {								\
+    if (batch) {						\
+      ret = batch->end(dpp, txn, ret);				\
+    }								\
+  } while(0);
+
+/* keep a write op that isn't batched out of the open write batch */
+#define SQL_UNBATCHED_WRITE(sdb)				\
+  SQLiteWriteBatch::Unbatched unbatched(SQLiteWriteBatch::get(*sdb));
+
+static std::mutex write_batches_lock;
+static std::map<sqlite3*, std::unique_ptr<SQLiteWriteBatch>> write_batches;
+
+SQLiteWriteBatch* SQLiteWriteBatch::get(sqlite3 *db)
+{
+  std::lock_guard l{write_batches_lock};
+  auto i = write_batches.find(db);
+  if (i == write_batches.end()) {
+    return nullptr;
+  }
+  return i->second.get();
+}
+
+void SQLiteWriteBatch::add(sqlite3 *db, uint64_t max_writes)
+{
+  std::lock_guard l{write_batches_lock};
+  write_batches[db] = std::make_unique<SQLiteWriteBatch>(db, max_writes);
+}
+
+void SQLiteWriteBatch::remove(sqlite3 *db)
+{
+  std::lock_guard l{write_batches_lock};
+  write_batches.erase(db);
+}
+
+SQLiteWriteBatch::Unbatched::Unbatched(SQLiteWriteBatch *_batch)
+{
+  if (!_batch ||
+      _batch->unbatched_owner.load() == std::this_thread::get_id()) {
+    /* no batching, or nested in a guard this thread already holds */
+    return;
+  }
+  batch = _batch;
+  l = std::unique_lock{batch->mtx};
+  batch->cond.wait(l, [this] { return !batch->current; });
+  batch->unbatched_owner = std::this_thread::get_id();
+}
+
+SQLiteWriteBatch::Unbatched::~Unbatched()
+{
+  if (batch) {
+    batch->unbatched_owner = std::thread::id();
+  }
+}
+
+int SQLiteWriteBatch::exec(const DoutPrefixProvider *dpp, const char *sql)
+{
+  char *errmsg = NULL;
+
+  int ret = sqlite3_exec(db, sql, NULL, 0, &errmsg);
+  if (ret != SQLITE_OK) {
+    ldpp_dout(dpp, 0) <<"sqlite exec failed for schema("<<sql \
+      <<"); Errmsg - "<<errmsg <<  dendl;
+    sqlite3_free(errmsg);
+    return -1;
+  }
+  return 0;
+}
+
+SQLiteWriteBatch::TxnRef SQLiteWriteBatch::begin(const DoutPrefixProvider *dpp)
+{
+  if (max_writes == 0) {
+    return nullptr;
+  }
+
+  std::unique_lock l{mtx};
+  /* a full transaction takes no more writers, wait for it to commit */
+  cond.wait(l, [this] { return !current || current->joined < max_writes; });
+
+  if (!current) {
+    if (exec(dpp, "BEGIN") < 0) {
+      return nullptr;
+    }
+    current = std::make_shared<Txn>();
+  }
+  ++current->writers;
+  ++current->joined;
+  return current;
+}
+
+int SQLiteWriteBatch::end(const DoutPrefixProvider *dpp, TxnRef& txn, int ret)
+{
+  if (!txn) {
+    return ret;
+  }
+
+  std::unique_lock l{mtx};
+  if (--txn->writers == 0) {
+    txn->result = exec(dpp, "COMMIT");
+    if (txn->result < 0) {
+      exec(dpp, "ROLLBACK");
+    }
+    ldpp_dout(dpp, 20) << "committed " << txn->joined << " batched writes"
+      << " ret = " << txn->result << dendl;
+    txn->done = true;
+    if (current == txn) {
+      current.reset();
+    }
+    cond.notify_all();
+  } else {
+    cond.wait(l, [&txn] { return txn->done; });
+  }
+
+  return ret ? ret : txn->result;
+}
+
 int SQLiteDB::InitPrepareParams(const DoutPrefixProvider *dpp,
                                 DBOpPrepareParams &p_params,
                                 DBOpParams* params)
@@ -657,14 +782,28 @@ void *SQLiteDB::openDB(const DoutPrefixProvider *dpp)
 
   exec(dpp, "PRAGMA foreign_keys=ON", NULL);
 
+  if (db) {
+    string pragma = "PRAGMA journal_mode=" +
+      cct->_conf.get_val<std::string>("dbstore_sqlite_journal_mode");
+    exec(dpp, pragma.c_str(), NULL);
+    pragma = "PRAGMA synchronous=" +
+      cct->_conf.get_val<std::string>("dbstore_sqlite_synchronous");
+    exec(dpp, pragma.c_str(), NULL);
+
+    SQLiteWriteBatch::add((sqlite3 *)db,
+        cct->_conf.get_val<uint64_t>("dbstore_sqlite_max_batch_writes"));
+  }
+
 out:
   return db;
 }
 
 int SQLiteDB::closeDB(const DoutPrefixProvider *dpp)
 {
-  if (db)
+  if (db) {
+    SQLiteWriteBatch::remove((sqlite3 *)db);
     sqlite3_close((sqlite3 *)db);
+  }
 
   db = NULL;
 
@@ -719,6 +858,7 @@ int SQLiteDB::exec(const DoutPrefixProvider *dpp, const char *schema,
 {
   int ret = -1;
   char *errmsg = NULL;
+  SQLiteWriteBatch::Unbatched unbatched(SQLiteWriteBatch::get((sqlite3 *)db));
 
   if (!db)
     goto out;
@@ -1215,6 +1355,7 @@ out:
 int SQLInsertUser::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
@@ -1254,6 +1395,7 @@ out:
 int SQLRemoveUser::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
@@ -1457,6 +1599,7 @@ out:
 int SQLInsertBucket::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
   class SQLObjectOp *ObPtr = NULL;
   string bucket_name = params->op.bucket.info.bucket.name;
   struct DBOpPrepareParams p_params = PrepareParams;
@@ -1612,6 +1755,7 @@ out:
 int SQLUpdateBucket::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
   sqlite3_stmt** stmt = NULL; // Prepared statement
 
   if (params->op.query_str == "attrs") { 
@@ -1666,6 +1810,7 @@ out:
 int SQLRemoveBucket::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
 
   objectmapDelete(dpp, params->op.bucket.info.bucket.name);
 
@@ -1960,9 +2105,11 @@ out:
 int SQLPutObject::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_WRITE_BATCH_BEGIN(dpp, sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
+  SQL_WRITE_BATCH_END(dpp, ret);
   return ret;
 }
 
@@ -2004,9 +2151,11 @@ out:
 int SQLDeleteObject::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_WRITE_BATCH_BEGIN(dpp, sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
+  SQL_WRITE_BATCH_END(dpp, ret);
   return ret;
 }
 
@@ -2275,6 +2424,7 @@ int SQLUpdateObject::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *p
 {
   int ret = -1;
   sqlite3_stmt** stmt = NULL; // Prepared statement
+  SQL_WRITE_BATCH_BEGIN(dpp, sdb);
 
   if (params->op.query_str == "omap") { 
     stmt = &omap_stmt;
@@ -2292,6 +2442,7 @@ int SQLUpdateObject::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *p
 
   SQL_EXECUTE(dpp, params, *stmt, NULL);
 out:
+  SQL_WRITE_BATCH_END(dpp, ret);
   return ret;
 }
 
@@ -2416,9 +2567,11 @@ out:
 int SQLPutObjectData::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_WRITE_BATCH_BEGIN(dpp, sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
+  SQL_WRITE_BATCH_END(dpp, ret);
   return ret;
 }
 
@@ -2467,9 +2620,11 @@ out:
 int SQLUpdateObjectData::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_WRITE_BATCH_BEGIN(dpp, sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
+  SQL_WRITE_BATCH_END(dpp, ret);
   return ret;
 }
 
@@ -2563,9 +2718,11 @@ out:
 int SQLDeleteObjectData::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_WRITE_BATCH_BEGIN(dpp, sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
+  SQL_WRITE_BATCH_END(dpp, ret);
   return ret;
 }
 
@@ -2602,9 +2759,11 @@ out:
 int SQLDeleteStaleObjectData::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_WRITE_BATCH_BEGIN(dpp, sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
+  SQL_WRITE_BATCH_END(dpp, ret);
   return ret;
 }
 
@@ -2651,6 +2810,7 @@ out:
 int SQLInsertLCEntry::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
@@ -2694,6 +2854,7 @@ out:
 int SQLRemoveLCEntry::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
@@ -2848,6 +3009,7 @@ out:
 int SQLInsertLCHead::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
@@ -2888,6 +3050,7 @@ out:
 int SQLRemoveLCHead::Execute(const DoutPrefixProvider *dpp, struct DBOpParams *params)
 {
   int ret = -1;
+  SQL_UNBATCHED_WRITE(sdb);
 
   SQL_EXECUTE(dpp, params, stmt, NULL);
 out:
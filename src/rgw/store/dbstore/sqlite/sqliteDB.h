@@ -7,11 +7,67 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string>
+#include <atomic>
+#include <thread>
 #include <sqlite3.h>
 #include "rgw/store/dbstore/common/dbstore.h"
 
 using namespace rgw::store;
 
+/* All ops of a database share its sqlite connection, and with it the
+ * connection's transaction. Concurrent object writes join the open
+ * transaction instead of each committing their own, and the last writer
+ * to finish commits it for the whole group. Every other write holds an
+ * Unbatched guard, so that it never runs inside that transaction. */
+class SQLiteWriteBatch {
+  public:
+    struct Txn {
+      uint64_t writers = 0; // writers that haven't finished yet
+      uint64_t joined = 0;  // writers that joined this transaction
+      bool done = false;
+      int result = 0;
+    };
+    using TxnRef = std::shared_ptr<Txn>;
+
+  private:
+    sqlite3 *db;
+    const uint64_t max_writes;
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    TxnRef current;
+    // thread holding an Unbatched guard, so that it can nest
+    std::atomic<std::thread::id> unbatched_owner;
+
+    int exec(const DoutPrefixProvider *dpp, const char *sql);
+
+  public:
+    /* waits for the open transaction to commit, and keeps new ones from
+     * being opened while the guarded write runs, so that the write isn't
+     * committed or rolled back along with the batched writes */
+    class Unbatched {
+      SQLiteWriteBatch *batch = nullptr;
+      std::unique_lock<std::mutex> l;
+    public:
+      explicit Unbatched(SQLiteWriteBatch *batch);
+      ~Unbatched();
+    };
+
+    SQLiteWriteBatch(sqlite3 *db, uint64_t max_writes)
+      : db(db), max_writes(max_writes) {}
+
+    /* join the open transaction, or open one. returns nullptr if the write
+     * should run on its own */
+    TxnRef begin(const DoutPrefixProvider *dpp);
+    /* leave the transaction, committing it if this was its last writer, and
+     * wait for the commit. returns the write's result or the commit's */
+    int end(const DoutPrefixProvider *dpp, TxnRef& txn, int ret);
+
+    static SQLiteWriteBatch* get(sqlite3 *db);
+    static void add(sqlite3 *db, uint64_t max_writes);
+    static void remove(sqlite3 *db);
+};
+
 class SQLiteDB : public DB, virtual public DBOp {
   private:
     sqlite3_mutex *mutex = NULL;
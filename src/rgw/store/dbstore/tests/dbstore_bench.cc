@@ -0,0 +1,106 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Measures small object PUT throughput of the sqlite dbstore backend.
+ *
+ * format: ./bin/dbstore_bench [threads] [objects per thread] [object size]
+ *
+ * sqlite settings are taken from the dbstore_sqlite_* options, e.g.
+ *   CEPH_ARGS="--dbstore_sqlite_max_batch_writes=0" ./bin/dbstore_bench 8
+ */
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <dbstore.h>
+#include <sqliteDB.h>
+#include "common/ceph_time.h"
+#include "rgw_common.h"
+
+using namespace std;
+using DB = rgw::store::DB;
+
+int main(int argc, char **argv)
+{
+  int num_threads = 4;
+  int num_objects = 1000;
+  int obj_size = 4096;
+
+  if (argc > 1)
+    num_threads = atoi(argv[1]);
+  if (argc > 2)
+    num_objects = atoi(argv[2]);
+  if (argc > 3)
+    obj_size = atoi(argv[3]);
+
+  vector<const char*> args;
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+      CODE_ENVIRONMENT_UTILITY,
+      CINIT_FLAG_NO_DEFAULT_CONFIG_FILE | CINIT_FLAG_NO_MON_CONFIG | CINIT_FLAG_NO_DAEMON_ACTIONS);
+
+  DB *db = new SQLiteDB("bench_ns", cct.get());
+  int ret = db->Initialize("rgw_dbstore_bench.log", 1);
+  if (ret < 0) {
+    cerr << "failed to initialize db, ret=" << ret << std::endl;
+    return 1;
+  }
+  const DoutPrefixProvider *dpp = db->get_def_dpp();
+
+  DBOpParams params = {};
+  params.op.user.uinfo.user_id.id = "bench_user";
+  params.op.bucket.info.bucket.name = "bench_bucket";
+  params.op.bucket.info.bucket.tenant = "bench_ns";
+  params.op.bucket.info.bucket.marker = "bench_marker";
+  params.op.bucket.info.has_instance_obj = false;
+  params.op.bucket.mtime = real_clock::now();
+  params.op.obj.state.obj.bucket = params.op.bucket.info.bucket;
+  db->InitializeParams(dpp, &params);
+
+  ret = db->ProcessOp(dpp, "InsertBucket", &params);
+  if (ret < 0) {
+    cerr << "failed to create bucket, ret=" << ret << std::endl;
+    return 1;
+  }
+
+  bufferlist data;
+  data.append(string(obj_size, 'a'));
+
+  std::atomic<int> failed = 0;
+  auto writer = [&] (int thread_id) {
+    for (int i = 0; i < num_objects; i++) {
+      DBOpParams p = params;
+      p.op.obj.state.obj.key.name = "obj-" + to_string(thread_id) + "-" + to_string(i);
+      p.op.obj.state.obj.key.instance = "inst";
+      p.op.obj.obj_id = p.op.obj.state.obj.key.name;
+      p.op.obj.category = RGWObjCategory::Main;
+      p.op.obj.storage_class = "STANDARD";
+      p.op.obj.head_data = data;
+      p.op.obj.state.size = data.length();
+      if (db->ProcessOp(dpp, "PutObject", &p) < 0) {
+        ++failed;
+      }
+    }
+  };
+
+  const auto start = ceph::mono_clock::now();
+  vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back(writer, t);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  const auto elapsed = ceph::to_seconds<double>(ceph::mono_clock::now() - start);
+
+  const int total = num_threads * num_objects;
+  cout << "threads=" << num_threads << " objects=" << total
+       << " size=" << obj_size << " failed=" << failed
+       << " elapsed=" << elapsed << "s"
+       << " puts/s=" << (elapsed > 0 ? total / elapsed : 0) << std::endl;
+
+  db->Destroy(dpp);
+  delete db;
+
+  return failed ? 1 : 0;
+}
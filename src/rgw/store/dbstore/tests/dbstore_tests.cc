@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <atomic>
+#include <thread>
 #include <dbstore.h>
 #include <sqliteDB.h>
 #include "rgw_common.h"
@@ -1194,6 +1196,63 @@ TEST_F(DBStoreTest, InsertTestIDUser) {
   ASSERT_EQ(ret, 0);
 }
 
+static int count_rows(sqlite3 *sdb, const char *table)
+{
+  string sql = string("SELECT COUNT(*) FROM ") + table;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(sdb, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    return -1;
+  }
+  int count = -1;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    count = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return count;
+}
+
+TEST_F(DBStoreTest, UnbatchedWriteOutlivesFailedCommit) {
+  sqlite3 *sdb = nullptr;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open_v2(":memory:", &sdb,
+	SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX,
+	nullptr));
+  /* a deferred foreign key violation only fails at COMMIT */
+  ASSERT_EQ(SQLITE_OK, sqlite3_exec(sdb,
+	"PRAGMA foreign_keys=ON;"
+	"CREATE TABLE parent(id INTEGER PRIMARY KEY);"
+	"CREATE TABLE child(pid INTEGER REFERENCES parent(id)"
+	"  DEFERRABLE INITIALLY DEFERRED);"
+	"CREATE TABLE other(id INTEGER);", nullptr, nullptr, nullptr));
+
+  SQLiteWriteBatch batch(sdb, 64);
+  auto txn = batch.begin(dpp);
+  ASSERT_TRUE(txn);
+  ASSERT_EQ(SQLITE_OK, sqlite3_exec(sdb, "INSERT INTO child VALUES(1)",
+				    nullptr, nullptr, nullptr));
+
+  /* a write that isn't batched, issued while the batch is open */
+  std::atomic<bool> unbatched_done = false;
+  std::thread writer([&] {
+    SQLiteWriteBatch::Unbatched unbatched(&batch);
+    EXPECT_EQ(SQLITE_OK, sqlite3_exec(sdb, "INSERT INTO other VALUES(1)",
+				      nullptr, nullptr, nullptr));
+    unbatched_done = true;
+  });
+
+  /* it must not run inside the batch's transaction */
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(unbatched_done);
+
+  EXPECT_LT(batch.end(dpp, txn, 0), 0);
+  writer.join();
+
+  /* the batched write was rolled back, the unbatched one was not */
+  EXPECT_EQ(0, count_rows(sdb, "child"));
+  EXPECT_EQ(1, count_rows(sdb, "other"));
+
+  sqlite3_close(sdb);
+}
+
 int main(int argc, char **argv)
 {
   int ret = -1;
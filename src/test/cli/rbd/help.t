@@ -172,25 +172,29 @@
   usage: rbd bench [--pool <pool>] [--namespace <namespace>] [--image <image>] 
                    [--io-size <io-size>] [--io-threads <io-threads>] 
                    [--io-total <io-total>] [--io-pattern <io-pattern>] 
-                   [--rw-mix-read <rw-mix-read>] --io-type <io-type> 
+                   [--rw-mix-read <rw-mix-read>] 
+                   [--encryption-format <encryption-format>] 
+                   [--passphrase-file <passphrase-file>] --io-type <io-type> 
                    <image-spec> 
   
   Simple benchmark.
   
   Positional arguments
-    <image-spec>         image specification
-                         (example: [<pool-name>/[<namespace>/]]<image-name>)
+    <image-spec>            image specification
+                            (example: [<pool-name>/[<namespace>/]]<image-name>)
   
   Optional arguments
-    -p [ --pool ] arg    pool name
-    --namespace arg      namespace name
-    --image arg          image name
-    --io-size arg        IO size (in B/K/M/G) (< 4G) [default: 4K]
-    --io-threads arg     ios in flight [default: 16]
-    --io-total arg       total size for IO (in B/K/M/G/T) [default: 1G]
-    --io-pattern arg     IO pattern (rand, seq, or full-seq) [default: seq]
-    --rw-mix-read arg    read proportion in readwrite (<= 100) [default: 50]
-    --io-type arg        IO type (read, write, or readwrite(rw))
+    -p [ --pool ] arg       pool name
+    --namespace arg         namespace name
+    --image arg             image name
+    --io-size arg           IO size (in B/K/M/G) (< 4G) [default: 4K]
+    --io-threads arg        ios in flight [default: 16]
+    --io-total arg          total size for IO (in B/K/M/G/T) [default: 1G]
+    --io-pattern arg        IO pattern (rand, seq, or full-seq) [default: seq]
+    --rw-mix-read arg       read proportion in readwrite (<= 100) [default: 50]
+    --encryption-format arg image encryption format to load (luks1 or luks2)
+    --passphrase-file arg   path of file containing the image passphrase
+    --io-type arg           IO type (read, write, or readwrite(rw))
   
   rbd help children
   usage: rbd children [--pool <pool>] [--namespace <namespace>] 
@@ -102,6 +102,19 @@ void index_complete(librados::IoCtx& ioctx, string& oid, RGWModifyOp index_op,
   }
 }
 
+static int bilog_list(librados::IoCtx& ioctx, const std::string& oid,
+                      cls_rgw_bi_log_list_ret *result)
+{
+  int retcode = 0;
+  librados::ObjectReadOperation op;
+  cls_rgw_bilog_list(op, "", 128, result, &retcode);
+  int ret = ioctx.operate(oid, &op, nullptr);
+  if (ret < 0) {
+    return ret;
+  }
+  return retcode;
+}
+
 TEST_F(cls_rgw, index_basic)
 {
   string bucket_oid = str_int("bucket", 0);
@@ -170,6 +183,129 @@ TEST_F(cls_rgw, index_multiple_obj_writers)
   }
 }
 
+TEST_F(cls_rgw, index_complete_op_batch)
+{
+  string bucket_oid = str_int("bucket", 8);
+
+  ObjectWriteOperation op;
+  cls_rgw_bucket_init_index(op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, &op));
+
+  uint64_t obj_size = 1024;
+
+  vector<rgw_cls_obj_complete_op> ops;
+  for (int i = 0; i < NUM_OBJS; i++) {
+    cls_rgw_obj_key obj = str_int("obj", i);
+    string tag = str_int("tag", i);
+    string loc = str_int("loc", i);
+
+    index_prepare(ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+
+    rgw_cls_obj_complete_op& c = ops.emplace_back();
+    c.op = CLS_RGW_OP_ADD;
+    c.key = obj;
+    c.tag = tag;
+    c.ver.pool = ioctx.get_id();
+    c.ver.epoch = 1;
+    c.meta.category = RGWObjCategory::None;
+    c.meta.size = obj_size;
+    c.meta.accounted_size = obj_size;
+    c.log_op = true;
+  }
+
+  // a completion whose pending tag is unknown is skipped without
+  // failing the others
+  rgw_cls_obj_complete_op& bad = ops.emplace_back(ops.front());
+  bad.key = str_int("obj", NUM_OBJS);
+  bad.tag = "unknown-tag";
+
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 0, 0);
+
+  ObjectWriteOperation batch_op;
+  cls_rgw_bucket_complete_op_batch(batch_op, ops);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, &batch_op));
+
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, NUM_OBJS,
+	     obj_size * NUM_OBJS);
+
+  map<int, string> oids = { {0, bucket_oid} };
+  map<int, struct rgw_cls_list_ret> list_results;
+  cls_rgw_obj_key start_key("", "");
+  string empty_prefix;
+  string empty_delimiter;
+  ASSERT_EQ(0, CLSRGWIssueBucketList(ioctx, start_key, empty_prefix,
+				     empty_delimiter, 1000, true, oids,
+				     list_results, 1)());
+  ASSERT_EQ(1u, list_results.size());
+  auto& entries = list_results.begin()->second.dir.m;
+  ASSERT_EQ(unsigned(NUM_OBJS), entries.size());
+  for (const auto& [name, entry] : entries) {
+    ASSERT_TRUE(entry.exists);
+    ASSERT_TRUE(entry.pending_map.empty());
+  }
+
+  // every completion of the batch gets its own bilog entry
+  cls_rgw_bi_log_list_ret bilog;
+  ASSERT_EQ(0, bilog_list(ioctx, bucket_oid, &bilog));
+  std::set<std::string> completed;
+  for (const auto& entry : bilog.entries) {
+    if (entry.state == CLS_RGW_STATE_COMPLETE) {
+      ASSERT_EQ(CLS_RGW_OP_ADD, entry.op);
+      ASSERT_TRUE(completed.insert(entry.object).second);
+    }
+  }
+  ASSERT_EQ(size_t(NUM_OBJS), completed.size());
+
+  // two completions of the same key can't share a batch, since the
+  // second would read the entry as it was before the first
+  cls_rgw_obj_key dup_obj = str_int("dup", 0);
+  string dup_loc = str_int("duploc", 0);
+  vector<rgw_cls_obj_complete_op> dup_ops;
+  for (int i = 0; i < 2; i++) {
+    string tag = str_int("duptag", i);
+    index_prepare(ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, dup_obj, dup_loc);
+
+    rgw_cls_obj_complete_op& c = dup_ops.emplace_back(ops.front());
+    c.key = dup_obj;
+    c.tag = tag;
+    c.ver.epoch = 2 + i;
+  }
+
+  ObjectWriteOperation dup_batch_op;
+  cls_rgw_bucket_complete_op_batch(dup_batch_op, dup_ops);
+  ASSERT_EQ(-EINVAL, ioctx.operate(bucket_oid, &dup_batch_op));
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, NUM_OBJS,
+	     obj_size * NUM_OBJS);
+
+  // the same key may also not be removed by another op of the batch
+  rgw_cls_obj_complete_op remover = ops.front();
+  remover.key = str_int("obj", NUM_OBJS + 1);
+  remover.remove_objs.push_back(dup_obj);
+  ObjectWriteOperation remove_batch_op;
+  cls_rgw_bucket_complete_op_batch(remove_batch_op, {dup_ops[0], remover});
+  ASSERT_EQ(-EINVAL, ioctx.operate(bucket_oid, &remove_batch_op));
+
+  // sent in separate batches, the key is only accounted once and both
+  // pending tags are consumed
+  for (auto& c : dup_ops) {
+    ObjectWriteOperation single_op;
+    cls_rgw_bucket_complete_op_batch(single_op, {c});
+    ASSERT_EQ(0, ioctx.operate(bucket_oid, &single_op));
+  }
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, NUM_OBJS + 1,
+	     obj_size * (NUM_OBJS + 1));
+
+  list_results.clear();
+  ASSERT_EQ(0, CLSRGWIssueBucketList(ioctx, start_key, empty_prefix,
+				     empty_delimiter, 1000, true, oids,
+				     list_results, 1)());
+  auto& dup_entries = list_results.begin()->second.dir.m;
+  auto dup = dup_entries.find(dup_obj.name);
+  ASSERT_NE(dup, dup_entries.end());
+  ASSERT_TRUE(dup->second.exists);
+  ASSERT_TRUE(dup->second.pending_map.empty());
+}
+
 TEST_F(cls_rgw, index_remove_object)
 {
   string bucket_oid = str_int("bucket", 2);
@@ -583,18 +719,19 @@ TEST_F(cls_rgw, index_list_delimited)
   auto id_entry_map = it->second.dir.m;
   bool truncated = it->second.is_truncated;
 
-  // the cls code will make 4 tries to get 1000 entries; however
-  // because each of the subdirectories is so large, each attempt will
-  // only retrieve the first part of the subdirectory
+  // each of the subdirectories is large enough to fill the first
+  // omap read, but the cls code seeks past a subdirectory once it has
+  // emitted its common prefix and shrinks its following reads, so
+  // reads that produce entries don't use up its attempts
 
-  ASSERT_EQ(48u, id_entry_map.size()) <<
-    "We should get 40 top-level entries and the tops of 8 \"subdirectories\".";
-  ASSERT_EQ(true, truncated) << "We did not get all entries.";
+  ASSERT_EQ(65u, id_entry_map.size()) <<
+    "We should get 55 top-level entries and the tops of 10 \"subdirectories\".";
+  ASSERT_EQ(false, truncated) << "We should have all entries.";
 
   ASSERT_EQ("a-0", id_entry_map.cbegin()->first);
-  ASSERT_EQ("p/", id_entry_map.crbegin()->first);
+  ASSERT_EQ("u-4", id_entry_map.crbegin()->first);
 
-  // now let's get the rest of the entries
+  // now let's start listing after one of the subdirectories
 
   list_results.clear();
   
@@ -1138,19 +1275,6 @@ TEST_F(cls_rgw, usage_clear)
   ASSERT_EQ(0u, usage.size());
 }
 
-static int bilog_list(librados::IoCtx& ioctx, const std::string& oid,
-                      cls_rgw_bi_log_list_ret *result)
-{
-  int retcode = 0;
-  librados::ObjectReadOperation op;
-  cls_rgw_bilog_list(op, "", 128, result, &retcode);
-  int ret = ioctx.operate(oid, &op, nullptr);
-  if (ret < 0) {
-    return ret;
-  }
-  return retcode;
-}
-
 static int bilog_trim(librados::IoCtx& ioctx, const std::string& oid,
                       const std::string& start_marker,
                       const std::string& end_marker)
@@ -1252,3 +1376,115 @@ TEST_F(cls_rgw, bi_log_trim)
     EXPECT_FALSE(truncated);
   }
 }
+
+TEST_F(cls_rgw, reshard_log_record)
+{
+  string bucket_oid = __PRETTY_FUNCTION__;
+
+  ObjectWriteOperation op;
+  cls_rgw_bucket_init_index(op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, &op));
+
+  cls_rgw_bucket_instance_entry entry;
+  entry.set_status(cls_rgw_reshard_status::IN_LOGRECORD);
+  ASSERT_EQ(0, cls_rgw_set_bucket_resharding(ioctx, bucket_oid, entry));
+
+  // writes are not blocked while the shard records its reshard log
+  {
+    ObjectWriteOperation op;
+    cls_rgw_guard_bucket_resharding(op, -EBUSY);
+    op.create(false);
+    ASSERT_EQ(0, ioctx.operate(bucket_oid, &op));
+  }
+
+  const cls_rgw_obj_key obj{"obj"};
+  string tag = "tag";
+  string loc = "loc";
+  index_prepare(ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+  rgw_bucket_dir_entry_meta meta;
+  meta.category = RGWObjCategory::None;
+  meta.size = 1024;
+  index_complete(ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, 1, obj, meta);
+
+  const string prefix = string(1, char(0x80)) + RGW_BI_RESHARD_LOG_PREFIX;
+  map<string, bufferlist> vals;
+  bool more = false;
+  ASSERT_EQ(0, ioctx.omap_get_vals2(bucket_oid, prefix, prefix, 100,
+                                    &vals, &more));
+  // one record each for the prepare and the complete
+  ASSERT_EQ(2u, vals.size());
+  for (auto& [key, bl] : vals) {
+    cls_rgw_obj_key logged;
+    auto p = bl.cbegin();
+    decode(logged, p);
+    EXPECT_EQ(obj, logged);
+  }
+
+  // bi list doesn't return the log records
+  {
+    list<rgw_cls_bi_entry> entries;
+    bool truncated{false};
+    ASSERT_EQ(0, cls_rgw_bi_list(ioctx, bucket_oid, "", "", 128,
+                                 &entries, &truncated));
+    EXPECT_EQ(1u, entries.size());
+  }
+
+  // writes are blocked once the reshard is in progress
+  entry.set_status(cls_rgw_reshard_status::IN_PROGRESS);
+  ASSERT_EQ(0, cls_rgw_set_bucket_resharding(ioctx, bucket_oid, entry));
+  {
+    ObjectWriteOperation op;
+    cls_rgw_guard_bucket_resharding(op, -EBUSY);
+    op.create(false);
+    ASSERT_EQ(-EBUSY, ioctx.operate(bucket_oid, &op));
+  }
+}
+
+TEST_F(cls_rgw, reshard_log_record_cancel)
+{
+  string bucket_oid = __PRETTY_FUNCTION__;
+
+  ObjectWriteOperation op;
+  cls_rgw_bucket_init_index(op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, &op));
+
+  const string prefix = string(1, char(0x80)) + RGW_BI_RESHARD_LOG_PREFIX;
+  auto count_records = [&] {
+    map<string, bufferlist> vals;
+    bool more = false;
+    EXPECT_EQ(0, ioctx.omap_get_vals2(bucket_oid, prefix, prefix, 100,
+                                      &vals, &more));
+    return vals.size();
+  };
+  int i = 0;
+  auto prepare = [&] {
+    cls_rgw_obj_key obj = str_int("obj", i);
+    string tag = str_int("tag", i);
+    string loc = str_int("loc", i);
+    ++i;
+    index_prepare(ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+  };
+
+  cls_rgw_bucket_instance_entry entry;
+  entry.set_status(cls_rgw_reshard_status::IN_LOGRECORD);
+  ASSERT_EQ(0, cls_rgw_set_bucket_resharding(ioctx, bucket_oid, entry));
+  prepare();
+  ASSERT_EQ(1u, count_records());
+
+  // a shard left IN_LOGRECORD by a resharder that died keeps recording
+  // writes until 'radosgw-admin reshard cancel', or a retried reshard,
+  // resets its status; the resharder then removes the leftover records
+  entry.set_status(cls_rgw_reshard_status::NOT_RESHARDING);
+  ASSERT_EQ(0, cls_rgw_set_bucket_resharding(ioctx, bucket_oid, entry));
+  prepare();
+  ASSERT_EQ(1u, count_records());
+
+  // clearing the reshard status stops the recording as well
+  entry.set_status(cls_rgw_reshard_status::IN_LOGRECORD);
+  ASSERT_EQ(0, cls_rgw_set_bucket_resharding(ioctx, bucket_oid, entry));
+  prepare();
+  ASSERT_EQ(2u, count_records());
+  ASSERT_EQ(0, cls_rgw_clear_bucket_resharding(ioctx, bucket_oid));
+  prepare();
+  ASSERT_EQ(2u, count_records());
+}
@@ -333,6 +333,64 @@ TEST_F(TestWriteLogMap, OverlapSplit) {
   ASSERT_EQ(8, found0.front().block_extent.block_end);
 }
 
+TEST_F(TestWriteLogMap, StripeBoundary) {
+  TestLogMap map(m_cct);
+
+  /* Spans the boundary between the first two stripe units */
+  const uint64_t boundary = LOG_MAP_STRIPE_UNIT;
+  auto e0 = make_shared<TestLogEntry>(boundary - 4, 8);
+  map.add_log_entry(e0);
+
+  /* Stored as one map entry on each side of the boundary */
+  TestLogMapEntries found0 = map.find_map_entries(
+    BlockExtent(0, 2 * boundary));
+  ASSERT_EQ(2, found0.size());
+  ASSERT_EQ(2, e0->get_map_ref());
+  ASSERT_EQ(e0, found0.front().log_entry);
+  ASSERT_EQ(boundary - 4, found0.front().block_extent.block_start);
+  ASSERT_EQ(boundary, found0.front().block_extent.block_end);
+  found0.pop_front();
+  ASSERT_EQ(e0, found0.front().log_entry);
+  ASSERT_EQ(boundary, found0.front().block_extent.block_start);
+  ASSERT_EQ(boundary + 4, found0.front().block_extent.block_end);
+
+  /* Same stripe as the first unit, must not be confused with it */
+  const uint64_t wrapped = LOG_MAP_STRIPES * LOG_MAP_STRIPE_UNIT;
+  auto e1 = make_shared<TestLogEntry>(wrapped, 8);
+  map.add_log_entry(e1);
+  found0 = map.find_map_entries(BlockExtent(0, boundary));
+  ASSERT_EQ(1, found0.size());
+  ASSERT_EQ(e0, found0.front().log_entry);
+  found0 = map.find_map_entries(BlockExtent(wrapped, wrapped + boundary));
+  ASSERT_EQ(1, found0.size());
+  ASSERT_EQ(e1, found0.front().log_entry);
+
+  /* Overwrite the right half of e0 across the boundary */
+  auto e2 = make_shared<TestLogEntry>(boundary - 2, 4);
+  map.add_log_entry(e2);
+
+  /* Expecting: e0, e2, e2, e0 */
+  found0 = map.find_map_entries(BlockExtent(0, 2 * boundary));
+  ASSERT_EQ(4, found0.size());
+  ASSERT_EQ(e0, found0.front().log_entry);
+  ASSERT_EQ(boundary - 2, found0.front().block_extent.block_end);
+  found0.pop_front();
+  ASSERT_EQ(e2, found0.front().log_entry);
+  found0.pop_front();
+  ASSERT_EQ(e2, found0.front().log_entry);
+  found0.pop_front();
+  ASSERT_EQ(e0, found0.front().log_entry);
+  ASSERT_EQ(boundary + 2, found0.front().block_extent.block_start);
+
+  map.remove_log_entry(e0);
+  map.remove_log_entry(e1);
+  map.remove_log_entry(e2);
+  ASSERT_EQ(0, e0->get_map_ref());
+  ASSERT_EQ(0, e2->get_map_ref());
+  found0 = map.find_map_entries(BlockExtent(0, wrapped + boundary));
+  ASSERT_EQ(0, found0.size());
+}
+
 } // namespace pwl
 } // namespace cache
 } // namespace librbd
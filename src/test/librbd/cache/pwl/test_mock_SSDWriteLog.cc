@@ -25,6 +25,45 @@ struct MockContextSSD : public C_SaferCond  {
   }
 };
 
+// records the writes sent back to the image, and completes every request
+struct RecordingImageWriteback : public cache::ImageWritebackInterface {
+  ceph::mutex lock = ceph::make_mutex("RecordingImageWriteback::lock");
+  std::vector<std::pair<Extents, bufferlist>> writes;
+
+  void aio_read(Extents &&image_extents, ceph::bufferlist *bl,
+                int fadvise_flags, Context *on_finish) override {
+    on_finish->complete(0);
+  }
+  void aio_write(Extents &&image_extents, ceph::bufferlist&& bl,
+                 int fadvise_flags, Context *on_finish) override {
+    {
+      std::lock_guard locker{lock};
+      writes.emplace_back(std::move(image_extents), std::move(bl));
+    }
+    on_finish->complete(0);
+  }
+  void aio_discard(uint64_t offset, uint64_t length,
+                   uint32_t discard_granularity_bytes,
+                   Context *on_finish) override {
+    on_finish->complete(0);
+  }
+  void aio_flush(io::FlushSource flush_source, Context *on_finish) override {
+    on_finish->complete(0);
+  }
+  void aio_writesame(uint64_t offset, uint64_t length,
+                     ceph::bufferlist&& bl,
+                     int fadvise_flags, Context *on_finish) override {
+    on_finish->complete(0);
+  }
+  void aio_compare_and_write(Extents &&image_extents,
+                             ceph::bufferlist&& cmp_bl,
+                             ceph::bufferlist&& bl,
+                             uint64_t *mismatch_offset,
+                             int fadvise_flags, Context *on_finish) override {
+    on_finish->complete(0);
+  }
+};
+
 } // anonymous namespace
 
 namespace util {
@@ -100,6 +139,35 @@ struct TestMockCacheSSDWriteLog : public TestMockFixture {
                       }));
   }
 
+  void write(MockSSDWriteLog& ssd, uint64_t offset, uint64_t length,
+             char c) {
+    MockContextSSD finish_ctx;
+    expect_context_complete(finish_ctx, 0);
+    Extents image_extents{{offset, length}};
+    bufferlist bl;
+    bl.append(std::string(length, c));
+    ssd.write(std::move(image_extents), std::move(bl), 0, &finish_ctx);
+    ASSERT_EQ(0, finish_ctx.wait());
+  }
+
+  void flush(MockSSDWriteLog& ssd) {
+    MockContextSSD finish_ctx;
+    expect_context_complete(finish_ctx, 0);
+    ssd.flush(io::FLUSH_SOURCE_USER, &finish_ctx);
+    ASSERT_EQ(0, finish_ctx.wait());
+  }
+
+  void expect_writeback(RecordingImageWriteback& writeback, size_t index,
+                        uint64_t offset, const std::string& data) {
+    std::lock_guard locker{writeback.lock};
+    ASSERT_LT(index, writeback.writes.size());
+    auto& [image_extents, bl] = writeback.writes[index];
+    ASSERT_EQ(Extents({{offset, data.length()}}), image_extents);
+    bufferlist expected_bl;
+    expected_bl.append(data);
+    ASSERT_TRUE(expected_bl.contents_equal(bl));
+  }
+
   void expect_metadata_remove(MockImageCtx& mock_image_ctx) {
     EXPECT_CALL(*mock_image_ctx.operations, execute_metadata_remove(_, _))
       .WillRepeatedly(Invoke([](std::string key, Context* ctx) {
@@ -210,6 +278,67 @@ TEST_F(TestMockCacheSSDWriteLog, write) {
   ASSERT_EQ(0, finish_ctx3.wait());
 }
 
+TEST_F(TestMockCacheSSDWriteLog, write_append_batch) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  ictx->config.set_val("rbd_persistent_cache_append_batch_us", "10000");
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockImageWriteback mock_image_writeback(mock_image_ctx);
+  MockApi mock_api;
+  MockSSDWriteLog ssd(
+      mock_image_ctx, get_cache_state(mock_image_ctx, mock_api),
+      mock_image_writeback, mock_api);
+
+  MockContextSSD finish_ctx1;
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  // neither write fills a control block, the timer has to append them
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  Extents image_extents{{0, 4096}};
+  bufferlist bl;
+  bl.append(std::string(4096, '1'));
+  int fadvise_flags = 0;
+  ssd.write(std::move(image_extents), std::move(bl), fadvise_flags, &finish_ctx2);
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  Extents image_extents2{{8192, 4096}};
+  bufferlist bl2;
+  bl2.append(std::string(4096, '2'));
+  bufferlist bl2_copy = bl2;
+  ssd.write(std::move(image_extents2), std::move(bl2), fadvise_flags, &finish_ctx3);
+  ASSERT_EQ(0, finish_ctx2.wait());
+  ASSERT_EQ(0, finish_ctx3.wait());
+
+  MockContextSSD finish_ctx_read;
+  expect_context_complete(finish_ctx_read, 0);
+  Extents image_extents_read{{8192, 4096}};
+  bufferlist read_bl;
+  ssd.read(std::move(image_extents_read), &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  ASSERT_TRUE(bl2_copy.contents_equal(read_bl));
+
+  // shutting down doesn't wait for, nor lose, a pending batch
+  MockContextSSD finish_ctx4;
+  expect_context_complete(finish_ctx4, 0);
+  Extents image_extents3{{16384, 4096}};
+  bufferlist bl3;
+  bl3.append(std::string(4096, '3'));
+  ssd.write(std::move(image_extents3), std::move(bl3), fadvise_flags, &finish_ctx4);
+
+  MockContextSSD finish_ctx5;
+  expect_context_complete(finish_ctx5, 0);
+  ssd.shut_down(&finish_ctx5);
+  ASSERT_EQ(0, finish_ctx4.wait());
+  ASSERT_EQ(0, finish_ctx5.wait());
+}
+
 TEST_F(TestMockCacheSSDWriteLog, read_hit_ssd_cache) {
   librbd::ImageCtx *ictx;
   ASSERT_EQ(0, open_image(m_image_name, &ictx));
@@ -753,6 +882,153 @@ TEST_F(TestMockCacheSSDWriteLog, flush_source_user) {
   ASSERT_EQ(0, finish_ctx4.wait());
 }
 
+TEST_F(TestMockCacheSSDWriteLog, writeback_superseded) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  RecordingImageWriteback writeback;
+  MockApi mock_api;
+  MockSSDWriteLog ssd(
+      mock_image_ctx, get_cache_state(mock_image_ctx, mock_api),
+      writeback, mock_api);
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  // persist on flush, so the whole sync gen is written back in one batch
+  flush(ssd);
+  write(ssd, 0, 4096, '1');
+  write(ssd, 0, 8192, '2');
+  flush(ssd);
+
+  // shut down only completes once every dirty entry was retired,
+  // including the overwritten one that issued no IO
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  ssd.shut_down(&finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  ASSERT_EQ(1u, writeback.writes.size());
+  expect_writeback(writeback, 0, 0, std::string(8192, '2'));
+}
+
+TEST_F(TestMockCacheSSDWriteLog, writeback_overlapping) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  RecordingImageWriteback writeback;
+  MockApi mock_api;
+  MockSSDWriteLog ssd(
+      mock_image_ctx, get_cache_state(mock_image_ctx, mock_api),
+      writeback, mock_api);
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  flush(ssd);
+  write(ssd, 4096, 8192, '1');
+  write(ssd, 0, 8192, '2');
+  flush(ssd);
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  ssd.shut_down(&finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  // partially overlapping entries are not sorted by offset
+  ASSERT_EQ(2u, writeback.writes.size());
+  expect_writeback(writeback, 0, 4096, std::string(8192, '1'));
+  expect_writeback(writeback, 1, 0, std::string(8192, '2'));
+}
+
+TEST_F(TestMockCacheSSDWriteLog, writeback_adjacent) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  RecordingImageWriteback writeback;
+  MockApi mock_api;
+  MockSSDWriteLog ssd(
+      mock_image_ctx, get_cache_state(mock_image_ctx, mock_api),
+      writeback, mock_api);
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  flush(ssd);
+  write(ssd, 4096, 4096, '2');
+  write(ssd, 0, 4096, '1');
+  write(ssd, 8192, 4096, '3');
+  flush(ssd);
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  ssd.shut_down(&finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  ASSERT_EQ(1u, writeback.writes.size());
+  expect_writeback(writeback, 0, 0, std::string(4096, '1') +
+                                    std::string(4096, '2') +
+                                    std::string(4096, '3'));
+}
+
+TEST_F(TestMockCacheSSDWriteLog, writeback_sync_gens) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  RecordingImageWriteback writeback;
+  MockApi mock_api;
+  MockSSDWriteLog ssd(
+      mock_image_ctx, get_cache_state(mock_image_ctx, mock_api),
+      writeback, mock_api);
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  flush(ssd);
+  write(ssd, 0, 4096, '1');
+  write(ssd, 8192, 4096, '1');
+  flush(ssd);
+  write(ssd, 4096, 4096, '2');
+  write(ssd, 0, 8192, '2');
+  flush(ssd);
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  ssd.shut_down(&finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  // nothing is merged or dropped across a flush
+  std::lock_guard locker{writeback.lock};
+  ASSERT_EQ(3u, writeback.writes.size());
+  std::vector<Extents> older;
+  for (size_t i = 0; i < 2; ++i) {
+    older.push_back(writeback.writes[i].first);
+  }
+  std::sort(older.begin(), older.end());
+  ASSERT_EQ(std::vector<Extents>({{{0, 4096}}, {{8192, 4096}}}), older);
+  ASSERT_EQ(Extents({{0, 8192}}), writeback.writes[2].first);
+}
+
 } // namespace pwl
 } // namespace cache
 } // namespace librbd
@@ -4,6 +4,7 @@
 #include "test/librbd/test_fixture.h"
 #include "librbd/crypto/BlockCrypto.h"
 #include "test/librbd/mock/crypto/MockDataCryptor.h"
+#include <boost/scope_exit.hpp>
 
 #include "librbd/crypto/BlockCrypto.cc"
 template class librbd::crypto::BlockCrypto<
@@ -113,6 +114,61 @@ TEST_F(TestMockCryptoBlockCrypto, Encrypt) {
   ASSERT_EQ(data.length(), 8192);
 }
 
+TEST_F(TestMockCryptoBlockCrypto, EncryptParallel) {
+  std::string prev_min_bytes;
+  ASSERT_EQ(0, _rados.conf_get("rbd_crypto_parallel_min_bytes",
+                               prev_min_bytes));
+  ASSERT_EQ(0, _rados.conf_set("rbd_crypto_parallel_min_bytes", "8192"));
+  BOOST_SCOPE_EXIT_TPL(&prev_min_bytes) {
+    _rados.conf_set("rbd_crypto_parallel_min_bytes", prev_min_bytes.c_str());
+  } BOOST_SCOPE_EXIT_END;
+
+  auto parallel_cryptor = new MockDataCryptor();
+  parallel_cryptor->block_size = cryptor_block_size;
+  auto parallel_bc = BlockCrypto<MockCryptoContext>::create(
+          reinterpret_cast<CephContext*>(m_ioctx.cct()), parallel_cryptor,
+          block_size, data_offset);
+  BOOST_SCOPE_EXIT(parallel_bc) {
+    parallel_bc->put();
+  } BOOST_SCOPE_EXIT_END;
+
+  uint32_t image_offset = 0x1230 * 512;
+  int block_count = 4;
+  ceph::bufferlist data;
+  std::string expected;
+  for (int i = 0; i < block_count; ++i) {
+    std::string block(block_size, 'a' + i);
+    data.append(block);
+    for (auto& c : block) {
+      c = ~c;
+    }
+    expected += block;
+  }
+
+  EXPECT_CALL(*parallel_cryptor, get_context(CipherMode::CIPHER_MODE_ENC))
+    .WillRepeatedly(Invoke([](CipherMode) {
+                      return new MockCryptoContext();
+                    }));
+  EXPECT_CALL(*parallel_cryptor, init_context(_, _, cryptor_iv_size))
+    .Times(block_count).WillRepeatedly(Return(0));
+  EXPECT_CALL(*parallel_cryptor, update_context(_, _, _, _))
+    .Times(block_count).WillRepeatedly(Invoke(
+      [](MockCryptoContext*, const unsigned char* in, unsigned char* out,
+         uint32_t len) {
+        for (uint32_t i = 0; i < len; ++i) {
+          out[i] = ~in[i];
+        }
+        return len;
+      }));
+  EXPECT_CALL(*parallel_cryptor, return_context(_, CipherMode::CIPHER_MODE_ENC))
+    .WillRepeatedly(WithArg<0>(Invoke([](MockCryptoContext* ctx) {
+                                 delete ctx;
+                               })));
+
+  ASSERT_EQ(0, parallel_bc->encrypt(&data, image_offset));
+  ASSERT_EQ(expected, data.to_str());
+}
+
 TEST_F(TestMockCryptoBlockCrypto, UnalignedImageOffset) {
   ceph::bufferlist data;
   data.append(std::string(4096, '1'));
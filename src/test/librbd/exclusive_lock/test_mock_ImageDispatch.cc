@@ -0,0 +1,84 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "common/Cond.h"
+#include "librbd/exclusive_lock/ImageDispatch.h"
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+
+namespace util {
+
+inline ImageCtx *get_image_ctx(MockTestImageCtx *image_ctx) {
+  return image_ctx->image_ctx;
+}
+
+} // namespace util
+} // namespace librbd
+
+#include "librbd/exclusive_lock/ImageDispatch.cc"
+
+namespace librbd {
+namespace exclusive_lock {
+
+using ::testing::_;
+using ::testing::Invoke;
+
+struct TestMockExclusiveLockImageDispatch : public TestMockFixture {
+  typedef ImageDispatch<librbd::MockTestImageCtx> MockImageDispatch;
+
+  void expect_flush(MockTestImageCtx &mock_image_ctx, int r) {
+    EXPECT_CALL(*mock_image_ctx.io_image_dispatcher, send(_))
+      .WillOnce(Invoke([r](io::ImageDispatchSpec* spec) {
+                  ASSERT_TRUE(boost::get<io::ImageDispatchSpec::Flush>(
+                    &spec->request) != nullptr);
+                  spec->dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+                  spec->aio_comp->set_request_count(1);
+                  spec->aio_comp->add_request();
+                  spec->aio_comp->complete_request(r);
+                }));
+  }
+};
+
+TEST_F(TestMockExclusiveLockImageDispatch, MayBlock) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockImageDispatch mock_image_dispatch(&mock_image_ctx);
+
+  ASSERT_FALSE(mock_image_dispatch.may_block(true));
+  ASSERT_FALSE(mock_image_dispatch.may_block(false));
+
+  C_SaferCond on_read_required;
+  mock_image_dispatch.set_require_lock(false, io::DIRECTION_READ,
+                                       &on_read_required);
+  ASSERT_EQ(0, on_read_required.wait());
+  ASSERT_TRUE(mock_image_dispatch.may_block(true));
+  ASSERT_FALSE(mock_image_dispatch.may_block(false));
+
+  expect_flush(mock_image_ctx, 0);
+  C_SaferCond on_write_required;
+  mock_image_dispatch.set_require_lock(false, io::DIRECTION_WRITE,
+                                       &on_write_required);
+  ASSERT_EQ(0, on_write_required.wait());
+  ASSERT_TRUE(mock_image_dispatch.may_block(true));
+  ASSERT_TRUE(mock_image_dispatch.may_block(false));
+
+  mock_image_dispatch.unset_require_lock(io::DIRECTION_BOTH);
+  ASSERT_FALSE(mock_image_dispatch.may_block(true));
+  ASSERT_FALSE(mock_image_dispatch.may_block(false));
+}
+
+} // namespace exclusive_lock
+} // namespace librbd
@@ -0,0 +1,166 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "test/librbd/mock/io/MockImageDispatch.h"
+#include "common/Cond.h"
+#include "librbd/io/Dispatcher.h"
+#include "librbd/io/ImageDispatchSpec.h"
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+
+namespace io {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+struct TestDispatcher
+  : public Dispatcher<MockTestImageCtx,
+                      DispatcherInterface<ImageDispatchInterface>> {
+  TestDispatcher(MockTestImageCtx* image_ctx) : Dispatcher(image_ctx) {
+  }
+
+  using Dispatcher::get_dispatches;
+
+protected:
+  bool send_dispatch(ImageDispatchInterface* dispatch,
+                     ImageDispatchSpec* dispatch_spec) override {
+    return false;
+  }
+};
+
+struct TestMockIoDispatcher : public TestMockFixture {
+  MockImageDispatch* create_dispatch(ImageDispatchLayer layer) {
+    auto dispatch = new MockImageDispatch();
+    EXPECT_CALL(*dispatch, get_dispatch_layer())
+      .WillRepeatedly(Return(layer));
+    return dispatch;
+  }
+
+  void expect_shut_down(MockImageDispatch& dispatch, bool* shut_down) {
+    EXPECT_CALL(dispatch, shut_down(_))
+      .WillOnce(Invoke([shut_down](Context* on_finish) {
+                  *shut_down = true;
+                  on_finish->complete(0);
+                }));
+  }
+};
+
+TEST_F(TestMockIoDispatcher, ShutDownDispatch) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  expect_op_work_queue(mock_image_ctx);
+  TestDispatcher dispatcher(&mock_image_ctx);
+
+  auto dispatch = create_dispatch(IMAGE_DISPATCH_LAYER_QUEUE);
+  dispatcher.register_dispatch(dispatch);
+  ASSERT_TRUE(dispatcher.exists(IMAGE_DISPATCH_LAYER_QUEUE));
+
+  bool shut_down = false;
+  expect_shut_down(*dispatch, &shut_down);
+  C_SaferCond ctx;
+  dispatcher.shut_down_dispatch(IMAGE_DISPATCH_LAYER_QUEUE, &ctx);
+  ASSERT_EQ(0, ctx.wait());
+  ASSERT_TRUE(shut_down);
+  ASSERT_FALSE(dispatcher.exists(IMAGE_DISPATCH_LAYER_QUEUE));
+
+  C_SaferCond shut_down_ctx;
+  dispatcher.shut_down(&shut_down_ctx);
+  ASSERT_EQ(0, shut_down_ctx.wait());
+}
+
+TEST_F(TestMockIoDispatcher, ShutDownDispatchHeldSnapshot) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  expect_op_work_queue(mock_image_ctx);
+  TestDispatcher dispatcher(&mock_image_ctx);
+
+  auto dispatch_a = create_dispatch(IMAGE_DISPATCH_LAYER_QUEUE);
+  auto dispatch_b = create_dispatch(IMAGE_DISPATCH_LAYER_WRITE_BLOCK);
+  dispatcher.register_dispatch(dispatch_a);
+  dispatcher.register_dispatch(dispatch_b);
+
+  // an in-flight reader holding the snapshot with both layers
+  auto dispatch_map = dispatcher.get_dispatches();
+  ASSERT_EQ(2u, dispatch_map->dispatches.size());
+
+  bool shut_down_a = false;
+  bool shut_down_b = false;
+  expect_shut_down(*dispatch_a, &shut_down_a);
+  expect_shut_down(*dispatch_b, &shut_down_b);
+
+  // removing A retires the snapshot B was removed from, but neither layer
+  // may be shut down while the older snapshot still references them
+  C_SaferCond ctx_b;
+  dispatcher.shut_down_dispatch(IMAGE_DISPATCH_LAYER_WRITE_BLOCK, &ctx_b);
+  C_SaferCond ctx_a;
+  dispatcher.shut_down_dispatch(IMAGE_DISPATCH_LAYER_QUEUE, &ctx_a);
+  ictx->op_work_queue->drain();
+  ASSERT_FALSE(shut_down_a);
+  ASSERT_FALSE(shut_down_b);
+  ASSERT_FALSE(dispatcher.exists(IMAGE_DISPATCH_LAYER_QUEUE));
+  ASSERT_FALSE(dispatcher.exists(IMAGE_DISPATCH_LAYER_WRITE_BLOCK));
+
+  dispatch_map.reset();
+  ASSERT_EQ(0, ctx_b.wait());
+  ASSERT_EQ(0, ctx_a.wait());
+  ASSERT_TRUE(shut_down_a);
+  ASSERT_TRUE(shut_down_b);
+
+  C_SaferCond shut_down_ctx;
+  dispatcher.shut_down(&shut_down_ctx);
+  ASSERT_EQ(0, shut_down_ctx.wait());
+}
+
+TEST_F(TestMockIoDispatcher, ShutDownHeldSnapshot) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  expect_op_work_queue(mock_image_ctx);
+  TestDispatcher dispatcher(&mock_image_ctx);
+
+  auto dispatch_a = create_dispatch(IMAGE_DISPATCH_LAYER_QUEUE);
+  auto dispatch_b = create_dispatch(IMAGE_DISPATCH_LAYER_WRITE_BLOCK);
+  dispatcher.register_dispatch(dispatch_a);
+  dispatcher.register_dispatch(dispatch_b);
+
+  auto dispatch_map = dispatcher.get_dispatches();
+
+  bool shut_down_a = false;
+  bool shut_down_b = false;
+  expect_shut_down(*dispatch_a, &shut_down_a);
+  expect_shut_down(*dispatch_b, &shut_down_b);
+
+  C_SaferCond ctx_b;
+  dispatcher.shut_down_dispatch(IMAGE_DISPATCH_LAYER_WRITE_BLOCK, &ctx_b);
+  C_SaferCond shut_down_ctx;
+  dispatcher.shut_down(&shut_down_ctx);
+  ictx->op_work_queue->drain();
+  ASSERT_FALSE(shut_down_a);
+  ASSERT_FALSE(shut_down_b);
+
+  dispatch_map.reset();
+  ASSERT_EQ(0, ctx_b.wait());
+  ASSERT_EQ(0, shut_down_ctx.wait());
+  ASSERT_TRUE(shut_down_a);
+  ASSERT_TRUE(shut_down_b);
+}
+
+} // namespace io
+} // namespace librbd
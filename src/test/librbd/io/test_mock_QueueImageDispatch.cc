@@ -0,0 +1,179 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "common/Cond.h"
+#include "librbd/io/QueueImageDispatch.h"
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+
+namespace io {
+
+template <>
+struct FlushTracker<MockTestImageCtx> {
+  FlushTracker(MockTestImageCtx*) {
+  }
+
+  void shut_down() {
+  }
+
+  void flush(Context*) {
+  }
+
+  void start_io(uint64_t) {
+  }
+
+  void finish_io(uint64_t) {
+  }
+
+};
+
+} // namespace io
+} // namespace librbd
+
+#include "librbd/io/QueueImageDispatch.cc"
+
+namespace librbd {
+namespace io {
+
+using ::testing::_;
+using ::testing::Return;
+
+struct TestMockIoQueueImageDispatch : public TestMockFixture {
+  typedef QueueImageDispatch<librbd::MockTestImageCtx> MockQueueImageDispatch;
+
+  void expect_may_block(MockTestImageCtx &mock_image_ctx, bool read_op,
+                        bool may_block) {
+    EXPECT_CALL(*mock_image_ctx.io_image_dispatcher, may_block(read_op))
+      .WillOnce(Return(may_block));
+  }
+
+  bool queue_read(MockTestImageCtx &mock_image_ctx,
+                  MockQueueImageDispatch &mock_queue_image_dispatch,
+                  Context** on_finish, Context* on_dispatched) {
+    DispatchResult dispatch_result;
+    return mock_queue_image_dispatch.read(
+      nullptr, {{0, 4096}}, ReadResult{}, mock_image_ctx.get_data_io_context(),
+      0, 0, {}, 0, nullptr, &dispatch_result, on_finish, on_dispatched);
+  }
+
+  bool queue_write(MockTestImageCtx &mock_image_ctx,
+                   MockQueueImageDispatch &mock_queue_image_dispatch,
+                   Context** on_finish, Context* on_dispatched) {
+    bufferlist bl;
+    bl.append(std::string(4096, '1'));
+    DispatchResult dispatch_result;
+    return mock_queue_image_dispatch.write(
+      nullptr, {{0, 4096}}, std::move(bl),
+      mock_image_ctx.get_data_io_context(), 0, {}, 0, nullptr,
+      &dispatch_result, on_finish, on_dispatched);
+  }
+};
+
+TEST_F(TestMockIoQueueImageDispatch, BlockingAio) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.non_blocking_aio = false;
+  mock_image_ctx.io_run_to_completion = true;
+  MockQueueImageDispatch mock_queue_image_dispatch(&mock_image_ctx);
+
+  EXPECT_CALL(*mock_image_ctx.io_image_dispatcher, may_block(_)).Times(0);
+
+  C_SaferCond cond;
+  Context *on_finish = &cond;
+  ASSERT_FALSE(queue_write(mock_image_ctx, mock_queue_image_dispatch,
+                           &on_finish, nullptr));
+  ASSERT_EQ(on_finish, &cond); // not modified
+}
+
+TEST_F(TestMockIoQueueImageDispatch, Queue) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.non_blocking_aio = true;
+  mock_image_ctx.io_run_to_completion = false;
+  MockQueueImageDispatch mock_queue_image_dispatch(&mock_image_ctx);
+
+  // nothing is asked unless running to completion is enabled
+  EXPECT_CALL(*mock_image_ctx.io_image_dispatcher, may_block(_)).Times(0);
+
+  C_SaferCond cond;
+  Context *on_finish = &cond;
+  C_SaferCond on_dispatched;
+  ASSERT_TRUE(queue_write(mock_image_ctx, mock_queue_image_dispatch,
+                          &on_finish, &on_dispatched));
+  ASSERT_EQ(0, on_dispatched.wait());
+  ASSERT_NE(on_finish, &cond);
+  on_finish->complete(0);
+  ASSERT_EQ(0, cond.wait());
+}
+
+TEST_F(TestMockIoQueueImageDispatch, RunToCompletion) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.non_blocking_aio = true;
+  mock_image_ctx.io_run_to_completion = true;
+  MockQueueImageDispatch mock_queue_image_dispatch(&mock_image_ctx);
+
+  expect_may_block(mock_image_ctx, true, false);
+  C_SaferCond read_cond;
+  Context *on_finish = &read_cond;
+  ASSERT_FALSE(queue_read(mock_image_ctx, mock_queue_image_dispatch,
+                          &on_finish, nullptr));
+  ASSERT_EQ(on_finish, &read_cond); // not modified
+
+  expect_may_block(mock_image_ctx, false, false);
+  C_SaferCond write_cond;
+  on_finish = &write_cond;
+  ASSERT_FALSE(queue_write(mock_image_ctx, mock_queue_image_dispatch,
+                           &on_finish, nullptr));
+  ASSERT_EQ(on_finish, &write_cond); // not modified
+}
+
+TEST_F(TestMockIoQueueImageDispatch, RunToCompletionMayBlock) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.non_blocking_aio = true;
+  mock_image_ctx.io_run_to_completion = true;
+  MockQueueImageDispatch mock_queue_image_dispatch(&mock_image_ctx);
+
+  expect_may_block(mock_image_ctx, true, true);
+  C_SaferCond read_cond;
+  Context *on_finish = &read_cond;
+  C_SaferCond read_dispatched;
+  ASSERT_TRUE(queue_read(mock_image_ctx, mock_queue_image_dispatch,
+                         &on_finish, &read_dispatched));
+  ASSERT_EQ(0, read_dispatched.wait());
+  ASSERT_EQ(on_finish, &read_cond); // reads are not tracked
+
+  expect_may_block(mock_image_ctx, false, true);
+  C_SaferCond write_cond;
+  on_finish = &write_cond;
+  C_SaferCond write_dispatched;
+  ASSERT_TRUE(queue_write(mock_image_ctx, mock_queue_image_dispatch,
+                          &on_finish, &write_dispatched));
+  ASSERT_EQ(0, write_dispatched.wait());
+  ASSERT_NE(on_finish, &write_cond);
+  on_finish->complete(0);
+  ASSERT_EQ(0, write_cond.wait());
+}
+
+} // namespace io
+} // namespace librbd
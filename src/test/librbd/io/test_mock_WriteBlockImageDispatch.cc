@@ -0,0 +1,82 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "common/Cond.h"
+#include "librbd/io/WriteBlockImageDispatch.h"
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+
+namespace util {
+
+inline ImageCtx *get_image_ctx(MockTestImageCtx *image_ctx) {
+  return image_ctx->image_ctx;
+}
+
+} // namespace util
+} // namespace librbd
+
+#include "librbd/io/WriteBlockImageDispatch.cc"
+
+namespace librbd {
+namespace io {
+
+using ::testing::_;
+using ::testing::Invoke;
+
+struct TestMockIoWriteBlockImageDispatch : public TestMockFixture {
+  typedef WriteBlockImageDispatch<librbd::MockTestImageCtx>
+    MockWriteBlockImageDispatch;
+
+  void expect_flush_io(MockTestImageCtx &mock_image_ctx, int r) {
+    EXPECT_CALL(*mock_image_ctx.io_image_dispatcher, send(_))
+      .WillOnce(Invoke([r](ImageDispatchSpec* spec) {
+                  ASSERT_TRUE(boost::get<ImageDispatchSpec::Flush>(
+                    &spec->request) != nullptr);
+                  spec->dispatch_result = DISPATCH_RESULT_COMPLETE;
+                  spec->aio_comp->set_request_count(1);
+                  spec->aio_comp->add_request();
+                  spec->aio_comp->complete_request(r);
+                }));
+  }
+};
+
+TEST_F(TestMockIoWriteBlockImageDispatch, MayBlock) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockWriteBlockImageDispatch mock_write_block_image_dispatch(&mock_image_ctx);
+  expect_op_work_queue(mock_image_ctx);
+
+  ASSERT_FALSE(mock_write_block_image_dispatch.may_block(true));
+  ASSERT_FALSE(mock_write_block_image_dispatch.may_block(false));
+
+  expect_flush_io(mock_image_ctx, 0);
+  C_SaferCond on_blocked;
+  {
+    std::shared_lock owner_locker{mock_image_ctx.owner_lock};
+    mock_write_block_image_dispatch.block_writes(&on_blocked);
+  }
+  ASSERT_EQ(0, on_blocked.wait());
+
+  // only writes are held back while blocked
+  ASSERT_FALSE(mock_write_block_image_dispatch.may_block(true));
+  ASSERT_TRUE(mock_write_block_image_dispatch.may_block(false));
+
+  mock_write_block_image_dispatch.unblock_writes();
+  ASSERT_FALSE(mock_write_block_image_dispatch.may_block(false));
+}
+
+} // namespace io
+} // namespace librbd
@@ -98,6 +98,7 @@ struct MockImageCtx {
       discard_granularity_bytes(image_ctx.discard_granularity_bytes),
       mirroring_replay_delay(image_ctx.mirroring_replay_delay),
       non_blocking_aio(image_ctx.non_blocking_aio),
+      io_run_to_completion(image_ctx.io_run_to_completion),
       blkin_trace_all(image_ctx.blkin_trace_all),
       enable_alloc_hint(image_ctx.enable_alloc_hint),
       alloc_hint_flags(image_ctx.alloc_hint_flags),
@@ -323,6 +324,7 @@ struct MockImageCtx {
   uint32_t discard_granularity_bytes;
   int mirroring_replay_delay;
   bool non_blocking_aio;
+  bool io_run_to_completion;
   bool blkin_trace_all;
   bool enable_alloc_hint;
   uint32_t alloc_hint_flags;
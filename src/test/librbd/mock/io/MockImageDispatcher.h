@@ -41,6 +41,7 @@ public:
   MOCK_METHOD1(wait_on_writes_unblocked, void(Context*));
 
   MOCK_METHOD2(remap_extents, void(Extents&, ImageExtentsMapType));
+  MOCK_CONST_METHOD1(may_block, bool(bool));
 };
 
 } // namespace io
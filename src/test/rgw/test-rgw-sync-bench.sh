@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+
+# measure how long the second zone of a two-zone setup started with
+# "test-rgw-multisite.sh 2" takes to sync a bucket of small objects.
+# needs python3 with boto3.
+
+[ $# -lt 1 ] && echo "usage: $0 <num-objects> [object-size] [bucket-name]" && exit 1
+
+num_objects=$1
+obj_size=${2:-4096}
+bucket=${3:-sync-bench}
+
+. "`dirname $0`/test-rgw-common.sh"
+. "`dirname $0`/test-rgw-meta-sync.sh"
+
+set -e
+
+realm_name=earth
+uid=sync-bench
+access_key=sync-bench-key
+secret=sync-bench-secret
+
+if ! x $(rgw_admin c1) user info --uid=$uid > /dev/null 2>&1; then
+  x $(rgw_admin c1) user create --uid=$uid --display-name=$uid \
+    --access-key=$access_key --secret=$secret > /dev/null
+fi
+wait_for_meta_sync c1 c2 $realm_name
+
+python3 - "$url:8101" $access_key $secret $bucket $num_objects $obj_size <<'PYEOF'
+import sys
+from concurrent.futures import ThreadPoolExecutor
+import boto3
+
+endpoint, access_key, secret, bucket, count, size = sys.argv[1:]
+s3 = boto3.client('s3', endpoint_url=endpoint, aws_access_key_id=access_key,
+                  aws_secret_access_key=secret, region_name='zg1')
+s3.create_bucket(Bucket=bucket)
+body = b'x' * int(size)
+with ThreadPoolExecutor(max_workers=32) as pool:
+    list(pool.map(lambda i: s3.put_object(Bucket=bucket, Key='obj-%08d' % i,
+                                          Body=body),
+                  range(int(count))))
+PYEOF
+
+start=`date +%s`
+echo "uploaded $num_objects objects of $obj_size bytes, waiting for sync"
+
+while true; do
+  stats=`$(rgw_admin c2) bucket stats --bucket=$bucket 2>/dev/null || true`
+  synced=`echo "$stats" | python3 -c '
+import json, sys
+try:
+    usage = json.load(sys.stdin)["usage"]
+    print(usage.get("rgw.main", {}).get("num_objects", 0))
+except Exception:
+    print(0)
+'`
+  [ "$synced" -ge "$num_objects" ] && break
+  sleep 1
+done
+
+elapsed=$((`date +%s` - start))
+[ $elapsed -eq 0 ] && elapsed=1
+echo "synced $num_objects objects in ${elapsed}s ($((num_objects / elapsed)) objects/s)"
@@ -0,0 +1,195 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw/rgw_bucket_list_merge.h"
+
+#include <set>
+#include <vector>
+
+#include <boost/container/flat_map.hpp>
+
+#include "common/ceph_context.h"
+#include <gtest/gtest.h>
+
+using namespace rgw::bucket_list;
+
+using ent_map_t =
+  boost::container::flat_map<std::string, rgw_bucket_dir_entry>;
+
+auto cct = new CephContext(CEPH_ENTITY_TYPE_CLIENT);
+const DoutPrefix dp(cct, 1, "test bucket list merge: ");
+
+static rgw_cls_list_ret make_page(const std::vector<std::string>& names,
+                                  bool truncated)
+{
+  rgw_cls_list_ret page;
+  for (const auto& name : names) {
+    rgw_bucket_dir_entry entry;
+    entry.key.name = name;
+    entry.exists = true;
+    page.dir.m.emplace(name, std::move(entry));
+  }
+  page.is_truncated = truncated;
+  return page;
+}
+
+// hands out queued pages for each shard and records the markers it
+// was asked to start from
+struct Refiller {
+  std::map<int, std::vector<rgw_cls_list_ret>> pages;
+  std::vector<std::pair<int, std::string>> calls;
+
+  int operator()(int shard, const std::string& oid,
+                 const cls_rgw_obj_key& marker, uint32_t max_entries,
+                 rgw_cls_list_ret* result) {
+    calls.emplace_back(shard, marker.name);
+    auto& queue = pages[shard];
+    if (queue.empty()) {
+      return -EIO;
+    }
+    *result = std::move(queue.front());
+    queue.erase(queue.begin());
+    return 0;
+  }
+};
+
+struct Checker {
+  std::set<std::string> skip;
+
+  int operator()(const std::string& oid, rgw_bucket_dir_entry& entry) {
+    return skip.count(entry.key.name) ? -ENOENT : 0;
+  }
+};
+
+static std::vector<std::string> keys(const ent_map_t& m)
+{
+  std::vector<std::string> result;
+  for (const auto& [name, entry] : m) {
+    result.push_back(name);
+  }
+  return result;
+}
+
+static const std::map<int, std::string> oids = {{0, "shard0"}, {1, "shard1"}};
+
+TEST(BucketListMerge, Interleave)
+{
+  std::map<int, rgw_cls_list_ret> results;
+  results[0] = make_page({"a", "c", "e"}, false);
+  results[1] = make_page({"b", "d"}, false);
+
+  Refiller refiller;
+  ent_map_t m;
+  bool truncated = false;
+  bool filtered = true;
+  std::optional<cls_rgw_obj_key> last;
+  ASSERT_EQ(0, merge_ordered(&dp, results, oids, 10, 3, Checker{},
+                             std::ref(refiller), m, &truncated, &filtered,
+                             last));
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "c", "d", "e"}), keys(m));
+  EXPECT_FALSE(truncated);
+  EXPECT_TRUE(refiller.calls.empty());
+  ASSERT_TRUE(last);
+  EXPECT_EQ("e", last->name);
+}
+
+TEST(BucketListMerge, RefillTruncatedShard)
+{
+  std::map<int, rgw_cls_list_ret> results;
+  results[0] = make_page({"a", "b"}, true);
+  results[1] = make_page({"c", "z"}, false);
+
+  Refiller refiller;
+  refiller.pages[0].push_back(make_page({"d", "e"}, false));
+
+  ent_map_t m;
+  bool truncated = false;
+  bool filtered = true;
+  std::optional<cls_rgw_obj_key> last;
+  ASSERT_EQ(0, merge_ordered(&dp, results, oids, 10, 2, Checker{},
+                             std::ref(refiller), m, &truncated, &filtered,
+                             last));
+  // shard 0 is refilled from its last key before "c" is handed out
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "c", "d", "e", "z"}),
+            keys(m));
+  ASSERT_EQ(1u, refiller.calls.size());
+  EXPECT_EQ(0, refiller.calls[0].first);
+  EXPECT_EQ("b", refiller.calls[0].second);
+  EXPECT_FALSE(truncated);
+  ASSERT_TRUE(last);
+  EXPECT_EQ("z", last->name);
+}
+
+TEST(BucketListMerge, RefillAfterSkippedEntry)
+{
+  // the truncated shard runs out on an entry that is skipped, and the
+  // refill replaces the page that entry lived in
+  std::map<int, rgw_cls_list_ret> results;
+  results[0] = make_page({"a", "c"}, true);
+  results[1] = make_page({"b"}, false);
+
+  Refiller refiller;
+  refiller.pages[0].push_back(make_page({}, false));
+
+  Checker checker;
+  checker.skip.insert("c");
+
+  ent_map_t m;
+  bool truncated = false;
+  bool filtered = true;
+  std::optional<cls_rgw_obj_key> last;
+  ASSERT_EQ(0, merge_ordered(&dp, results, oids, 10, 2, checker,
+                             std::ref(refiller), m, &truncated, &filtered,
+                             last));
+  EXPECT_EQ(std::vector<std::string>({"a", "b"}), keys(m));
+  ASSERT_EQ(1u, refiller.calls.size());
+  EXPECT_EQ("c", refiller.calls[0].second);
+  EXPECT_FALSE(truncated);
+  // the skipped entry is still where the next listing resumes
+  ASSERT_TRUE(last);
+  EXPECT_EQ("c", last->name);
+}
+
+TEST(BucketListMerge, RefillUsesShardMarker)
+{
+  std::map<int, rgw_cls_list_ret> results;
+  results[0] = make_page({"a"}, true);
+  results[0].marker.name = "a-filtered";
+  results[1] = make_page({"b"}, false);
+
+  Refiller refiller;
+  refiller.pages[0].push_back(make_page({"c"}, true));
+  refiller.pages[0].push_back(make_page({"d"}, false));
+
+  ent_map_t m;
+  bool truncated = false;
+  bool filtered = true;
+  std::optional<cls_rgw_obj_key> last;
+  ASSERT_EQ(0, merge_ordered(&dp, results, oids, 3, 1, Checker{},
+                             std::ref(refiller), m, &truncated, &filtered,
+                             last));
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "c"}), keys(m));
+  // the shard is only refilled while entries are still wanted
+  ASSERT_EQ(1u, refiller.calls.size());
+  EXPECT_EQ("a-filtered", refiller.calls[0].second);
+  EXPECT_TRUE(truncated);
+  ASSERT_TRUE(last);
+  EXPECT_EQ("c", last->name);
+}
+
+TEST(BucketListMerge, RefillError)
+{
+  std::map<int, rgw_cls_list_ret> results;
+  results[0] = make_page({"a"}, true);
+  results[1] = make_page({"b"}, false);
+
+  Refiller refiller; // no pages queued, so the refill fails
+
+  ent_map_t m;
+  bool truncated = false;
+  bool filtered = true;
+  std::optional<cls_rgw_obj_key> last;
+  EXPECT_EQ(-EIO, merge_ordered(&dp, results, oids, 10, 1, Checker{},
+                                std::ref(refiller), m, &truncated, &filtered,
+                                last));
+}
@@ -0,0 +1,201 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw/rgw_cache.h"
+#include "rgw/rgw_d3n_datacache.h"
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+
+auto cct = new CephContext(CEPH_ENTITY_TYPE_CLIENT);
+const NoDoutPrefix dpp(cct, ceph_subsys_rgw);
+
+// records the keys it was asked to invalidate
+struct MockChainedCache : public RGWChainedCache {
+  std::vector<std::string> invalidated;
+  void chain_cb(const std::string& key, void *data) override {}
+  void invalidate(const std::string& key) override {
+    invalidated.push_back(key);
+  }
+  void invalidate_all() override {}
+};
+
+static ObjectCacheInfo make_info(const std::string& data)
+{
+  ObjectCacheInfo info;
+  info.flags = CACHE_FLAG_DATA;
+  info.data.append(data);
+  return info;
+}
+
+static size_t count_entries(ObjectCache& cache)
+{
+  size_t count = 0;
+  cache.for_each([&count] (const std::string&, const ObjectCacheEntry&) {
+                   ++count;
+                 });
+  return count;
+}
+
+class ObjectCacheTest : public ::testing::Test {
+ protected:
+  static constexpr int64_t lru_size = 64;
+  ObjectCache cache;
+
+  void SetUp() override {
+    cct->_conf.set_val_or_die("rgw_cache_lru_size", std::to_string(lru_size));
+    cache.set_ctx(cct);
+    cache.set_enabled(true);
+  }
+};
+
+TEST_F(ObjectCacheTest, PutGet)
+{
+  auto info = make_info("data");
+  cache.put(&dpp, "obj", info, nullptr);
+
+  ObjectCacheInfo out;
+  ASSERT_EQ(0, cache.get(&dpp, "obj", out, CACHE_FLAG_DATA, nullptr));
+  EXPECT_EQ("data", out.data.to_str());
+  EXPECT_EQ(-ENOENT, cache.get(&dpp, "other", out, CACHE_FLAG_DATA, nullptr));
+}
+
+TEST_F(ObjectCacheTest, BoundedSize)
+{
+  for (int i = 0; i < 1000; i++) {
+    auto info = make_info("data");
+    cache.put(&dpp, "obj" + std::to_string(i), info, nullptr);
+  }
+  EXPECT_GE(size_t(lru_size), count_entries(cache));
+}
+
+TEST_F(ObjectCacheTest, ReferencedEntrySurvives)
+{
+  auto info = make_info("hot");
+  cache.put(&dpp, "hot", info, nullptr);
+
+  ObjectCacheInfo out;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(0, cache.get(&dpp, "hot", out, CACHE_FLAG_DATA, nullptr));
+    auto cold = make_info("cold");
+    cache.put(&dpp, "cold" + std::to_string(i), cold, nullptr);
+  }
+  EXPECT_EQ(0, cache.get(&dpp, "hot", out, CACHE_FLAG_DATA, nullptr));
+}
+
+TEST_F(ObjectCacheTest, InvalidateChained)
+{
+  MockChainedCache chained;
+  cache.chain_cache(&chained);
+
+  std::vector<rgw_cache_entry_info> infos(2);
+  auto a = make_info("a");
+  cache.put(&dpp, "a", a, &infos[0]);
+  auto b = make_info("b");
+  cache.put(&dpp, "b", b, &infos[1]);
+
+  const std::string key = "chained";
+  RGWChainedCache::Entry entry(&chained, key, nullptr);
+  ASSERT_TRUE(cache.chain_cache_entry(&dpp, {&infos[0], &infos[1]}, &entry));
+
+  EXPECT_TRUE(cache.invalidate_remove(&dpp, "b"));
+  ASSERT_EQ(1u, chained.invalidated.size());
+  EXPECT_EQ(key, chained.invalidated.front());
+
+  // the chained entry can't be attached to a removed entry
+  EXPECT_FALSE(cache.chain_cache_entry(&dpp, {&infos[0], &infos[1]}, &entry));
+
+  cache.unchain_cache(&chained);
+}
+
+TEST_F(ObjectCacheTest, Disable)
+{
+  auto info = make_info("data");
+  cache.put(&dpp, "obj", info, nullptr);
+
+  cache.set_enabled(false);
+  ObjectCacheInfo out;
+  EXPECT_EQ(-ENOENT, cache.get(&dpp, "obj", out, CACHE_FLAG_DATA, nullptr));
+  // nothing put while disabled is served once the cache is enabled again
+  cache.put(&dpp, "obj", info, nullptr);
+  cache.set_enabled(true);
+  EXPECT_EQ(-ENOENT, cache.get(&dpp, "obj", out, CACHE_FLAG_DATA, nullptr));
+  EXPECT_EQ(0u, count_entries(cache));
+}
+
+TEST_F(ObjectCacheTest, DisableWhilePutting)
+{
+  std::atomic<bool> done = false;
+  std::thread writer([&] {
+    for (int i = 0; !done; i++) {
+      auto info = make_info("data");
+      cache.put(&dpp, "obj" + std::to_string(i % 100), info, nullptr);
+    }
+  });
+  for (int i = 0; i < 100; i++) {
+    cache.set_enabled(false);
+    cache.set_enabled(true);
+  }
+  cache.set_enabled(false);
+  done = true;
+  writer.join();
+  // no put slipped in after the disabled cache was cleared
+  cache.set_enabled(true);
+  EXPECT_EQ(0u, count_entries(cache));
+}
+
+TEST(D3nAdmissionFilter, Admit)
+{
+  D3nAdmissionFilter filter;
+  filter.init(1024);
+
+  // without a known victim, a chunk is admitted once it was seen twice
+  EXPECT_FALSE(filter.admit("chunk", ""));
+  filter.record("chunk");
+  EXPECT_EQ(1, filter.estimate("chunk"));
+  EXPECT_FALSE(filter.admit("chunk", ""));
+  filter.record("chunk");
+  EXPECT_EQ(2, filter.estimate("chunk"));
+  EXPECT_TRUE(filter.admit("chunk", ""));
+}
+
+TEST(D3nAdmissionFilter, RejectAgainstVictim)
+{
+  D3nAdmissionFilter filter;
+  filter.init(1024);
+
+  for (int i = 0; i < 3; i++) {
+    filter.record("victim");
+    filter.record("chunk");
+  }
+  // a chunk only as popular as the victim doesn't replace it
+  EXPECT_FALSE(filter.admit("chunk", "victim"));
+  filter.record("chunk");
+  EXPECT_TRUE(filter.admit("chunk", "victim"));
+  EXPECT_FALSE(filter.admit("victim", "chunk"));
+}
+
+TEST(D3nAdmissionFilter, Saturated)
+{
+  D3nAdmissionFilter filter;
+  filter.init(1024);
+
+  // the counters stop at their maximum, where nothing replaces the victim
+  for (int i = 0; i < 20; i++) {
+    filter.record("victim");
+    filter.record("chunk");
+  }
+  EXPECT_EQ(filter.estimate("victim"), filter.estimate("chunk"));
+  EXPECT_FALSE(filter.admit("chunk", "victim"));
+}
+
+TEST(D3nAdmissionFilter, NotInitialized)
+{
+  D3nAdmissionFilter filter;
+  filter.record("chunk");
+  filter.record("chunk");
+  EXPECT_EQ(0, filter.estimate("chunk"));
+  EXPECT_FALSE(filter.admit("chunk", ""));
+}
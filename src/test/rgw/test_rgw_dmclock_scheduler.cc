@@ -16,6 +16,7 @@
 
 #include "rgw/rgw_dmclock_sync_scheduler.h"
 #include "rgw/rgw_dmclock_async_scheduler.h"
+#include "rgw/rgw_asio_admission.h"
 
 #include <optional>
 #include <spawn/spawn.hpp>
@@ -26,6 +27,7 @@
 namespace rgw::dmclock {
 
 using boost::system::error_code;
+using tcp = boost::asio::ip::tcp;
 
 // return a lambda that can be used as a callback to capture its arguments
 auto capture(std::optional<error_code>& opt_ec,
@@ -425,4 +427,156 @@ TEST(Queue, SpawnAsyncRequest)
   EXPECT_TRUE(context.stopped());
 }
 
+
+TEST(Queue, ThrottlerSaturated)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_max_concurrent_requests", "2");
+  SimpleThrottler throttler(g_ceph_context);
+  EXPECT_FALSE(throttler.is_saturated());
+  {
+    auto [r1, c1] = throttler.schedule_request(client_id::admin, {},
+                                               get_time(), 1, null_yield);
+    EXPECT_EQ(0, r1);
+    EXPECT_FALSE(throttler.is_saturated());
+    auto [r2, c2] = throttler.schedule_request(client_id::admin, {},
+                                               get_time(), 1, null_yield);
+    EXPECT_EQ(0, r2);
+    EXPECT_TRUE(throttler.is_saturated());
+  }
+  EXPECT_FALSE(throttler.is_saturated());
+
+  // a limit of 0 is unlimited
+  conf.set_val_or_die("rgw_max_concurrent_requests", "0");
+  conf.apply_changes(nullptr);
+  {
+    auto [r, c] = throttler.schedule_request(client_id::admin, {},
+                                             get_time(), 1, null_yield);
+    EXPECT_EQ(0, r);
+    EXPECT_FALSE(throttler.is_saturated());
+  }
+  conf.rm_val("rgw_max_concurrent_requests");
+}
+
+TEST(Queue, AsyncSaturated)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_max_concurrent_requests", "1");
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
+                  [] (client_id client) -> ClientInfo* {
+      static ClientInfo clients[] = {
+        {1, 1, 1}, // admin: satisfy by reservation
+        {1, 1, 1}, // auth: satisfy by reservation
+      };
+      return &clients[static_cast<size_t>(client)];
+    });
+  conf.rm_val("rgw_max_concurrent_requests");
+  EXPECT_FALSE(queue.is_saturated());
+
+  std::optional<error_code> ec1, ec2;
+  std::optional<PhaseType> p1, p2;
+
+  auto now = get_time();
+  queue.async_request(client_id::admin, {}, now, 1, capture(ec1, p1));
+  queue.async_request(client_id::auth, {}, now, 1, capture(ec2, p2));
+
+  context.run_for(std::chrono::milliseconds(1));
+
+  // the first request holds the only throttle unit, the second one waits
+  ASSERT_TRUE(ec1);
+  EXPECT_EQ(boost::system::errc::success, *ec1);
+  EXPECT_FALSE(ec2);
+  EXPECT_TRUE(queue.is_saturated());
+
+  queue.request_complete();
+  context.restart();
+  context.run_for(std::chrono::milliseconds(1));
+
+  ASSERT_TRUE(ec2);
+  EXPECT_EQ(boost::system::errc::success, *ec2);
+  EXPECT_TRUE(queue.is_saturated());
+
+  queue.request_complete();
+  EXPECT_FALSE(queue.is_saturated());
+}
+
+TEST(AdmissionControl, Limit)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_frontend_max_pending_requests", "2");
+  AdmissionControl admission(g_ceph_context);
+  const tcp::endpoint client{boost::asio::ip::make_address("10.0.0.1"), 80};
+
+  auto t1 = admission.admit(client, nullptr);
+  ASSERT_TRUE(t1);
+  auto t2 = admission.admit(client, nullptr);
+  ASSERT_TRUE(t2);
+  EXPECT_FALSE(admission.admit(client, nullptr));
+  EXPECT_EQ(2, admission.get_pending());
+
+  // a ticket returns its admission when destroyed
+  t1.reset();
+  EXPECT_EQ(1, admission.get_pending());
+  auto t3 = admission.admit(client, nullptr);
+  ASSERT_TRUE(t3);
+
+  // the limit follows config changes
+  conf.set_val_or_die("rgw_frontend_max_pending_requests", "0");
+  conf.apply_changes(nullptr);
+  auto t4 = admission.admit(client, nullptr);
+  ASSERT_TRUE(t4);
+  EXPECT_EQ(3, admission.get_pending());
+  conf.rm_val("rgw_frontend_max_pending_requests");
+}
+
+TEST(AdmissionControl, PerClient)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_frontend_max_pending_requests_per_client", "1");
+  AdmissionControl admission(g_ceph_context);
+  conf.rm_val("rgw_frontend_max_pending_requests_per_client");
+  const tcp::endpoint a{boost::asio::ip::make_address("10.0.0.1"), 80};
+  const tcp::endpoint b{boost::asio::ip::make_address("10.0.0.2"), 80};
+
+  auto ta = admission.admit(a, nullptr);
+  ASSERT_TRUE(ta);
+  // the client's port doesn't make it another client
+  EXPECT_FALSE(admission.admit({a.address(), 8080}, nullptr));
+  auto tb = admission.admit(b, nullptr);
+  ASSERT_TRUE(tb);
+
+  ta.reset();
+  EXPECT_TRUE(admission.admit(a, nullptr));
+}
+
+TEST(AdmissionControl, Saturated)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_max_concurrent_requests", "1");
+  SimpleThrottler throttler(g_ceph_context);
+  conf.rm_val("rgw_max_concurrent_requests");
+  AdmissionControl admission(g_ceph_context);
+  const tcp::endpoint client{boost::asio::ip::make_address("10.0.0.1"), 80};
+
+  {
+    auto [r, completer] = throttler.schedule_request(client_id::admin, {},
+                                                     get_time(), 1, null_yield);
+    ASSERT_EQ(0, r);
+    ASSERT_TRUE(throttler.is_saturated());
+
+    // without rgw_frontend_max_pending_requests the scheduler is not consulted
+    EXPECT_TRUE(admission.admit(client, &throttler));
+
+    conf.set_val_or_die("rgw_frontend_max_pending_requests", "10");
+    conf.apply_changes(nullptr);
+    EXPECT_FALSE(admission.admit(client, &throttler));
+    EXPECT_EQ(0, admission.get_pending());
+  }
+  EXPECT_TRUE(admission.admit(client, &throttler));
+  conf.rm_val("rgw_frontend_max_pending_requests");
+  conf.apply_changes(nullptr);
+}
+
 } // namespace rgw::dmclock
@@ -0,0 +1,267 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw/rgw_lc.h"
+
+#include <set>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "common/ceph_context.h"
+#include <gtest/gtest.h>
+
+using Expiration = rgw::sal::Lifecycle::LCExpiration;
+
+auto cct = new CephContext(CEPH_ENTITY_TYPE_CLIENT);
+const DoutPrefix dp(cct, 1, "test rgw lc: ");
+
+// keeps a single expiration index in memory, ordered by due time like
+// cls_timeindex
+class MemLifecycle : public rgw::sal::Lifecycle {
+  using entry_t = std::pair<ceph::real_time, std::string>;
+
+  static std::string marker_of(const entry_t& e) {
+    return fmt::format("{:020}_{}", e.first.time_since_epoch().count(),
+		       e.second);
+  }
+
+public:
+  std::set<entry_t> index;
+  int add_calls = 0;
+
+  int get_entry(const std::string& oid, const std::string& marker,
+		LCEntry& entry) override { return -ENOENT; }
+  int get_next_entry(const std::string& oid, std::string& marker,
+		     LCEntry& entry) override { return -ENOENT; }
+  int set_entry(const std::string& oid, const LCEntry& entry) override {
+    return 0;
+  }
+  int list_entries(const std::string& oid, const std::string& marker,
+		   uint32_t max_entries,
+		   std::vector<LCEntry>& entries) override { return 0; }
+  int rm_entry(const std::string& oid, const LCEntry& entry) override {
+    return 0;
+  }
+  int get_head(const std::string& oid, LCHead& head) override {
+    return -ENOENT;
+  }
+  int put_head(const std::string& oid, const LCHead& head) override {
+    return 0;
+  }
+  rgw::sal::LCSerializer* get_serializer(const std::string& lock_name,
+					 const std::string& oid,
+					 const std::string& cookie) override {
+    return nullptr;
+  }
+
+  int add_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+		      const std::vector<Expiration>& entries,
+		      optional_yield y) override {
+    ++add_calls;
+    for (auto& e : entries) {
+      index.emplace(e.due, e.key);
+    }
+    return 0;
+  }
+  int list_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+		       ceph::real_time until, const std::string& marker,
+		       uint32_t max_entries, std::vector<Expiration>& entries,
+		       std::string* next_marker, bool* truncated,
+		       optional_yield y) override {
+    entries.clear();
+    *truncated = false;
+    for (auto& e : index) {
+      if (e.first >= until) {
+	break;
+      }
+      if (!marker.empty() && marker_of(e) <= marker) {
+	continue;
+      }
+      if (entries.size() == max_entries) {
+	*truncated = true;
+	break;
+      }
+      entries.emplace_back(e.first, e.second);
+      *next_marker = marker_of(e);
+    }
+    return 0;
+  }
+  int trim_expirations(const DoutPrefixProvider* dpp, const std::string& oid,
+		       ceph::real_time until, const std::string& to_marker,
+		       optional_yield y) override {
+    for (auto i = index.begin(); i != index.end();) {
+      if (i->first < until && marker_of(*i) <= to_marker) {
+	i = index.erase(i);
+      } else {
+	++i;
+      }
+    }
+    return 0;
+  }
+};
+
+static void add_rule(RGWLifecycleConfiguration& config, const std::string& id,
+		     const std::string& prefix, const std::string& days,
+		     const std::string& date = "")
+{
+  LCRule rule;
+  rule.set_id(id);
+  rule.set_prefix(prefix);
+  rule.set_status("Enabled");
+  rule.set_expiration(LCExpiration(days, date));
+  ASSERT_EQ(0, config.check_and_add_rule(rule));
+}
+
+class LCExpirationIndex : public ::testing::Test {
+protected:
+  void SetUp() override {
+    // measure rule days in seconds, so due times are exact
+    cct->_conf.set_val_or_die("rgw_lc_debug_interval", "10");
+    cct->_conf.apply_changes(nullptr);
+  }
+  void TearDown() override {
+    cct->_conf.set_val_or_die("rgw_lc_debug_interval", "-1");
+    cct->_conf.apply_changes(nullptr);
+  }
+};
+
+TEST_F(LCExpirationIndex, Supported)
+{
+  RGWLifecycleConfiguration config(cct);
+  EXPECT_FALSE(rgw::lc::expiration_index_supported(config, false));
+
+  add_rule(config, "expire", "", "1");
+  EXPECT_TRUE(rgw::lc::expiration_index_supported(config, false));
+  EXPECT_FALSE(rgw::lc::expiration_index_supported(config, true));
+
+  LCRule noncur;
+  noncur.set_id("noncur");
+  noncur.set_prefix("logs/");
+  noncur.set_status("Enabled");
+  LCExpiration noncur_exp;
+  noncur_exp.set_days("1");
+  noncur.set_noncur_expiration(noncur_exp);
+  ASSERT_EQ(0, config.check_and_add_rule(noncur));
+  EXPECT_FALSE(rgw::lc::expiration_index_supported(config, false));
+}
+
+TEST_F(LCExpirationIndex, DueDebugInterval)
+{
+  RGWLifecycleConfiguration config(cct);
+  add_rule(config, "slow", "", "3");
+  add_rule(config, "fast", "tmp/", "1");
+
+  const auto mtime = ceph::real_clock::from_time_t(1000000);
+  // the earliest matching rule wins
+  EXPECT_EQ(mtime + std::chrono::seconds(10),
+	    rgw::lc::expiration_due(cct, config, "tmp/a", mtime));
+  EXPECT_EQ(mtime + std::chrono::seconds(30),
+	    rgw::lc::expiration_due(cct, config, "data/a", mtime));
+}
+
+TEST_F(LCExpirationIndex, DueDays)
+{
+  cct->_conf.set_val_or_die("rgw_lc_debug_interval", "-1");
+  cct->_conf.apply_changes(nullptr);
+
+  RGWLifecycleConfiguration config(cct);
+  add_rule(config, "expire", "", "2");
+
+  const auto mtime = ceph::real_clock::from_time_t(1000000);
+  const auto due = rgw::lc::expiration_due(cct, config, "a", mtime);
+  // rounded up to the start of a day, as obj_has_expired() counts days
+  utime_t due_ut(due);
+  EXPECT_EQ(due_ut, due_ut.round_to_day());
+  EXPECT_GE(due, mtime + std::chrono::hours(48));
+  EXPECT_LE(due, mtime + std::chrono::hours(48 + 25));
+}
+
+TEST_F(LCExpirationIndex, DueDate)
+{
+  RGWLifecycleConfiguration config(cct);
+  add_rule(config, "date", "old/", "", "2020-01-01T00:00:00.000Z");
+
+  const auto date = ceph::from_iso_8601("2020-01-01T00:00:00.000Z");
+  ASSERT_TRUE(date);
+  const auto before = *date - std::chrono::hours(24);
+  const auto after = *date + std::chrono::hours(24);
+  EXPECT_EQ(*date, rgw::lc::expiration_due(cct, config, "old/a", before));
+  // an object written after the date is due right away
+  EXPECT_EQ(after, rgw::lc::expiration_due(cct, config, "old/a", after));
+  // no rule applies
+  EXPECT_EQ(ceph::real_time::max(),
+	    rgw::lc::expiration_due(cct, config, "new/a", before));
+}
+
+TEST_F(LCExpirationIndex, BuildAndDrain)
+{
+  RGWLifecycleConfiguration config(cct);
+  add_rule(config, "tmp", "tmp/", "1");
+  add_rule(config, "data", "data/", "10");
+
+  MemLifecycle lc;
+  rgw::lc::ExpirationIndexBuilder builder(cct, config, &lc, "idx", 2);
+
+  const auto mtime = ceph::real_clock::from_time_t(1000000);
+  ASSERT_EQ(0, builder.add(&dp, "tmp/a", mtime));
+  ASSERT_EQ(0, builder.add(&dp, "other/b", mtime)); // no rule applies
+  ASSERT_EQ(0, lc.add_calls);
+  ASSERT_EQ(0, builder.add(&dp, "data/c", mtime));  // fills a batch
+  ASSERT_EQ(1, lc.add_calls);
+  ASSERT_EQ(0, builder.add(&dp, "tmp/d", mtime + std::chrono::seconds(1)));
+  ASSERT_EQ(0, builder.flush(&dp));
+  ASSERT_EQ(2, lc.add_calls);
+  ASSERT_EQ(0, builder.flush(&dp));
+  ASSERT_EQ(2, lc.add_calls);
+  ASSERT_EQ(3u, lc.index.size());
+
+  // only the tmp/ objects are due
+  const auto until = mtime + std::chrono::seconds(60);
+  std::vector<std::string> seen;
+  int batches = 0;
+  ASSERT_EQ(0, rgw::lc::drain_expiration_index(
+	      &dp, &lc, "idx", until, 1, [] { return false; },
+	      [&](const std::vector<Expiration>& entries) {
+		++batches;
+		for (auto& e : entries) {
+		  seen.push_back(e.key);
+		}
+		// an entry that failed is queued again with a later due
+		// time, and must survive the trim
+		if (entries.front().key == "tmp/a") {
+		  lc.add_expirations(&dp, "idx", {{until, "tmp/a"}},
+				     null_yield);
+		}
+	      }, null_yield));
+  EXPECT_EQ(std::vector<std::string>({"tmp/a", "tmp/d"}), seen);
+  EXPECT_EQ(2, batches);
+
+  std::vector<std::string> left;
+  for (auto& [due, key] : lc.index) {
+    left.push_back(key);
+  }
+  EXPECT_EQ(std::vector<std::string>({"tmp/a", "data/c"}), left);
+}
+
+TEST_F(LCExpirationIndex, DrainStop)
+{
+  MemLifecycle lc;
+  const auto now = ceph::real_clock::from_time_t(1000000);
+  lc.index.emplace(now, "a");
+  lc.index.emplace(now, "b");
+
+  int processed = 0;
+  bool stop = false;
+  ASSERT_EQ(0, rgw::lc::drain_expiration_index(
+	      &dp, &lc, "idx", now + std::chrono::seconds(1), 1,
+	      [&] { return stop; },
+	      [&](const std::vector<Expiration>& entries) {
+		processed += entries.size();
+		stop = true;
+	      }, null_yield));
+  EXPECT_EQ(1, processed);
+  // the unprocessed entry is left for the next run
+  ASSERT_EQ(1u, lc.index.size());
+  EXPECT_EQ("b", lc.index.begin()->second);
+}
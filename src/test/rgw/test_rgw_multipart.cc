@@ -0,0 +1,156 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_multi.h"
+
+#include <vector>
+
+#include "common/ceph_context.h"
+#include "common/dout.h"
+
+#include <gtest/gtest.h>
+
+auto cct = new CephContext(CEPH_ENTITY_TYPE_CLIENT);
+const NoDoutPrefix dpp(cct, ceph_subsys_rgw);
+
+// the part omap of an upload's meta object, kept in memory
+struct TestPartsOmap : RGWMultipartPartsOmap {
+  std::map<std::string, bufferlist> vals;
+  int get_all_calls = 0;
+
+  void add(const std::string& key, uint32_t num) {
+    RGWUploadPartInfo info;
+    info.num = num;
+    info.etag = "etag" + std::to_string(num);
+    encode(info, vals[key]);
+  }
+  // the keys of v2 uploads
+  void add_padded(uint32_t num) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "part.%08d", (int)num);
+    add(buf, num);
+  }
+  // the keys of pre-v2 uploads, also written by older gateways to v2 ones
+  void add_unpadded(uint32_t num) {
+    add("part." + std::to_string(num), num);
+  }
+
+  int get_vals(const DoutPrefixProvider *dpp, const std::string& marker,
+               uint64_t count, std::map<std::string, bufferlist>* m) override {
+    for (auto i = vals.upper_bound(marker);
+         i != vals.end() && m->size() < count; ++i) {
+      m->insert(*i);
+    }
+    return 0;
+  }
+  int get_all(const DoutPrefixProvider *dpp,
+              std::map<std::string, bufferlist>* m) override {
+    ++get_all_calls;
+    *m = vals;
+    return 0;
+  }
+};
+
+// pages through the parts the way RadosMultipartUpload::complete() does
+static std::vector<uint32_t> list_all(TestPartsOmap& omap, bool sorted_omap,
+                                      int max_parts)
+{
+  std::vector<uint32_t> nums;
+  int marker = 0;
+  bool truncated = false;
+  do {
+    std::map<uint32_t, RGWUploadPartInfo> parts;
+    int r = list_multipart_parts(&dpp, omap, sorted_omap, max_parts, marker,
+                                 &parts, &marker, &truncated);
+    EXPECT_EQ(0, r);
+    if (r < 0) {
+      break;
+    }
+    EXPECT_LE(parts.size(), size_t(max_parts));
+    for (const auto& [num, info] : parts) {
+      EXPECT_EQ(num, info.num);
+      nums.push_back(num);
+    }
+  } while (truncated);
+  return nums;
+}
+
+static std::vector<uint32_t> range(uint32_t first, uint32_t last)
+{
+  std::vector<uint32_t> nums;
+  for (uint32_t i = first; i <= last; i++) {
+    nums.push_back(i);
+  }
+  return nums;
+}
+
+TEST(MultipartParts, SortedWithGaps)
+{
+  TestPartsOmap omap;
+  std::vector<uint32_t> expected;
+  for (uint32_t i = 1; i <= 20; i += 3) {
+    omap.add_padded(i);
+    expected.push_back(i);
+  }
+
+  EXPECT_EQ(expected, list_all(omap, true, 2));
+  // gaps don't make the listing read the whole omap
+  EXPECT_EQ(0, omap.get_all_calls);
+}
+
+TEST(MultipartParts, Unsorted)
+{
+  TestPartsOmap omap;
+  for (uint32_t i = 1; i <= 12; i++) {
+    omap.add_unpadded(i);
+  }
+
+  EXPECT_EQ(range(1, 12), list_all(omap, false, 5));
+  EXPECT_EQ(range(1, 12), list_all(omap, false, 12));
+}
+
+TEST(MultipartParts, MixedInOnePage)
+{
+  TestPartsOmap omap;
+  for (uint32_t i = 1; i <= 10; i++) {
+    if (i == 5) {
+      omap.add_unpadded(i);
+    } else {
+      omap.add_padded(i);
+    }
+  }
+
+  EXPECT_EQ(range(1, 10), list_all(omap, true, 1000));
+  EXPECT_LT(0, omap.get_all_calls);
+}
+
+TEST(MultipartParts, MixedMarkerPaging)
+{
+  TestPartsOmap omap;
+  for (uint32_t i = 1; i <= 10; i++) {
+    if (i == 2 || i == 7) {
+      omap.add_unpadded(i);
+    } else {
+      omap.add_padded(i);
+    }
+  }
+
+  // the unpadded keys sort after every padded one, past the first page
+  EXPECT_EQ(range(1, 10), list_all(omap, true, 3));
+}
+
+TEST(MultipartParts, MixedComplete)
+{
+  // more parts than complete() takes in a page, where the unpadded key
+  // sorts past the first one
+  TestPartsOmap omap;
+  for (uint32_t i = 1; i <= 1500; i++) {
+    if (i == 5) {
+      omap.add_unpadded(i);
+    } else {
+      omap.add_padded(i);
+    }
+  }
+
+  EXPECT_EQ(range(1, 1500), list_all(omap, true, 1000));
+}
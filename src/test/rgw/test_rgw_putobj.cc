@@ -13,8 +13,11 @@
  */
 
 #include "rgw/rgw_putobj.h"
+#include "common/ceph_context.h"
 #include <gtest/gtest.h>
 
+auto cct = new CephContext(CEPH_ENTITY_TYPE_CLIENT);
+
 inline bufferlist string_buf(const char* buf) {
   bufferlist bl;
   bl.append(buffer::create_static(strlen(buf), (char*)buf));
@@ -194,3 +197,42 @@ TEST(PutObj_Stripe, SkipFirstChunk)
   ASSERT_EQ(4u, mock.ops.size());
   EXPECT_EQ(Op({"", 4}), mock.ops[3]); // flush
 }
+
+struct ErrorProcessor : rgw::sal::DataProcessor {
+  int process(bufferlist&& data, uint64_t offset) override {
+    return -EIO;
+  }
+};
+
+TEST(PutObj_Offload, Ordered)
+{
+  cct->_conf.set_val_or_die("rgw_put_obj_offload_threads", "2");
+  MockProcessor mock;
+  rgw::putobj::OffloadProcessor offload(cct, null_yield, &mock);
+  rgw::putobj::ChunkProcessor chunk(offload.get_output(), 4);
+  offload.set_stage(&chunk);
+
+  ASSERT_EQ(0, offload.process(string_buf("22"), 0));
+  ASSERT_EQ(0, offload.process(string_buf("4444"), 2));
+  ASSERT_EQ(0, offload.process(string_buf("333"), 6));
+
+  ASSERT_EQ(0, offload.process({}, 9)); // flush
+  ASSERT_EQ(4u, mock.ops.size());
+  EXPECT_EQ(Op({"2244", 0}), mock.ops[0]);
+  EXPECT_EQ(Op({"4433", 4}), mock.ops[1]);
+  EXPECT_EQ(Op({"3", 8}), mock.ops[2]);
+  EXPECT_EQ(Op({"", 9}), mock.ops[3]);
+}
+
+TEST(PutObj_Offload, StageError)
+{
+  cct->_conf.set_val_or_die("rgw_put_obj_offload_threads", "2");
+  MockProcessor mock;
+  rgw::putobj::OffloadProcessor offload(cct, null_yield, &mock);
+  ErrorProcessor stage;
+  offload.set_stage(&stage);
+
+  offload.process(string_buf("22"), 0);
+  ASSERT_EQ(-EIO, offload.process({}, 2)); // flush
+  EXPECT_TRUE(mock.ops.empty());
+}
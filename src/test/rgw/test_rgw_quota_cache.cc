@@ -0,0 +1,119 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw/rgw_quota_cache.h"
+
+#include <gtest/gtest.h>
+
+static RGWStorageStats make_stats(uint64_t num_objects, uint64_t size)
+{
+  RGWStorageStats stats;
+  stats.num_objects = num_objects;
+  stats.size = size;
+  stats.size_rounded = rgw_rounded_objsize(size);
+  return stats;
+}
+
+static RGWQuotaCacheStats make_entry(uint64_t num_objects, uint64_t size)
+{
+  RGWQuotaCacheStats entry;
+  entry.stats = make_stats(num_objects, size);
+  entry.expiration = utime_t(200, 0);
+  entry.async_refresh_time = utime_t(150, 0);
+  return entry;
+}
+
+TEST(QuotaCacheStats, ClaimRefreshOnce)
+{
+  auto entry = make_entry(10, 4096);
+
+  // concurrent requests coalesce onto the first claim
+  ASSERT_TRUE(entry.claim_refresh());
+  EXPECT_FALSE(entry.claim_refresh());
+  EXPECT_FALSE(entry.claim_refresh());
+
+  // after a failed refresh another one can be claimed
+  ASSERT_TRUE(entry.refresh_failed(utime_t(160, 0)));
+  EXPECT_FALSE(entry.refresh_failed(utime_t(161, 0)));
+  EXPECT_EQ(utime_t(160, 0), entry.async_refresh_time);
+  EXPECT_TRUE(entry.claim_refresh());
+}
+
+TEST(QuotaCacheStats, KeepChangesAfterFetch)
+{
+  auto entry = make_entry(10, 4096);
+
+  // already in what the fetch reads
+  entry.adjust(1, 4096, 0);
+  EXPECT_EQ(11u, entry.stats.num_objects);
+
+  ASSERT_TRUE(entry.claim_refresh());
+  const uint64_t gen = entry.fetch_issued();
+
+  // made while the fetch is in flight
+  entry.adjust(2, 8192, 0);
+  entry.adjust(-1, 0, 4096);
+
+  ASSERT_TRUE(entry.fetched(gen, make_stats(11, 8192),
+                            utime_t(300, 0), utime_t(250, 0)));
+  EXPECT_EQ(12u, entry.stats.num_objects);
+  EXPECT_EQ(8192u + 8192u - 4096u, entry.stats.size);
+  EXPECT_EQ(utime_t(300, 0), entry.expiration);
+  EXPECT_EQ(utime_t(250, 0), entry.async_refresh_time);
+
+  // the changes are only applied to the fetch they were made during
+  EXPECT_EQ(0, entry.pending_objs_delta);
+  EXPECT_EQ(0u, entry.pending_added_bytes);
+  EXPECT_EQ(0u, entry.pending_removed_bytes);
+}
+
+TEST(QuotaCacheStats, DropChangesBeforeFetch)
+{
+  auto entry = make_entry(10, 4096);
+
+  // a refresh that failed leaves the changes made during it behind, they
+  // must not be added to the next fetch, which already reads them
+  ASSERT_TRUE(entry.claim_refresh());
+  entry.fetch_issued();
+  entry.adjust(5, 5 * 4096, 0);
+  ASSERT_TRUE(entry.refresh_failed(utime_t(160, 0)));
+
+  ASSERT_TRUE(entry.claim_refresh());
+  const uint64_t gen = entry.fetch_issued();
+  ASSERT_TRUE(entry.fetched(gen, make_stats(15, 6 * 4096),
+                            utime_t(300, 0), utime_t(250, 0)));
+  EXPECT_EQ(15u, entry.stats.num_objects);
+  EXPECT_EQ(6u * 4096u, entry.stats.size);
+}
+
+TEST(QuotaCacheStats, DropSupersededFetch)
+{
+  auto entry = make_entry(10, 4096);
+
+  ASSERT_TRUE(entry.claim_refresh());
+  const uint64_t first = entry.fetch_issued();
+  entry.adjust(1, 4096, 0);
+
+  // a later fetch is issued before the first one lands
+  const uint64_t second = entry.fetch_issued();
+  entry.adjust(1, 4096, 0);
+
+  EXPECT_FALSE(entry.fetched(first, make_stats(10, 4096),
+                             utime_t(300, 0), utime_t(250, 0)));
+  EXPECT_EQ(12u, entry.stats.num_objects);
+  EXPECT_EQ(0u, entry.async_refresh_time.sec());
+
+  ASSERT_TRUE(entry.fetched(second, make_stats(11, 8192),
+                            utime_t(300, 0), utime_t(250, 0)));
+  EXPECT_EQ(12u, entry.stats.num_objects);
+  EXPECT_EQ(3u * 4096u, entry.stats.size);
+}
+
+TEST(QuotaCacheStats, ClampAtZero)
+{
+  auto entry = make_entry(1, 4096);
+  entry.adjust(-2, 0, 8192);
+  EXPECT_EQ(0u, entry.stats.num_objects);
+  EXPECT_EQ(0u, entry.stats.size);
+  EXPECT_EQ(0u, entry.stats.size_rounded);
+}
@@ -7,10 +7,13 @@
 #include "common/errno.h"
 #include "common/strtol.h"
 #include "common/ceph_mutex.h"
+#include "include/compat.h"
+#include "include/scope_guard.h"
 #include "include/types.h"
 #include "global/signal_handler.h"
 #include <atomic>
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics/stats.hpp>
@@ -52,6 +55,7 @@ enum io_pattern_t {
 struct IOType {};
 struct Size {};
 struct IOPattern {};
+struct EncryptionFormat {};
 
 void validate(boost::any& v, const std::vector<std::string>& values,
               Size *target_type, int) {
@@ -103,6 +107,54 @@ void validate(boost::any& v, const std::vector<std::string>& values,
     v = boost::any(io_type);
 }
 
+void validate(boost::any& v, const std::vector<std::string>& values,
+              EncryptionFormat *target_type, int) {
+  po::validators::check_first_occurrence(v);
+  const std::string &s = po::validators::get_single_string(values);
+  if (s == "luks1") {
+    v = boost::any(RBD_ENCRYPTION_FORMAT_LUKS1);
+  } else if (s == "luks2") {
+    v = boost::any(RBD_ENCRYPTION_FORMAT_LUKS2);
+  } else {
+    throw po::validation_error(po::validation_error::invalid_option_value);
+  }
+}
+
+int load_encryption(librbd::Image &image, rbd_encryption_format_t format,
+                    const std::string &passphrase_file) {
+  std::ifstream file(passphrase_file.c_str());
+  if (file.fail()) {
+    std::cerr << "rbd: unable to open passphrase file " << passphrase_file
+              << ": " << cpp_strerror(errno) << std::endl;
+    return -errno;
+  }
+  std::string passphrase((std::istreambuf_iterator<char>(file)),
+                         (std::istreambuf_iterator<char>()));
+  auto sg = make_scope_guard([&] {
+      ceph_memzero_s(&passphrase[0], passphrase.size(), passphrase.size()); });
+  file.close();
+  if (!passphrase.empty() && passphrase[passphrase.length() - 1] == '\n') {
+    passphrase.erase(passphrase.length() - 1);
+  }
+
+  int r;
+  if (format == RBD_ENCRYPTION_FORMAT_LUKS1) {
+    librbd::encryption_luks1_format_options_t opts = {};
+    opts.passphrase = passphrase;
+    r = image.encryption_load(format, &opts, sizeof(opts));
+  } else {
+    librbd::encryption_luks2_format_options_t opts = {};
+    opts.passphrase = passphrase;
+    r = image.encryption_load(format, &opts, sizeof(opts));
+  }
+
+  if (r < 0) {
+    std::cerr << "rbd: failed to load encryption: " << cpp_strerror(r)
+              << std::endl;
+  }
+  return r;
+}
+
 } // anonymous namespace
 
 static void rbd_bencher_completion(void *c, void *pc);
@@ -442,7 +494,9 @@ void add_bench_common_options(po::options_description *positional,
     ("io-threads", po::value<uint32_t>(), "ios in flight [default: 16]")
     ("io-total", po::value<Size>(), "total size for IO (in B/K/M/G/T) [default: 1G]")
     ("io-pattern", po::value<IOPattern>(), "IO pattern (rand, seq, or full-seq) [default: seq]")
-    ("rw-mix-read", po::value<uint64_t>(), "read proportion in readwrite (<= 100) [default: 50]");
+    ("rw-mix-read", po::value<uint64_t>(), "read proportion in readwrite (<= 100) [default: 50]")
+    ("encryption-format", po::value<EncryptionFormat>(), "image encryption format to load (luks1 or luks2)")
+    ("passphrase-file", po::value<std::string>(), "path of file containing the image passphrase");
 }
 
 void get_arguments_for_write(po::options_description *positional,
@@ -529,6 +583,18 @@ int bench_execute(const po::variables_map &vm, io_type_t bench_io_type) {
     }
   }
 
+  std::string passphrase_file;
+  if (vm.count("encryption-format")) {
+    if (vm.count("passphrase-file")) {
+      passphrase_file = vm["passphrase-file"].as<std::string>();
+    }
+    if (passphrase_file.empty()) {
+      std::cerr << "rbd: --passphrase-file must be specified with "
+                << "--encryption-format." << std::endl;
+      return -EINVAL;
+    }
+  }
+
   librados::Rados rados;
   librados::IoCtx io_ctx;
   librbd::Image image;
@@ -538,6 +604,15 @@ int bench_execute(const po::variables_map &vm, io_type_t bench_io_type) {
     return r;
   }
 
+  if (vm.count("encryption-format")) {
+    r = load_encryption(
+      image, vm["encryption-format"].as<rbd_encryption_format_t>(),
+      passphrase_file);
+    if (r < 0) {
+      return r;
+    }
+  }
+
   init_async_signal_handler();
   register_async_signal_handler(SIGHUP, sighup_handler);
   register_async_signal_handler_oneshot(SIGINT, handle_signal);